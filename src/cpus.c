@@ -131,6 +131,22 @@ int64_t cpu_get_icount(void)
     return qemu_icount_bias + (icount << icount_time_shift);
 }
 
+/* Return the number of guest instructions executed so far. Unlike
+   cpu_get_icount(), it can be called in the middle of a translation block,
+   at the price of counting all the instructions of the current block */
+int64_t cpu_get_icount_raw(void)
+{
+    int64_t icount;
+    CPUState *cpu = current_cpu;
+
+    icount = qemu_icount;
+    if (cpu) {
+        CPUArchState *env = cpu->env_ptr;
+        icount -= (env->icount_decr.u16.low + env->icount_extra);
+    }
+    return icount;
+}
+
 /* return the host CPU cycle counter and handle stop/restart */
 int64_t cpu_get_ticks(void)
 {
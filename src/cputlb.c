@@ -77,6 +77,10 @@ void tlb_flush(CPUArchState *env, int flush_global)
     env->tlb_flush_addr = -1;
     env->tlb_flush_mask = 0;
     tlb_flush_count++;
+
+#ifdef CONFIG_QTRACE_CORE
+    qtrace_gate_tlb_flush(env);
+#endif
 }
 
 static inline void tlb_flush_entry(CPUTLBEntry *tlb_entry, target_ulong addr)
@@ -121,6 +125,10 @@ void tlb_flush_page(CPUArchState *env, target_ulong addr)
     }
 
     tb_flush_jmp_cache(env, addr);
+
+#ifdef CONFIG_QTRACE_CORE
+    qtrace_gate_tlb_flush(env);
+#endif
 }
 
 /* update the TLBs so that writes to code in the virtual page 'addr'
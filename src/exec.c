@@ -325,7 +325,9 @@ void cpu_exec_init_all(void)
 #endif
 #ifdef CONFIG_QTRACE_CORE
     if (qtrace_initialize(qtrace_gate_cb_peek, qtrace_gate_cb_regs,
-			 qtrace_gate_cb_tbflush, qtrace_gate_cb_va2phy) != 0) {
+			 qtrace_gate_cb_tbflush, qtrace_gate_cb_va2phy,
+			 qtrace_gate_cb_memmap, qtrace_gate_cb_icount,
+			 qtrace_gate_cb_event) != 0) {
       exit(1);
     }
 #endif
@@ -1713,6 +1713,42 @@ STEXI
 @findex qtrace-enable
 
 Get the current state of all the QTrace modules available.
+ETEXI
+
+    {
+        .name       = "qtrace-hooks",
+        .args_type  = "cycles:b?",
+        .params     = "[on|off]",
+        .help       = "Show calls and cycles spent in each QTrace hook, optionally switching cycle accounting on/off",
+        .mhandler.cmd = qtrace_qmp_qtrace_hooks,
+    },
+
+STEXI
+@item qtrace-hooks [on|off]
+@findex qtrace-hooks
+
+Show a per-hook breakdown of the overhead of QTrace: number of calls and, if
+cycle accounting is enabled, host cycles spent inside each hook. The optional
+argument switches cycle accounting on or off, and resets all counters.
+ETEXI
+
+    {
+        .name       = "qtrace-log-level",
+        .args_type  = "level:s?,module:s?",
+        .params     = "[level [module]]",
+        .help       = "Set or show the log level of QTrace modules (none, error, warning, info, debug or trace)",
+        .mhandler.cmd = qtrace_qmp_qtrace_log_level,
+    },
+
+STEXI
+@item qtrace-log-level [@var{level} [@var{module}]]
+@findex qtrace-log-level
+
+Set the log level of QTrace module @var{module} (named after its source file,
+e.g. @code{memory} or @code{notify_syscall}), or of all modules if
+@var{module} is omitted. Levels are @code{none}, @code{error},
+@code{warning}, @code{info}, @code{debug} and @code{trace}. Show the level of
+each module and the number of log messages dropped so far.
 ETEXI
 #ifdef CONFIG_QTRACE_SYSCALL
     {
@@ -1729,6 +1765,8 @@ STEXI
 
 Enable or disable QTrace syscall tracer module. Remember tracer state is NOT
 switched immediately, but only when a suitable execution state is reached.
+At that point translated code is flushed: while the tracer is disabled, guest
+code is translated without memory hooks.
 ETEXI
 
     {
@@ -1744,6 +1782,43 @@ STEXI
 @findex qtrace-enable-tracer
 
 Get QTrace syscall tracer state.
+ETEXI
+
+    {
+        .name       = "qtrace-stats",
+        .args_type  = "syscall:s?",
+        .params     = "[syscall]",
+        .help       = "Show per-syscall cost statistics of the QTrace tracer module",
+        .mhandler.cmd = qtrace_qmp_tracer_stats,
+    },
+
+STEXI
+@item qtrace-stats [@var{syscall}]
+@findex qtrace-stats
+
+Show the cost of completed system calls, aggregated by system call number:
+number of calls, latency in the guest, guest instructions (only with
+@code{-icount}), memory accesses processed, data bytes captured and host time
+spent inside QTrace (only with @code{-qtrace-host-time}). Most expensive
+system calls are listed first. If @var{syscall} (a name or a number) is
+specified, show its latency histograms.
+ETEXI
+
+    {
+        .name       = "qtrace-sampling",
+        .args_type  = "policy:s?",
+        .params     = "[policy]",
+        .help       = "Set or show the sampling policy of the QTrace tracer module",
+        .mhandler.cmd = qtrace_qmp_tracer_sampling,
+    },
+
+STEXI
+@item qtrace-sampling [@var{policy}]
+@findex qtrace-sampling
+
+Set the sampling policy of the QTrace syscall tracer (same syntax as the
+@code{-qtrace-sampling} option, or @code{off}), and show the current policy
+with the number of system calls sampled and skipped so far.
 ETEXI
 #endif  /* CONFIG_QTRACE_SYSCALL */
 
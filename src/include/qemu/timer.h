@@ -133,6 +133,7 @@ void qemu_put_timer(QEMUFile *f, QEMUTimer *ts);
 
 /* icount */
 int64_t cpu_get_icount(void);
+int64_t cpu_get_icount_raw(void);
 int64_t cpu_get_clock(void);
 
 /*******************************************/
@@ -0,0 +1,87 @@
+/*
+   Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+
+   Early-exit checks for QTrace hooks, evaluated on the QEMU side (gate.c and
+   the taint TCG helpers) before calling into libqtrace. Most hook invocations
+   have nothing to do (e.g., no system call is being captured, or no register
+   is tainted), and these checks spare them a call through the PLT into C++.
+
+   The state read here is exported by libqtrace as plain C variables, and kept
+   up to date by the C++ side whenever it changes. Checks are conservative:
+   when they pass, the C++ notification performs the full checks.
+*/
+
+#ifndef SRC_INCLUDE_QTRACE_FASTPATH_H_
+#define SRC_INCLUDE_QTRACE_FASTPATH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Syscall tracer */
+
+/* "true" if the syscall tracer is enabled. This flag is checked when guest code
+   is translated: hooks for memory accesses, string operations and kernel copy
+   routines are emitted only while the tracer is enabled, and translated code
+   is flushed whenever the tracer state changes */
+extern bool qtrace_tracer_enabled;
+
+/* Number of system calls being captured, in all processes */
+extern unsigned int qtrace_tracer_syscalls;
+
+/* Returns false if a "size"-byte memory access, performed at privilege level
+   "cpl", is certainly not captured. Same checks performed at the beginning of
+   notify_memread_post() and notify_memwrite_pre() */
+static inline bool qtrace_fastpath_memaccess(int cpl, int size) {
+  return qtrace_tracer_enabled && qtrace_tracer_syscalls > 0 &&
+    cpl == 0 && size <= (int) sizeof(void *);
+}
+
+/* Taint engine */
+
+/* Number of CPU and temporary registers tracked by the taint engine */
+#define QTRACE_TAINT_CPU_REGS 16
+#define QTRACE_TAINT_TMP_REGS 512
+
+/* Cache of the taint state, maintained by the taint engine. A register is
+   tainted iff its bit is set */
+typedef struct {
+  uint64_t cpu;
+  uint64_t tmp[QTRACE_TAINT_TMP_REGS / 64];
+  uint64_t mem;                 /* Number of tainted memory bytes */
+} QTraceTaintCache;
+
+extern QTraceTaintCache qtrace_taint_cache;
+
+/* Returns true if a register is tainted */
+static inline bool qtrace_fastpath_reg_tainted(bool istmp, unsigned int reg) {
+  if (istmp) {
+    return (qtrace_taint_cache.tmp[reg / 64] >> (reg % 64)) & 1;
+  }
+  return (qtrace_taint_cache.cpu >> reg) & 1;
+}
+
+/* Returns true if any temporary register is tainted */
+static inline bool qtrace_fastpath_tmp_tainted(void) {
+  uint64_t tainted = 0;
+  unsigned int i;
+
+  for (i = 0; i < QTRACE_TAINT_TMP_REGS / 64; i++) {
+    tainted |= qtrace_taint_cache.tmp[i];
+  }
+  return tainted != 0;
+}
+
+/* Returns true if any memory location is tainted */
+static inline bool qtrace_fastpath_mem_tainted(void) {
+  return qtrace_taint_cache.mem != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* SRC_INCLUDE_QTRACE_FASTPATH_H_ */
@@ -33,7 +33,44 @@ int qtrace_gate_cb_tbflush(void);
 /* Callback function for translating a VA into a physical address */
 hwaddr qtrace_gate_cb_va2phy(target_ulong va);
 
+/*
+   Callback function for mapping guest memory. Returns a host pointer to the
+   "len" bytes at VA "addr", or NULL if the range crosses a page boundary or
+   is not backed by RAM. The pointer is valid until the next TLB flush.
+ */
+void *qtrace_gate_cb_memmap(target_ulong addr, int len);
+
+/* Callback function for reading the number of guest instructions executed so
+   far. Returns -1 if instruction counting (-icount) is disabled */
+int64_t qtrace_gate_cb_icount(void);
+
+/* Callback function for emitting QTrace events through QEMU trace-events */
+void qtrace_gate_cb_event(QTraceEvent event, uint64_t arg0, uint64_t arg1,
+                          uint64_t arg2, uint64_t arg3);
+
+/* Notify a TLB flush of a vCPU, invalidating its cached host pointers */
+void qtrace_gate_tlb_flush(CPUArchState *env);
+
 #ifdef CONFIG_QTRACE_SYSCALL
+/* Reasons for skipping syscall and memory hooks (env->qtrace_filtered) */
+#define QTRACE_FILTERED_PROCESS (1 << 0) /* Address space is filtered out */
+#define QTRACE_FILTERED_STRING  (1 << 1) /* String operation captured */
+#define QTRACE_FILTERED_SYSCALL (1 << 2) /* Syscall filtered or not sampled */
+
+/* String operations captured as a single range */
+#define QTRACE_STRING_MOVS 0
+#define QTRACE_STRING_STOS 1
+
+/* Maximum length of a string operation captured as a single range */
+#define QTRACE_STRING_MAX_LEN (1 << 20)
+
+/* Number of records in the memory access buffer of each vCPU */
+#define QTRACE_ACCESS_BUF_LEN 4096
+
+/* Size of the kernel stack of guest threads (KERNEL_STACK_SIZE on x86
+   Windows). Bounds the stack usage of kernel copy routines */
+#define QTRACE_KERNEL_STACK_SIZE 0x3000
+
 /*
    Notify the beginning of a system call.
 
@@ -52,33 +89,82 @@ void qtrace_gate_syscall_start(CPUX86State *env);
 void qtrace_gate_syscall_end(CPUX86State *env);
 
 /*
-   Notify a pre-access memory read operation.
-
-   Preconditions: the emulator is going to access a memory region, but the
-   target memory address has not been accessed yet.
- */
-void qtrace_gate_memread_pre(CPUArchState *env, target_ulong addr,
-                            target_ulong addr_hi, int size);
-
-/*
-   Notify a post-read memory operation.
+   Notify a post-read memory operation. Translated code calls this function
+   only when the access cannot be appended to the access buffer.
 
    Preconditions: the emulator has just accessed a memory region and data has
-   been retrieved.
+   been retrieved. The address of the region is in env->qtrace_memread_addr.
  */
 void qtrace_gate_memread_post(CPUArchState *env, target_ulong buffer,
                               target_ulong buffer_hi, int size);
 
-/* Notify a memory write operation */
+/*
+   Notify a memory write operation. Translated code calls this function only
+   when the access cannot be appended to the access buffer.
+ */
 void qtrace_gate_memwrite_pre(CPUArchState *env, target_ulong addr,
                               target_ulong addr_hi, target_ulong buffer,
                               target_ulong buffer_hi, int size);
 
+/*
+   Notify an iteration of a string operation "op" (QTRACE_STRING_*) with
+   (1 << ot)-byte elements, executed in ring 0. "src" and "dst" are the linear
+   addresses of the current element.
+
+   The first iteration captures the whole range, and disarms memory hooks for
+   the following elements.
+ */
+void qtrace_gate_string_start(CPUX86State *env, target_ulong src,
+                              target_ulong dst, int op, int ot);
+
+/* Notify the end of a string operation, re-arming memory hooks */
+void qtrace_gate_string_end(CPUX86State *env);
+
+/* Returns true if "pc" is the entry point of a known kernel copy routine */
+bool qtrace_gate_is_copy_routine(target_ulong pc);
+
+/*
+   Notify a call to the kernel copy routine at linear address "pc".
+
+   Preconditions: the return address has been pushed, but the first
+   instruction of the routine has not been executed yet.
+ */
+void qtrace_gate_copy_routine(CPUX86State *env, target_ulong pc);
+
+/*
+   Notify a write to the CR3 register, and arm or disarm syscall and memory
+   hooks for the new address space.
+
+   Preconditions: env->cr[3] still holds the old value.
+ */
+void qtrace_gate_cr3(CPUX86State *env, target_ulong new_cr3);
+
 /* Switch syscall tracer on/off */
 void qtrace_gate_tracer_set_state(bool state);
 
 /* Get current state of the syscall tracer */
 bool qtrace_gate_tracer_get_state(void);
+
+/* Set the sampling policy of the syscall tracer. Returns false if the policy
+   specification is invalid */
+bool qtrace_gate_tracer_set_sampling(const char *spec);
+
+/* Get the sampling policy of the syscall tracer, and the number of system
+   calls sampled and skipped so far */
+void qtrace_gate_tracer_get_sampling(const char **spec, uint64_t *sampled,
+                                     uint64_t *skipped);
+
+/* Get the output filter of the syscall tracer, and the number of system calls
+   it accepted and rejected so far. Returns false if no filter is set */
+bool qtrace_gate_tracer_get_output_filter(const char **expr,
+                                          uint64_t *accepted,
+                                          uint64_t *rejected);
+
+/* Format the cost statistics of the syscall tracer: a summary of all system
+   calls if "syscall" is NULL, or the histograms of a single system call (name
+   or number). Returns a string to be released with free(), or NULL if the
+   system call is unknown */
+char *qtrace_gate_tracer_get_stats(const char *syscall);
 #endif  /* CONFIG_QTRACE_SYSCALL */
 
 #ifdef CONFIG_QTRACE_TAINT
@@ -0,0 +1,95 @@
+/*
+   Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+
+   This module counts the invocations of QTrace hooks and, optionally, the host
+   cycles spent inside each of them, to attribute the overhead of tracing to
+   individual hooks. Counting calls costs a single increment; cycles are read
+   from the host time-stamp counter only when cycle accounting is enabled.
+   Cycles are inclusive: the processing of buffered memory accesses is also
+   accounted to the hook that triggered it.
+*/
+
+#ifndef SRC_INCLUDE_QTRACE_HOOKS_H_
+#define SRC_INCLUDE_QTRACE_HOOKS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "qemu-common.h"
+#include "qemu/timer.h"
+
+typedef enum {
+  QTRACE_HOOK_SYSCALL_START = 0,
+  QTRACE_HOOK_SYSCALL_END,
+  QTRACE_HOOK_MEMREAD_POST,
+  QTRACE_HOOK_MEMWRITE_PRE,
+  QTRACE_HOOK_ACCESS_FLUSH,     /* Buffered accesses processed in batch */
+  QTRACE_HOOK_CPL,
+  QTRACE_HOOK_CR3,
+  QTRACE_HOOK_STRING_START,
+  QTRACE_HOOK_COPY_ROUTINE,
+  QTRACE_HOOK_TBFLUSH,          /* TB flushes requested through cb_tbflush */
+  QTRACE_HOOK_TAINT_ASSERT,
+  QTRACE_HOOK_TAINT_REG2MEM,
+  QTRACE_HOOK_TAINT_MEM2REG,
+  QTRACE_HOOK_TAINT_MOV,
+  QTRACE_HOOK_TAINT_CLEARR,
+  QTRACE_HOOK_TAINT_ENDTB,
+  QTRACE_HOOK_TAINT_COMBINE2,
+  QTRACE_HOOK_TAINT_COMBINE3,
+  QTRACE_HOOK_TAINT_DEPOSIT,
+  QTRACE_HOOK_MAX,
+} QTraceHook;
+
+typedef struct {
+  uint64_t calls;
+  uint64_t cycles;
+} QTraceHookCounter;
+
+/* Counters of each hook. All vCPUs run in the same thread, thus counters are
+   not updated atomically */
+extern QTraceHookCounter qtrace_hook_counters[QTRACE_HOOK_MAX];
+
+/* True if cycles spent inside hooks are accounted */
+extern bool qtrace_hook_cycles;
+
+/* Invocation of a hook, from declaration to end of scope */
+typedef struct {
+  QTraceHook hook;
+  int64_t start;
+} QTraceHookScope;
+
+static inline QTraceHookScope qtrace_hook_begin(QTraceHook hook) {
+  QTraceHookScope scope = { hook, 0 };
+
+  qtrace_hook_counters[hook].calls++;
+  if (unlikely(qtrace_hook_cycles)) {
+    scope.start = cpu_get_real_ticks();
+  }
+  return scope;
+}
+
+static inline void qtrace_hook_end(QTraceHookScope *scope) {
+  if (unlikely(qtrace_hook_cycles)) {
+    qtrace_hook_counters[scope->hook].cycles +=
+      cpu_get_real_ticks() - scope->start;
+  }
+}
+
+/* Account the invocation of hook "h" until the end of the current scope. Must
+   be placed among the declarations of the hook function */
+#define QTRACE_HOOK_SCOPE(h)                                            \
+  QTraceHookScope qtrace_hook_scope                                     \
+  __attribute__((cleanup(qtrace_hook_end))) = qtrace_hook_begin(h)
+
+/* Initialize hook counters. If "cycles" is true, cycle accounting is enabled
+   and a breakdown is printed to stderr at exit */
+void qtrace_hooks_init(bool cycles);
+
+/* Enable or disable cycle accounting. All counters are reset */
+void qtrace_hooks_set_cycles(bool cycles);
+
+/* Print a per-hook breakdown of calls and cycles */
+void qtrace_hooks_dump(FILE *f, fprintf_function cpu_fprintf);
+
+#endif  /* SRC_INCLUDE_QTRACE_HOOKS_H_ */
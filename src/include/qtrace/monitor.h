@@ -11,10 +11,14 @@
 
 void qtrace_qmp_qtrace_enable(Monitor *mon, const QDict *qdict);
 void qtrace_qmp_qtrace_query(Monitor *mon, const QDict *qdict);
+void qtrace_qmp_qtrace_hooks(Monitor *mon, const QDict *qdict);
+void qtrace_qmp_qtrace_log_level(Monitor *mon, const QDict *qdict);
 
 #ifdef CONFIG_QTRACE_SYSCALL
 void qtrace_qmp_tracer_enable(Monitor *mon, const QDict *qdict);
 void qtrace_qmp_tracer_query(Monitor *mon, const QDict *qdict);
+void qtrace_qmp_tracer_sampling(Monitor *mon, const QDict *qdict);
+void qtrace_qmp_tracer_stats(Monitor *mon, const QDict *qdict);
 #endif
 
 #ifdef CONFIG_QTRACE_TAINT
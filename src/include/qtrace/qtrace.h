@@ -13,6 +13,8 @@
 #include "exec/hwaddr.h"
 #endif
 
+#include "qtrace/fastpath.h"
+
 /* Notable syscall registers, to ease porting to different architectures */
 #define QTRACE_REG_SYSCALL_RESULT eax
 
@@ -36,8 +38,46 @@ typedef struct {
   /* Segments */
   target_ulong cs_base;
   target_ulong fs_base;
+
+  /* Index of the vCPU */
+  int cpu;
 } CpuRegisters;
 
+/*
+   Memory access appended by translated code to the access buffer of a vCPU.
+   Buffered accesses are processed in batches, when the buffer is full or the
+   guest reaches a point where the tracer needs an up-to-date view (e.g., the
+   end of a system call).
+ */
+typedef struct {
+  target_ulong pc;
+  target_ulong addr;
+  target_ulong value;
+  uint32_t info;                /* Size, kind and CPL, see below */
+} QTraceAccess;
+
+#define QTRACE_ACCESS_READ  0
+#define QTRACE_ACCESS_WRITE 1
+
+#define QTRACE_ACCESS_KIND_SHIFT 8
+#define QTRACE_ACCESS_CPL_SHIFT  16
+
+#define QTRACE_ACCESS_SIZE(info) ((info) & 0xff)
+#define QTRACE_ACCESS_KIND(info) (((info) >> QTRACE_ACCESS_KIND_SHIFT) & 0xff)
+#define QTRACE_ACCESS_CPL(info)  ((info) >> QTRACE_ACCESS_CPL_SHIFT)
+
+/*
+   Events emitted by QTrace through QEMU trace-events backends (see the
+   "qtrace_*" events in "trace-events"). Arguments are listed for each event
+ */
+typedef enum {
+  QTRACE_EVENT_ACTUALIZE = 0,       /* Syscall id, pointer, buffer, size */
+  QTRACE_EVENT_FOREIGN,             /* Syscall id, pointer */
+  QTRACE_EVENT_TAINT_SOURCE_MEM,    /* Label, address, size */
+  QTRACE_EVENT_TAINT_SOURCE_REG,    /* Label, register */
+  QTRACE_EVENT_TAINT_SINK,          /* Syscall id, address, size */
+} QTraceEvent;
+
 /*
    Callbacks prototypes
  */
@@ -46,6 +86,11 @@ typedef int (*qtrace_func_memread)(target_ulong addr, unsigned char *buffer,
 typedef int (*qtrace_func_regread)(CpuRegisters *regs);
 typedef int (*qtrace_func_tbflush)(void);
 typedef hwaddr (*qtrace_func_va2phy)(target_ulong va);
+typedef void *(*qtrace_func_memmap)(target_ulong addr, int len);
+typedef int64_t (*qtrace_func_icount)(void);
+typedef void (*qtrace_func_event)(QTraceEvent event, uint64_t arg0,
+                                  uint64_t arg1, uint64_t arg2,
+                                  uint64_t arg3);
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,13 +102,30 @@ extern "C" {
   int qtrace_initialize(qtrace_func_memread   func_peek,
                         qtrace_func_regread   func_regs,
                         qtrace_func_tbflush   func_tbflush,
-                        qtrace_func_va2phy    func_va2phy);
+                        qtrace_func_va2phy    func_va2phy,
+                        qtrace_func_memmap    func_memmap,
+                        qtrace_func_icount    func_icount,
+                        qtrace_func_event     func_event);
 
   /*
      Returns "true" if system call number "sysno" should be processed,
      according to user-supplied system calls filter
    */
   bool qtrace_should_process_syscall(target_ulong sysno);
+
+  /*
+     Set the log level ("none", "error", "warning", "info", "debug", "trace",
+     or a number) of QTrace log module "module", or of all modules if "module"
+     is NULL. Returns "false" if the level or the module is unknown
+   */
+  bool qtrace_log_set_level(const char *module, const char *level);
+
+  /*
+     Get the log level of each QTrace log module, one per line. The caller
+     must free the returned string
+   */
+  char *qtrace_log_get_levels(void);
+
 #ifdef __cplusplus
 }
 #endif
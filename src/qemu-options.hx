@@ -3179,6 +3179,8 @@ STEXI
 @item -qtrace-process @var{name}
 @findex -qtrace-process
 Instruct QTrace to process only process with name @var{name}.
+Syscall and memory hooks are disabled while other processes are running, so
+they run with negligible tracing overhead.
 ETEXI
 
 DEF("qtrace-foreign", 0, QEMU_OPTION_qtrace_foreign, \
@@ -3191,6 +3193,163 @@ STEXI
 Enable tracking of foreign function pointers, i.e., function pointers
 that do not belong to system calls arguments.
 ETEXI
+
+DEF("qtrace-compact", 0, QEMU_OPTION_qtrace_compact, \
+    "-qtrace-compact\n"
+    "                serialize syscalls using the compact trace format\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-compact
+@findex -qtrace-compact
+Serialize system calls using the compact (version 2) trace format. Process
+and thread data is emitted only once, nested argument addresses are
+delta-encoded and syscall names are embedded in the trace header.
+ETEXI
+
+DEF("qtrace-dedup", HAS_ARG, QEMU_OPTION_qtrace_dedup, \
+    "-qtrace-dedup SIZE\n"
+    "                deduplicate argument payloads of at least SIZE bytes\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-dedup @var{size}
+@findex -qtrace-dedup
+Store argument data payloads of at least @var{size} bytes only once in the
+trace, and replace later copies with a reference. Payloads are matched by
+their 128-bit digest. Implies -qtrace-compact.
+ETEXI
+
+DEF("qtrace-columns", 0, QEMU_OPTION_qtrace_columns, \
+    "-qtrace-columns\n"
+    "                write a columnar syscall summary next to the trace\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-columns
+@findex -qtrace-columns
+Write a columnar summary of serialized system calls (syscall number, process,
+return value, argument count, data sizes and taint label counts) to
+directory @var{path}.cols, where @var{path} is the trace file.
+ETEXI
+
+DEF("qtrace-copyfuncs", HAS_ARG, QEMU_OPTION_qtrace_copyfuncs, \
+    "-qtrace-copyfuncs NAME=ADDR[,...]\n"
+    "                capture calls to kernel copy routines at entry\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-copyfuncs @var{name}=@var{addr}[,...]
+@findex -qtrace-copyfuncs
+Capture calls to the guest kernel routine @var{name}, whose entry point is at
+virtual address @var{addr}, as whole buffers. Memory hooks are skipped until
+the routine returns. Supported routines are memcpy, memmove, RtlCopyMemory,
+ProbeForRead, ProbeForWrite and RtlCopyUnicodeString.
+ETEXI
+
+DEF("qtrace-snapshot-args", 0, QEMU_OPTION_qtrace_snapshot_args, \
+    "-qtrace-snapshot-args\n"
+    "                read syscall arguments with a single access at entry\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-snapshot-args
+@findex -qtrace-snapshot-args
+Read the first-level arguments of system calls with a single guest memory
+access at syscall entry, instead of collecting them as the kernel copies them.
+The number of arguments is read from the kernel service tables, or learned
+from previous invocations of the same system call.
+ETEXI
+
+DEF("qtrace-layout", HAS_ARG, QEMU_OPTION_qtrace_layout, \
+    "-qtrace-layout off|syscall|caller\n"
+    "                cache syscall argument layouts\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-layout @var{mode}
+@findex -qtrace-layout
+Cache the layout of system call arguments (data pointers, nesting and sizes)
+learned from completed system calls, and use it to pre-create the arguments
+of later invocations. Layouts are cached per system call number
+(@var{mode} is @code{syscall}), or per system call number and user-space
+caller (@var{mode} is @code{caller}). Accesses that do not match the cached
+layout are processed as usual.
+ETEXI
+
+DEF("qtrace-limits", HAS_ARG, QEMU_OPTION_qtrace_limits, \
+    "-qtrace-limits [arg=BYTES][,syscall=BYTES][,depth=N][,candidates=N]\n"
+    "                limit data captured for syscall arguments\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-limits [arg=@var{bytes}][,syscall=@var{bytes}][,depth=@var{n}][,candidates=@var{n}]
+@findex -qtrace-limits
+Limit the data captured for each argument (@var{arg}) and for each system
+call (@var{syscall}), the nesting depth of data pointers (@var{depth}) and the
+number of candidate data pointers per system call (@var{candidates}). Zero
+means no limit. Data limits count the distinct bytes stored for each
+direction: input and output data of an argument are limited separately, and
+reading the same bytes again is not charged. The candidates limit counts all
+the candidate data pointers found during a system call, including the ones
+that were confirmed or discarded since. Arguments and system calls whose data
+or pointers were dropped are flagged as truncated in the trace. Unknown limits
+and malformed values are rejected.
+ETEXI
+
+DEF("qtrace-sampling", HAS_ARG, QEMU_OPTION_qtrace_sampling, \
+    "-qtrace-sampling [every=N][,first=K][,rate=R][,burst=B][,per=syscall|process]\n"
+    "                trace only a sample of system calls\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-sampling [every=@var{n}][,first=@var{k}][,rate=@var{r}][,burst=@var{b}][,per=syscall|process]
+@findex -qtrace-sampling
+Trace only a sample of the system calls that pass the syscall and process
+filters: one call every @var{n} for each syscall number (@var{every}), after
+the first @var{k} calls of each syscall number (@var{first}), and at most
+@var{r} calls per second (@var{rate}), with bursts of up to @var{b} calls. The
+rate limit applies to each syscall number, or to each process when @var{per}
+is @code{process}. Memory hooks are disarmed for system calls that are not
+sampled. The policy can be changed at run-time with the @code{qtrace-sampling}
+monitor command.
+ETEXI
+
+DEF("qtrace-output-filter", HAS_ARG, QEMU_OPTION_qtrace_output_filter, \
+    "-qtrace-output-filter expr\n"
+    "                serialize only system calls matching expr\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-output-filter @var{expr}
+@findex -qtrace-output-filter
+Serialize only the system calls that match @var{expr}, evaluated when the
+system call returns. @var{expr} is a list of alternatives separated by
+@code{||}, each being a list of conditions separated by @code{&&}. A condition
+has the form @code{[!]@var{field} [@var{op} @var{value}]}, where @var{op} is a
+comparison operator and @var{field} is one of @code{sysno} (number or name),
+@code{retval}, @code{status} (@code{success}, @code{info}, @code{warning} or
+@code{error}), @code{process}, @code{nargs}, @code{bytes} (data bytes of all
+arguments) and @code{tainted}. For example:
+@example
+-qtrace-output-filter "status != error && bytes >= 16 || tainted"
+@end example
+ETEXI
+
+DEF("qtrace-async", 0, QEMU_OPTION_qtrace_async, \
+    "-qtrace-async   reconstruct syscall arguments on a worker thread\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-async
+@findex -qtrace-async
+Reconstruct system call arguments and serialize system calls on a worker
+thread. Memory hooks only append compact records to a ring buffer, that the
+worker replays. First-level arguments, argument layouts and taint dependencies
+are still processed synchronously.
+ETEXI
+
+DEF("qtrace-host-time", 0, QEMU_OPTION_qtrace_host_time, \
+    "-qtrace-host-time\n"
+    "                account host time spent in QTrace to each syscall\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-host-time
+@findex -qtrace-host-time
+Account the host time spent inside QTrace hooks to each system call, as
+reported by the @code{qtrace-stats} monitor command and serialized in the
+trace. Off by default, as it reads the host clock twice in every memory hook.
+ETEXI
 #endif
 
 #ifdef CONFIG_QTRACE_TAINT
@@ -3205,6 +3364,34 @@ Start emulation with the taint-propagation engine disabled. Can be enabled
 later using QEMU monitor.
 ETEXI
 #endif
+
+DEF("qtrace-hook-stats", 0, QEMU_OPTION_qtrace_hook_stats, \
+    "-qtrace-hook-stats\n"
+    "                account host cycles spent in each QTrace hook\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-hook-stats
+@findex -qtrace-hook-stats
+Account the host cycles spent inside each QTrace hook (syscall and memory
+hooks, CPL and CR3 switches, taint helpers, TB flushes), and print a per-hook
+breakdown at exit. Calls are always counted. The breakdown is also available
+with the @code{qtrace-hooks} monitor command.
+ETEXI
+
+DEF("qtrace-perfmap", 0, QEMU_OPTION_qtrace_perfmap, \
+    "-qtrace-perfmap\n"
+    "                write a perf map of translated code to /tmp/perf-<pid>.map\n",
+    QEMU_ARCH_ALL)
+STEXI
+@item -qtrace-perfmap
+@findex -qtrace-perfmap
+Write a Linux @code{perf} map of the translation buffer to
+@file{/tmp/perf-<pid>.map}. Each translated block is named after its guest PC
+and the instrumentation emitted when it was translated (@code{hooks},
+@code{taint}, @code{hooks+taint} or @code{plain}); out-of-line slow paths of
+each block and the TCG prologue are labeled separately. The map is rewritten
+whenever the translation buffer is flushed.
+ETEXI
 #endif
 
 HXCOMM This is the last statement. Insert new options before this line!
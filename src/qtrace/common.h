@@ -25,4 +25,11 @@
 // address of its "parent" argument
 const target_ulong MAX_ARGUMENT_OFFSET = 0x1000;
 
+// Size of guest memory pages
+const target_ulong GUEST_PAGE_SIZE = 0x1000;
+
+// Maximum size of a bulk memory access (e.g., a call to a kernel copy routine)
+// captured as a single range
+const target_ulong MAX_BULK_ACCESS_SIZE = 1 << 20;
+
 #endif  // SRC_QTRACE_COMMON_H_
@@ -1,6 +1,7 @@
 #!/bin/bash
 
 if [ "$1" == "user" ] ; then
+    shift
     target="i386-linux-user"
     opts=""
 else
@@ -9,4 +10,4 @@ else
 fi
 
 ./configure --target-list=$target --enable-vnc --disable-kvm \
-    --disable-docs --disable-vhost-net --disable-vhost-scsi $opts
+    --disable-docs --disable-vhost-net --disable-vhost-scsi $opts "$@"
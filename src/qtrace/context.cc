@@ -31,10 +31,56 @@ void context_print() {
   INFO("Syscall filter:               %s",
        gbl_context.options.filter_syscalls ?
        gbl_context.options.filter_syscalls : "none");
+
+  INFO("Trace format:                 %s",
+       gbl_context.options.trace_compact ? "compact (v2)" : "v1");
+
+  if (gbl_context.options.dedup_threshold > 0) {
+    INFO("Payload deduplication:        >= %d bytes",
+         gbl_context.options.dedup_threshold);
+  } else {
+    INFO("Payload deduplication:        OFF");
+  }
+
+  INFO("Columnar summary:             %s",
+       gbl_context.options.trace_columns ? "ON" : "OFF");
+
+  INFO("Copy routines:                %s",
+       gbl_context.options.copy_routines ?
+       gbl_context.options.copy_routines : "none");
+
+  INFO("Level-0 arguments snapshot:   %s",
+       gbl_context.options.snapshot_args ? "ON" : "OFF");
+
+  INFO("Argument layout cache:        %s",
+       qtrace_get_layout_mode_name(gbl_context.options.layout_mode));
+
+  INFO("Capture limits:               %s",
+       gbl_context.options.capture_limits ?
+       gbl_context.options.capture_limits : "none");
+
+  INFO("Sampling policy:              %s",
+       gbl_context.options.sampling ? gbl_context.options.sampling : "off");
+
+  INFO("Output filter:                %s",
+       gbl_context.options.output_filter ?
+       gbl_context.options.output_filter : "none");
+
+  INFO("Asynchronous reconstruction:  %s",
+       gbl_context.options.async_events ? "ON" : "OFF");
+
+  INFO("Syscall host time accounting: %s",
+       gbl_context.options.host_time ? "ON" : "OFF");
 #endif
 
 #ifdef CONFIG_QTRACE_TAINT
   INFO("Taint tracking:               %s",
        gbl_context.options.taint_disabled ? "OFF" : "ON");
 #endif
+
+  INFO("Hook cycle accounting:        %s",
+       gbl_context.options.hook_stats ? "ON" : "OFF");
+
+  INFO("Perf map of translated code:  %s",
+       gbl_context.options.perfmap ? "ON" : "OFF");
 }
@@ -28,13 +28,22 @@ struct QTraceContext {
   // Callback to translate a physical address in a virtual one
   qtrace_func_va2phy cb_va2phy;
 
+  // Callback to emit an event through QEMU trace-events
+  qtrace_func_event cb_event;
+
 #ifdef CONFIG_QTRACE_SYSCALL
   // Callback to peek memory
   qtrace_func_memread cb_peek;
 
+  // Callback to get a host pointer to guest memory (NULL if not mappable)
+  qtrace_func_memmap cb_memmap;
+
   // Callback to read CPU registers
   qtrace_func_regread cb_regs;
 
+  // Callback to read the guest instruction counter (-1 if -icount is off)
+  qtrace_func_icount cb_icount;
+
   // Syscall tracer manager
   TraceManager *trace_manager;
 
@@ -52,6 +61,15 @@ struct QTraceContext {
 
 extern struct QTraceContext gbl_context;
 
+// Emit @event through QEMU trace-events, if QTrace has been initialized
+static inline void context_event(QTraceEvent event, uint64_t arg0,
+                                 uint64_t arg1 = 0, uint64_t arg2 = 0,
+                                 uint64_t arg3 = 0) {
+  if (gbl_context.cb_event) {
+    gbl_context.cb_event(event, arg0, arg1, arg2, arg3);
+  }
+}
+
 void context_print();
 
 #endif  // SRC_QTRACE_CONTEXT_H_
@@ -13,10 +13,19 @@
 /* Must come first */
 #include "cpu.h"
 #include "exec/memory.h"
+#ifndef CONFIG_USER_ONLY
+#include "exec/address-spaces.h"
+#include "exec/memory-internal.h"
+#include "qemu/timer.h"
+#include "sysemu/sysemu.h"
+#endif
 
 #include <stdbool.h>
 
+#include "qtrace/fastpath.h"
 #include "qtrace/gate.h"
+#include "qtrace/hooks.h"
+#include "trace.h"
 
 #ifdef CONFIG_QTRACE_SYSCALL
 #include "qtrace/trace/notify_syscall.h"
@@ -26,8 +35,26 @@
 #include "qtrace/taint/notify_taint.h"
 #endif
 
+/* vCPU that triggered the notification being processed. All vCPUs run in
+   the same thread, so callbacks from QTrace always refer to this vCPU */
 static CPUX86State *cpu_current_env = NULL;
 
+/* Number of entries in the cache of host pointers for guest pages */
+#define QTRACE_MEMMAP_CACHE_SIZE 16
+
+/* Host pointers for recently mapped guest pages, for each vCPU (vCPUs may run
+   in different address spaces). Entries are invalidated on TLB flushes of
+   their vCPU, thus also when CR3 is written */
+typedef struct {
+  target_ulong vpage;
+  uint8_t *host;                /* NULL for invalid entries */
+} QTraceMemmapEntry;
+
+#ifndef CONFIG_USER_ONLY
+static QTraceMemmapEntry
+qtrace_memmap_cache[MAX_CPUMASK_BITS][QTRACE_MEMMAP_CACHE_SIZE];
+#endif
+
 static inline void qtrace_update_current_env(CPUX86State *env) {
   cpu_current_env = env;  
 }
@@ -58,7 +85,10 @@ hwaddr qtrace_gate_cb_va2phy(target_ulong va) {
 
 /* Flush QEMU TB cache */
 int qtrace_gate_cb_tbflush(void) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TBFLUSH);
   CPUState *cpu;
+
+  trace_qtrace_tb_flush();
   for (cpu = first_cpu; cpu != NULL; cpu = cpu->next_cpu) {
     CPUArchState *env = cpu->env_ptr;
     tb_flush(env);
@@ -76,6 +106,89 @@ int qtrace_gate_cb_peek(target_ulong addr, unsigned char *buffer, int len) {
   return r;
 }
 
+/* Map guest memory ('addr' is a VA) */
+void *qtrace_gate_cb_memmap(target_ulong addr, int len) {
+#ifdef CONFIG_USER_ONLY
+  return NULL;
+#else
+  target_ulong vpage = addr & TARGET_PAGE_MASK;
+  QTraceMemmapEntry *entry;
+  MemoryRegion *mr;
+  hwaddr paddr, xlat, l;
+
+  assert(cpu_current_env != NULL);
+
+  /* Ranges crossing a page boundary are not served */
+  if (len <= 0 || ((addr + len - 1) & TARGET_PAGE_MASK) != vpage) {
+    return NULL;
+  }
+
+  entry = &qtrace_memmap_cache[ENV_GET_CPU(cpu_current_env)->cpu_index]
+                              [(vpage >> TARGET_PAGE_BITS) %
+                               QTRACE_MEMMAP_CACHE_SIZE];
+  if (entry->host == NULL || entry->vpage != vpage) {
+    paddr = qtrace_gate_va2phy(cpu_current_env, vpage);
+    if (paddr == -1) {
+      return NULL;
+    }
+
+    l = TARGET_PAGE_SIZE;
+    mr = address_space_translate(&address_space_memory, paddr, &xlat, &l,
+                                 false);
+    if (!memory_region_is_ram(mr) || l < TARGET_PAGE_SIZE) {
+      /* MMIO, or a page not entirely backed by RAM */
+      return NULL;
+    }
+
+    entry->vpage = vpage;
+    entry->host = qemu_get_ram_ptr(memory_region_get_ram_addr(mr) + xlat);
+  }
+
+  return entry->host + (addr & ~TARGET_PAGE_MASK);
+#endif
+}
+
+/* Read the guest instruction counter */
+int64_t qtrace_gate_cb_icount(void) {
+#ifndef CONFIG_USER_ONLY
+  if (use_icount) {
+    return cpu_get_icount_raw();
+  }
+#endif
+  return -1;
+}
+
+/* Forward a QTrace event to QEMU trace-events backends */
+void qtrace_gate_cb_event(QTraceEvent event, uint64_t arg0, uint64_t arg1,
+                          uint64_t arg2, uint64_t arg3) {
+  switch (event) {
+  case QTRACE_EVENT_ACTUALIZE:
+    trace_qtrace_actualize(arg0, arg1, arg2, arg3);
+    break;
+  case QTRACE_EVENT_FOREIGN:
+    trace_qtrace_foreign(arg0, arg1);
+    break;
+  case QTRACE_EVENT_TAINT_SOURCE_MEM:
+    trace_qtrace_taint_source_mem(arg0, arg1, arg2);
+    break;
+  case QTRACE_EVENT_TAINT_SOURCE_REG:
+    trace_qtrace_taint_source_reg(arg0, arg1);
+    break;
+  case QTRACE_EVENT_TAINT_SINK:
+    trace_qtrace_taint_sink(arg0, arg1, arg2);
+    break;
+  default:
+    assert(false);
+  }
+}
+
+void qtrace_gate_tlb_flush(CPUArchState *env) {
+#ifndef CONFIG_USER_ONLY
+  memset(qtrace_memmap_cache[ENV_GET_CPU(env)->cpu_index], 0,
+         sizeof(qtrace_memmap_cache[0]));
+#endif
+}
+
 /* Peek CPU registers */
 int qtrace_gate_cb_regs(CpuRegisters *regs) {
   if (cpu_current_env == NULL) {
@@ -96,10 +209,14 @@ int qtrace_gate_cb_regs(CpuRegisters *regs) {
   R(segs[R_FS].base, fs_base);
 #undef R
 
+  regs->cpu = ENV_GET_CPU(cpu_current_env)->cpu_index;
+
   return 0;
 }
 
 void qtrace_gate_cpl(CPUX86State *env, int oldcpl, int newcpl) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_CPL);
+
   if (oldcpl == newcpl) {
     /* No CPL switch */
     return;
@@ -114,56 +231,328 @@ void qtrace_gate_cpl(CPUX86State *env, int oldcpl, int newcpl) {
 }
 
 #ifdef CONFIG_QTRACE_SYSCALL
+/* Check if a kernel copy routine, captured at entry, is being executed. The
+   routine is considered to have returned once the stack pointer moves above
+   its value at routine entry (e.g., "ret", or an exception unwinding the
+   stack), or more than a kernel stack below it (i.e., on another stack, as
+   when a thread without owner state is switched out) */
+static inline bool qtrace_in_copy_routine(CPUX86State *env) {
+  if (likely(env->qtrace_copy_esp == 0)) {
+    return false;
+  }
+
+  if (env->qtrace_copy_esp - env->regs[R_ESP] < QTRACE_KERNEL_STACK_SIZE) {
+    return true;
+  }
+
+  env->qtrace_copy_esp = 0;
+  return false;
+}
+
+/* Process the memory accesses buffered by translated code. Must be called
+   before any other notification that depends on the order of memory
+   accesses */
+static void qtrace_access_flush(CPUX86State *env) {
+  QTraceAccess *start = env->qtrace_access_buf;
+  QTraceAccess *end = env->qtrace_access_ptr;
+
+  /* After a CPU reset both pointers are NULL, and buffering is disarmed */
+  if (end == NULL || end == start) {
+    return;
+  }
+
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_ACCESS_FLUSH);
+
+  env->qtrace_access_ptr = start;
+  qtrace_update_current_env(env);
+  notify_memaccess_batch(env->cr[3], env->qtrace_thread, start, end - start);
+}
+
+/* Flush the access buffer and disarm buffering, until level-0 arguments of
+   the current system call have been read */
+static void qtrace_access_disarm(CPUX86State *env) {
+  qtrace_access_flush(env);
+  env->qtrace_access_end = env->qtrace_access_ptr;
+}
+
+/* Leave the hook state of the vCPU without owner thread. The whole address
+   space is then considered its stack, so that translated code never checks
+   for thread switches */
+static void qtrace_thread_clear(CPUX86State *env) {
+  env->qtrace_thread = 0;
+  env->qtrace_stack_limit = 0;
+  env->qtrace_stack_size = (target_ulong) -1;
+}
+
+/* Flush and clear the hook state of the vCPU, on behalf of its owner */
+static void qtrace_thread_release(CPUX86State *env) {
+  qtrace_access_disarm(env);
+  env->qtrace_copy_esp = 0;
+  env->qtrace_filtered &= ~(QTRACE_FILTERED_STRING | QTRACE_FILTERED_SYSCALL);
+  qtrace_thread_clear(env);
+}
+
+/* Make the running thread the owner of the hook state of the vCPU, before
+   arming any part of it. The state is left without owner if the running
+   thread cannot be located yet (e.g., early during boot) */
+static void qtrace_thread_acquire(CPUX86State *env) {
+  target_ulong thread, limit, size;
+
+  if (env->qtrace_thread != 0) {
+    /* Checked by qtrace_thread_check() at gate entry */
+    return;
+  }
+
+  qtrace_update_current_env(env);
+  if (!notify_current_thread(&thread, &limit, &size)) {
+    qtrace_thread_clear(env);
+    return;
+  }
+
+  env->qtrace_thread = thread;
+  env->qtrace_stack_limit = limit;
+  env->qtrace_stack_size = size;
+}
+
+/* Check that the hook state of the vCPU still belongs to the running thread,
+   and release it otherwise. Threads of the same process are switched without
+   writing CR3, but each one runs on its own kernel stack: the running thread
+   is located only when the stack pointer leaves the stack of the owner, as
+   the owner may also be running on another stack (e.g., at system call
+   entry) */
+static void qtrace_thread_check(CPUX86State *env) {
+  target_ulong thread, limit, size;
+
+  if (likely(env->qtrace_thread == 0 ||
+             env->regs[R_ESP] - env->qtrace_stack_limit <
+             env->qtrace_stack_size)) {
+    return;
+  }
+
+  qtrace_update_current_env(env);
+  if (notify_current_thread(&thread, &limit, &size) &&
+      thread == env->qtrace_thread) {
+    return;
+  }
+
+  qtrace_thread_release(env);
+}
+
+/* Arm buffering of memory accesses if "arm" is true. The buffer must have
+   been flushed */
+static void qtrace_access_arm(CPUX86State *env, bool arm) {
+  if (!arm) {
+    return;
+  }
+
+  qtrace_thread_acquire(env);
+  if (env->qtrace_access_buf == NULL) {
+    env->qtrace_access_buf = g_new(QTraceAccess, QTRACE_ACCESS_BUF_LEN);
+  }
+
+  env->qtrace_access_ptr = env->qtrace_access_buf;
+  env->qtrace_access_end = env->qtrace_access_buf + QTRACE_ACCESS_BUF_LEN;
+}
+
 void qtrace_gate_syscall_start(CPUX86State *env) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_SYSCALL_START);
   target_ulong sysno = env->regs[R_EAX];
   target_ulong stack = env->regs[R_EDX];
   target_ulong cr3 = env->cr[3];
+  int status;
+
+  /* Never skip a system call because the previous one was skipped, even if
+     we missed its end. Address spaces filtered out when their CR3 value was
+     loaded are skipped altogether: the decision is checked against the
+     running process at each CR3 write, as CR3 values are recycled */
+  qtrace_thread_release(env);
+  if (env->qtrace_filtered & QTRACE_FILTERED_PROCESS) {
+    return;
+  }
 
   qtrace_update_current_env(env);
-  notify_syscall_start(cr3, sysno, stack);
+  status = notify_syscall_start(cr3, sysno, stack);
+  trace_qtrace_syscall_start(ENV_GET_CPU(env)->cpu_index, cr3, sysno, status);
+  switch (status) {
+  case SyscallStartSkipped:
+    /* Disarm memory hooks until the system call returns, as long as the
+       calling thread is running */
+    qtrace_thread_acquire(env);
+    env->qtrace_filtered |= QTRACE_FILTERED_SYSCALL;
+    break;
+  case SyscallStartFiltered:
+    env->qtrace_filtered |= QTRACE_FILTERED_PROCESS;
+    break;
+  default:
+    /* Arguments may have been read already (e.g., snapshots) */
+    qtrace_access_arm(env, notify_memaccess_batchable(cr3));
+    break;
+  }
 }
 
 void qtrace_gate_syscall_end(CPUX86State *env) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_SYSCALL_END);
   target_ulong retval = env->regs[R_EAX];
   target_ulong cr3 = env->cr[3];
 
+  /* Never skip the end of a system call because of a string operation that
+     did not complete (e.g., it faulted) */
+  qtrace_thread_release(env);
+  if (env->qtrace_filtered) {
+    return;
+  }
+
   qtrace_update_current_env(env);
+  trace_qtrace_syscall_end(ENV_GET_CPU(env)->cpu_index, cr3, retval);
   notify_syscall_end(cr3, retval);
 }
 
 /* This function is eventually called by INDEX_op_qemu_ld* TCG
-   micro-instructions */
+   micro-instructions, when the access buffer is full or disarmed. The memory
+   address being accessed has been saved by translated code before the
+   access */
 void qtrace_gate_memread_post(CPUArchState *env, target_ulong buffer,
                              target_ulong buffer_hi, int size) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_MEMREAD_POST);
   target_ulong cr3 = env->cr[3];
   target_ulong pc = env->eip;
   int cpl = (env->hflags & HF_CPL_MASK) >> HF_CPL_SHIFT;
 
-  qtrace_update_current_env(env);
-  notify_memread_post(cr3, pc, cpl, buffer, buffer_hi, size);
-}
+  qtrace_thread_check(env);
+  if (env->qtrace_filtered || qtrace_in_copy_routine(env)) {
+    return;
+  }
 
-/* This callback is invoked before a memory read occurs. We store the memory
-   address that is being accessed, its size and current PC. */
-void qtrace_gate_memread_pre(CPUArchState *env, target_ulong addr,
-                            target_ulong addr_hi, int size) {
-  target_ulong pc = env->eip;
+  qtrace_access_flush(env);
+  if (!qtrace_fastpath_memaccess(cpl, size)) {
+    return;
+  }
 
   qtrace_update_current_env(env);
-  notify_memread_pre(pc, addr, addr_hi, size);
+  qtrace_access_arm(env, notify_memread_post(cr3, pc, cpl,
+                                             env->qtrace_memread_addr,
+                                             buffer, buffer_hi, size));
 }
 
-/* This callback is invoked before a memory write occurs. */
+/* This callback is invoked before a memory write occurs, when the access
+   buffer is full or disarmed. */
 void qtrace_gate_memwrite_pre(CPUArchState *env, target_ulong addr,
                              target_ulong addr_hi, target_ulong buffer,
                              target_ulong buffer_hi, int size) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_MEMWRITE_PRE);
   int cpl = (env->hflags & HF_CPL_MASK) >> HF_CPL_SHIFT;
   target_ulong cr3 = env->cr[3];
 
+  qtrace_thread_check(env);
+  if (env->qtrace_filtered || qtrace_in_copy_routine(env)) {
+    return;
+  }
+
+  qtrace_access_flush(env);
+  if (!qtrace_fastpath_memaccess(cpl, size)) {
+    return;
+  }
+
+  qtrace_update_current_env(env);
+  qtrace_access_arm(env, notify_memwrite_pre(cr3, env->eip, cpl,
+                                             addr, addr_hi,
+                                             buffer, buffer_hi, size));
+}
+
+/* This callback is invoked when the guest loads the CR3 register. Hooks are
+   disarmed when the new address space is known to be filtered out, so that
+   untraced processes do not pay for the instrumentation */
+void qtrace_gate_cr3(CPUX86State *env, target_ulong new_cr3) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_CR3);
+
+  /* Buffered accesses belong to the old address space */
+  qtrace_thread_check(env);
+  qtrace_access_disarm(env);
+  env->qtrace_copy_esp = 0;
+
+  /* A system call skipped by the running thread stays skipped: the thread
+     may just be attaching to another address space */
+  if (notify_cr3_write(new_cr3)) {
+    env->qtrace_filtered &= ~QTRACE_FILTERED_PROCESS;
+  } else {
+    env->qtrace_filtered |= QTRACE_FILTERED_PROCESS;
+  }
+
+  /* Resume buffering in the middle of a system call (e.g., a blocking one) */
+  if (!env->qtrace_filtered) {
+    qtrace_access_arm(env, notify_memaccess_batchable(new_cr3));
+  } else if (env->qtrace_thread == 0) {
+    /* Hooks are skipped for any thread */
+    qtrace_thread_clear(env);
+  }
+}
+
+/* This callback is invoked at each iteration of a ring-0 "rep movs/stos".
+   Iterations following the first one return immediately, as memory hooks are
+   disarmed once the whole range has been captured. Thread switches re-arm
+   hooks: in that case, the remaining part of the range is captured again
+   when the operation is resumed */
+void qtrace_gate_string_start(CPUX86State *env, target_ulong src,
+                              target_ulong dst, int op, int ot) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_STRING_START);
+  target_ulong count = env->regs[R_ECX];
+  target_ulong value = env->regs[R_EAX];
+  target_ulong len;
+  int size = 1 << ot;
+
+  /* String operations inside copy routines are already captured */
+  qtrace_thread_check(env);
+  if (env->qtrace_filtered || qtrace_in_copy_routine(env)) {
+    return;
+  }
+
+  if (count == 0 || count > (QTRACE_STRING_MAX_LEN >> ot)) {
+    /* Fall back on per-element memory hooks */
+    return;
+  }
+
+  len = count << ot;
+  if (env->df < 0) {
+    /* Elements are processed backwards */
+    src -= len - size;
+    dst -= len - size;
+  }
+
+  qtrace_access_flush(env);
   qtrace_update_current_env(env);
-  notify_memwrite_pre(cr3, env->eip, cpl,
-                      addr, addr_hi,
-                      buffer, buffer_hi, size);
+  if (notify_string_op(env->cr[3], env->eip, op == QTRACE_STRING_STOS,
+                       src, dst, len, value, size)) {
+    qtrace_thread_acquire(env);
+    env->qtrace_filtered |= QTRACE_FILTERED_STRING;
+  }
+}
+
+void qtrace_gate_string_end(CPUX86State *env) {
+  env->qtrace_filtered &= ~QTRACE_FILTERED_STRING;
+}
+
+bool qtrace_gate_is_copy_routine(target_ulong pc) {
+  return notify_is_copy_routine(pc);
+}
+
+/* This callback is invoked at the entry point of a known kernel copy routine.
+   When the whole call is captured, memory hooks are skipped until the routine
+   returns */
+void qtrace_gate_copy_routine(CPUX86State *env, target_ulong pc) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_COPY_ROUTINE);
+  target_ulong esp = env->regs[R_ESP];
+
+  qtrace_thread_check(env);
+  if (env->qtrace_filtered || qtrace_in_copy_routine(env)) {
+    return;
+  }
+
+  qtrace_access_flush(env);
+  qtrace_update_current_env(env);
+  if (notify_copy_routine(env->cr[3], pc, esp)) {
+    qtrace_thread_acquire(env);
+    env->qtrace_copy_esp = esp;
+  }
 }
 
 void qtrace_gate_tracer_set_state(bool state) {
@@ -173,6 +562,25 @@ void qtrace_gate_tracer_set_state(bool state) {
 bool qtrace_gate_tracer_get_state(void) {
   return notify_tracer_get_state();
 }
+
+bool qtrace_gate_tracer_set_sampling(const char *spec) {
+  return notify_tracer_set_sampling(spec);
+}
+
+void qtrace_gate_tracer_get_sampling(const char **spec, uint64_t *sampled,
+                                     uint64_t *skipped) {
+  notify_tracer_get_sampling(spec, sampled, skipped);
+}
+
+bool qtrace_gate_tracer_get_output_filter(const char **expr,
+                                          uint64_t *accepted,
+                                          uint64_t *rejected) {
+  return notify_tracer_get_output_filter(expr, accepted, rejected);
+}
+
+char *qtrace_gate_tracer_get_stats(const char *syscall) {
+  return notify_tracer_get_stats(syscall);
+}
 #endif	/* CONFIG_QTRACE_SYSCALL */
 
 #ifdef CONFIG_QTRACE_TAINT
@@ -0,0 +1,68 @@
+/*
+  Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+*/
+
+#include "qtrace/hooks.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+QTraceHookCounter qtrace_hook_counters[QTRACE_HOOK_MAX];
+bool qtrace_hook_cycles = false;
+
+/* Hook names, indexed by QTraceHook */
+static const char *qtrace_hook_names[QTRACE_HOOK_MAX] = {
+  "syscall_start", "syscall_end", "memread_post", "memwrite_pre",
+  "access_flush", "cpl", "cr3", "string_start", "copy_routine", "tbflush",
+  "taint_assert", "taint_reg2mem", "taint_mem2reg", "taint_mov",
+  "taint_clearR", "taint_endtb", "taint_combine2", "taint_combine3",
+  "taint_deposit",
+};
+
+static void qtrace_hooks_atexit(void) {
+  fprintf(stderr, "QTrace hooks overhead:\n");
+  qtrace_hooks_dump(stderr, fprintf);
+}
+
+void qtrace_hooks_init(bool cycles) {
+  qtrace_hooks_set_cycles(cycles);
+  if (cycles) {
+    atexit(qtrace_hooks_atexit);
+  }
+}
+
+void qtrace_hooks_set_cycles(bool cycles) {
+  memset(qtrace_hook_counters, 0, sizeof(qtrace_hook_counters));
+  qtrace_hook_cycles = cycles;
+}
+
+void qtrace_hooks_dump(FILE *f, fprintf_function cpu_fprintf) {
+  uint64_t total = 0;
+  int i;
+
+  for (i = 0; i < QTRACE_HOOK_MAX; i++) {
+    total += qtrace_hook_counters[i].cycles;
+  }
+
+  cpu_fprintf(f, "%-16s %14s %16s %12s %7s\n", "hook", "calls", "cycles",
+              "cycles/call", "share");
+
+  for (i = 0; i < QTRACE_HOOK_MAX; i++) {
+    const QTraceHookCounter *counter = &qtrace_hook_counters[i];
+
+    if (counter->calls == 0) {
+      continue;
+    }
+
+    if (!qtrace_hook_cycles) {
+      cpu_fprintf(f, "%-16s %14" PRIu64 " %16s %12s %7s\n",
+                  qtrace_hook_names[i], counter->calls, "-", "-", "-");
+      continue;
+    }
+
+    cpu_fprintf(f, "%-16s %14" PRIu64 " %16" PRIu64 " %12" PRIu64
+                " %6.2f%%\n", qtrace_hook_names[i], counter->calls,
+                counter->cycles, counter->cycles / counter->calls,
+                total ? 100.0 * counter->cycles / total : 0.0);
+  }
+}
@@ -4,52 +4,477 @@
 
 #include "qtrace/logging.h"
 
+#include <cassert>
 #include <cstdio>
-#include <cstdarg>
+#include <cstdlib>
 #include <cstring>
+#include <strings.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "qtrace/common.h"
 #include "qtrace/context.h"
 
+// Number of records in the log ring (must be a power of two)
+static const unsigned int LOG_RING_SIZE = 4096;
+
 static FILE *logfile;
 
-int log_init(const char *filename) {
-  if (!filename) {
-    return 0;
+// Registered log modules. Modules are registered by static initializers, and
+// never removed
+static std::vector<LogModule *> &log_modules(void) {
+  static std::vector<LogModule *> modules;
+  return modules;
+}
+
+LogModule *log_register_module(const char *file) {
+  // Module name is the base name of the source file, without extension
+  const char *base = strrchr(file, '/');
+  std::string name(base ? base + 1 : file);
+  size_t dot = name.rfind('.');
+  if (dot != std::string::npos) {
+    name.erase(dot);
   }
 
-  // Initialize the log file
-  logfile = fopen(filename, "w+");
-  if (!logfile) {
-    ERROR("Cannot open log file for writing");
-    return -1;
+  std::vector<LogModule *> &modules = log_modules();
+  for (auto it = modules.begin(); it != modules.end(); it++) {
+    if ((*it)->name == name) {
+      return *it;
+    }
   }
 
-  return 0;
+  LogModule *module = new LogModule;
+  module->name = name;
+  module->level = LOG_LEVEL_DEFAULT;
+  modules.push_back(module);
+  return module;
+}
+
+bool log_set_level(const char *name, int level) {
+  bool found = false;
+  std::vector<LogModule *> &modules = log_modules();
+  for (auto it = modules.begin(); it != modules.end(); it++) {
+    if (!name || (*it)->name == name) {
+      (*it)->level = level;
+      found = true;
+    }
+  }
+  return found;
 }
 
-void qtrace_log_(const char *f, unsigned int l, const char *tag,
-                 const char *fmt, ...) {
-  va_list ap;
-  char tmp[1024];
+static const char *log_level_names[] = {
+  "none", "error", "warning", "info", "debug", "trace",
+};
 
-  va_start(ap, fmt);
-  vsnprintf(tmp, sizeof(tmp), fmt, ap);
-  va_end(ap);
+// Tags of log levels, as printed in message headers
+static const char *log_level_tags[] = {
+  "---", "ERR", "WAR", "INF", "DBG", "TRA",
+};
 
-  char pc[32];
+int log_parse_level(const char *level) {
+  for (int i = 0; i <= LOG_LEVEL; i++) {
+    if (strcasecmp(level, log_level_names[i]) == 0) {
+      return i;
+    }
+  }
+
+  if (level[0] >= '0' && level[0] <= '0' + LOG_LEVEL && level[1] == '\0') {
+    return level[0] - '0';
+  }
+
+  return -1;
+}
+
+const char *log_level_name(int level) {
+  return level >= 0 && level <= 5 ? log_level_names[level] : "unknown";
+}
+
+void log_record_init(LogRecord *record, const LogModule *module, int level,
+                     const char *file, unsigned int line, const char *fmt) {
+  record->module = module;
+  record->file = file;
+  record->fmt = fmt;
+  record->line = line;
+  record->level = level;
+  record->nargs = 0;
+  record->strings_len = 0;
 
 #if defined(LOG_PC) && defined(CONFIG_QTRACE_SYSCALL)
   CpuRegisters regs;
   if (gbl_context.cb_regs && gbl_context.cb_regs(&regs) == 0) {
-    snprintf(pc, sizeof(pc), "@%.8x ", regs.pc);
+    record->pc = regs.pc;
   } else {
-    snprintf(pc, sizeof(pc), "@_unknown ");
+    record->pc = -1;
   }
 #else
-  pc[0] = '\0';
+  record->pc = -1;
 #endif
+}
+
+void log_record_arg(LogRecord *record, const char *s) {
+  // Strings are copied, as they may not outlive the call (e.g., c_str())
+  unsigned int offset = record->strings_len;
+  if (offset == LOG_MAX_STRINGS) {
+    // No room left, point to the terminator of the last string
+    offset--;
+  } else {
+    size_t len = strnlen(s ? s : "(null)", LOG_MAX_STRINGS - offset - 1);
+    memcpy(record->strings + offset, s ? s : "(null)", len);
+    record->strings[offset + len] = '\0';
+    record->strings_len = offset + len + 1;
+  }
+  log_record_value(record, offset);
+}
+
+// Append to @out the conversion specification @spec, applied to argument @arg
+// of @record. @conv is the conversion character, @length the length modifier
+static void log_format_arg(std::string &out, const LogRecord &record,
+                           unsigned int arg, const std::string &spec,
+                           char conv, const std::string &length) {
+  char tmp[256];
+
+  if (arg >= record.nargs || arg >= LOG_MAX_ARGS) {
+    out += "<?>";
+    return;
+  }
+
+  uint64_t u = record.args[arg].u;
+  const char *s = spec.c_str();
+  bool is_long = length == "l" || length == "z" || length == "t";
+  bool is_longlong = length == "ll" || length == "q" || length == "j";
+
+  switch (conv) {
+  case 'd':
+  case 'i':
+    if (is_longlong) {
+      snprintf(tmp, sizeof(tmp), s, static_cast<long long>(u));
+    } else if (is_long) {
+      snprintf(tmp, sizeof(tmp), s, static_cast<long>(u));
+    } else {
+      snprintf(tmp, sizeof(tmp), s, static_cast<int>(u));
+    }
+    break;
+  case 'u':
+  case 'o':
+  case 'x':
+  case 'X':
+    if (is_longlong) {
+      snprintf(tmp, sizeof(tmp), s, static_cast<unsigned long long>(u));
+    } else if (is_long) {
+      snprintf(tmp, sizeof(tmp), s, static_cast<unsigned long>(u));
+    } else {
+      snprintf(tmp, sizeof(tmp), s, static_cast<unsigned int>(u));
+    }
+    break;
+  case 'c':
+    snprintf(tmp, sizeof(tmp), s, static_cast<int>(u));
+    break;
+  case 'e':
+  case 'E':
+  case 'f':
+  case 'F':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+    snprintf(tmp, sizeof(tmp), s, record.args[arg].d);
+    break;
+  case 's':
+    snprintf(tmp, sizeof(tmp), s,
+             record.strings + (u < LOG_MAX_STRINGS ? u : 0));
+    break;
+  case 'p':
+    snprintf(tmp, sizeof(tmp), s, reinterpret_cast<void *>(u));
+    break;
+  default:
+    snprintf(tmp, sizeof(tmp), "%s", s);
+    break;
+  }
+
+  out += tmp;
+}
+
+std::string log_format(const LogRecord &record) {
+  std::string out;
+  unsigned int arg = 0;
+  const char *p = record.fmt;
+
+  while (*p) {
+    if (*p != '%') {
+      out += *p++;
+      continue;
+    }
+
+    if (p[1] == '%') {
+      out += '%';
+      p += 2;
+      continue;
+    }
+
+    // Flags, width and precision. A '*' consumes an int argument, that is
+    // expanded in the specification
+    std::string spec(1, *p++);
+    while (*p && strchr("-+ #0", *p)) {
+      spec += *p++;
+    }
+    for (int field = 0; field < 2; field++) {
+      if (field == 1) {
+        if (*p != '.') {
+          break;
+        }
+        spec += *p++;
+      }
+      if (*p == '*') {
+        int value = arg < record.nargs && arg < LOG_MAX_ARGS ?
+          static_cast<int>(record.args[arg].u) : 0;
+        spec += std::to_string(value);
+        arg++;
+        p++;
+      }
+      while (*p >= '0' && *p <= '9') {
+        spec += *p++;
+      }
+    }
+
+    std::string length;
+    while (*p && strchr("hlqjzt", *p)) {
+      length += *p++;
+    }
+    spec += length;
+
+    if (*p == '\0') {
+      out += spec;
+      break;
+    }
+
+    char conv = *p++;
+    spec += conv;
+    if (conv == 'n') {
+      arg++;
+      continue;
+    }
+
+    log_format_arg(out, record, arg++, spec, conv, length);
+  }
+
+  return out;
+}
+
+// Write a formatted record to the log file
+static void log_write(const LogRecord &record) {
+  char pc[32];
+
+  if (record.pc != static_cast<uint64_t>(-1)) {
+    snprintf(pc, sizeof(pc), "@%.8llx ",
+             static_cast<unsigned long long>(record.pc));
+  } else {
+#if defined(LOG_PC)
+    snprintf(pc, sizeof(pc), "@_unknown ");
+#else
+    pc[0] = '\0';
+#endif
+  }
+
+  fprintf(logfile ? logfile : stderr, "_QTrace_ %s[%s:%d] [%s] %s\n", pc,
+          record.file, record.line, log_level_tags[record.level],
+          log_format(record).c_str());
+}
+
+// Multiple-producer, single-consumer ring of log records, with its background
+// thread. Producers claim a slot by advancing head_; the sequence number of a
+// slot tells whether it is free, being written or ready to be formatted
+class LogRing {
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    LogRecord record;
+  };
+
+  std::vector<Slot> ring_;
+  const uint64_t mask_;
+
+  std::atomic<uint64_t> head_;
+  uint64_t tail_;               // Only accessed by the background thread
+
+  // Records dropped because the ring was full
+  std::atomic<uint64_t> dropped_;
+
+  // Sleeping background thread
+  std::atomic<bool> idle_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+
+  std::thread worker_;
+  std::atomic<bool> running_;
+  bool stop_;
+
+  bool ready() {
+    return ring_[tail_ & mask_].seq.load() == tail_ + 1;
+  }
+
+  void run() {
+    uint64_t reported = 0;
+
+    while (true) {
+      if (!ready()) {
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported) {
+          fprintf(logfile ? logfile : stderr, "_QTrace_ [logging] %llu log "
+                  "messages dropped\n",
+                  static_cast<unsigned long long>(dropped - reported));
+          reported = dropped;
+        }
+        fflush(logfile ? logfile : stderr);
+
+        // Ring is empty: sleep until new records are published, or we are
+        // stopped. Producers check idle_ after publishing a record
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_ = true;
+        cond_.wait(lock, [&] { return ready() || stop_; });
+        idle_ = false;
+        if (!ready()) {
+          break;
+        }
+        continue;
+      }
+
+      Slot &slot = ring_[tail_ & mask_];
+      log_write(slot.record);
+      slot.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+      tail_++;
+    }
+  }
+
+ public:
+  explicit LogRing(unsigned int capacity)
+    : ring_(capacity), mask_(capacity - 1), head_(0), tail_(0), dropped_(0),
+      idle_(false), running_(false), stop_(false) {
+    assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    for (unsigned int i = 0; i < capacity; i++) {
+      ring_[i].seq = i;
+    }
+  }
+
+  bool isRunning() const {
+    return running_.load(std::memory_order_relaxed);
+  }
+
+  void start() {
+    assert(!running_);
+    worker_ = std::thread(&LogRing::run, this);
+    running_ = true;
+  }
+
+  // Format all pending records and stop the background thread
+  void stop() {
+    if (!running_.exchange(false)) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    worker_.join();
+  }
+
+  // Append a record. Returns false if the ring is full
+  bool push(const LogRecord &record) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    Slot *slot;
+
+    while (true) {
+      slot = &ring_[head & mask_];
+      int64_t diff = slot->seq.load(std::memory_order_acquire) - head;
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(head, head + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        head = head_.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->record = record;
+    slot->seq.store(head + 1);
+
+    if (idle_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cond_.notify_one();
+    }
+
+    return true;
+  }
+
+  uint64_t getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+};
+
+static LogRing *log_ring = NULL;
+
+static void log_atexit(void) {
+  log_ring->stop();
+  if (logfile) {
+    fflush(logfile);
+  }
+}
+
+void log_submit(const LogRecord &record) {
+  if (log_ring && log_ring->isRunning()) {
+    log_ring->push(record);
+  } else {
+    log_write(record);
+  }
+}
+
+int log_init(const char *filename) {
+  if (filename) {
+    // Initialize the log file
+    logfile = fopen(filename, "w+");
+    if (!logfile) {
+      ERROR("Cannot open log file for writing");
+      return -1;
+    }
+  }
+
+  // Start the background thread
+  if (!log_ring) {
+    log_ring = new LogRing(LOG_RING_SIZE);
+    log_ring->start();
+    atexit(log_atexit);
+  }
+
+  return 0;
+}
+
+char *qtrace_log_get_levels(void) {
+  std::string out;
+  std::vector<LogModule *> &modules = log_modules();
+  for (auto it = modules.begin(); it != modules.end(); it++) {
+    out += (*it)->name + ": " + log_level_name((*it)->level) + "\n";
+  }
+
+  if (log_ring) {
+    out += "Dropped messages: " + std::to_string(log_ring->getDropped()) +
+      "\n";
+  }
+
+  return strdup(out.c_str());
+}
+
+bool qtrace_log_set_level(const char *module, const char *level) {
+  int value = log_parse_level(level);
+  if (value < 0) {
+    return false;
+  }
 
-  fprintf(logfile ? logfile : stderr, "_QTrace_ %s[%s:%d] [%s] %s\n", pc, f, l,
-          tag, tmp);
+  return log_set_level(module, value);
 }
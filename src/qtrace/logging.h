@@ -1,10 +1,26 @@
 //
 // Copyright 2013, Roberto Paleari <roberto@greyhats.it>
 //
+// Log messages are not formatted by the thread that emits them. Log macros
+// store the format string pointer and the raw arguments (strings are copied)
+// in a fixed-size record, that is appended to a lock-free ring and formatted
+// by a background thread. If the ring is full, messages are dropped and
+// counted. Until log_init() starts the background thread, and after it has
+// been stopped at exit, messages are formatted synchronously.
+//
+// Each source file is a log module, named after the file (e.g., "memory" for
+// trace/memory.cc), whose level can be changed at runtime from the QEMU
+// monitor. A message above the level of its module costs a load and a branch.
+//
 
 #ifndef SRC_QTRACE_LOGGING_H_
 #define SRC_QTRACE_LOGGING_H_
 
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
 // Log levels:
 // 0 = NONE
 // 1 = ERROR
@@ -13,40 +29,56 @@
 // 4 = DEBUG
 // 5 = TRACE
 
-#define LOG_LEVEL 3
+// Highest level compiled in. Levels up to LOG_LEVEL can be enabled at runtime
+#define LOG_LEVEL 5
+
+// Initial level of all the log modules
+#define LOG_LEVEL_DEFAULT 3
 
 // Uncomment to include the program counter (i.e., TB address) in the debug
 // logs
 // #define LOG_PC
 
-#define LOG(level, ...) qtrace_log_(__FILE__, __LINE__, level, __VA_ARGS__)
+// Records store the format string pointer, and are formatted later by the
+// background thread: format strings must be literals ("" fails to compile
+// otherwise), and are checked against their arguments
+#define LOG(level, fmt, ...)                                            \
+  do {                                                                  \
+    if (log_enabled(qtrace_log_module, level)) {                        \
+      qtrace_log_(qtrace_log_module, level, __FILE__, __LINE__,         \
+                  "" fmt, ##__VA_ARGS__);                               \
+    }                                                                   \
+    if (0) {                                                            \
+      log_check_format(fmt, ##__VA_ARGS__);                             \
+    }                                                                   \
+  } while (0)
 
 #if LOG_LEVEL >= 5
-#define TRACE(...) LOG("TRA", __VA_ARGS__)
+#define TRACE(...) LOG(5, __VA_ARGS__)
 #else
 #define TRACE(...)
 #endif
 
 #if LOG_LEVEL >= 4
-#define DEBUG(...) LOG("DBG", __VA_ARGS__)
+#define DEBUG(...) LOG(4, __VA_ARGS__)
 #else
 #define DEBUG(...)
 #endif
 
 #if LOG_LEVEL >= 3
-#define INFO(...) LOG("INF", __VA_ARGS__)
+#define INFO(...) LOG(3, __VA_ARGS__)
 #else
 #define INFO(...)
 #endif
 
 #if LOG_LEVEL >= 2
-#define WARNING(...) LOG("WAR", __VA_ARGS__)
+#define WARNING(...) LOG(2, __VA_ARGS__)
 #else
 #define WARNING(...)
 #endif
 
 #if LOG_LEVEL >= 1
-#define ERROR(...) LOG("ERR", __VA_ARGS__)
+#define ERROR(...) LOG(1, __VA_ARGS__)
 #else
 #define ERROR(...)
 #endif
@@ -54,12 +86,126 @@
 /* Forward declaration */
 class Syscall;
 
-/* Initialize the logging subsystem */
+/* Never called, only lets the compiler check format strings of log messages
+   against their arguments */
+static inline void log_check_format(const char *fmt, ...)
+  __attribute__((format(printf, 1, 2)));
+static inline void log_check_format(const char *fmt, ...) {}
+
+struct LogModule {
+  std::string name;
+  std::atomic<int> level;
+};
+
+/* Get the log module of source file "file", registering it if needed */
+LogModule *log_register_module(const char *file);
+
+/* Log module of the current translation unit. NULL until static initializers
+   of this translation unit have run */
+static LogModule *const qtrace_log_module __attribute__((unused)) =
+  log_register_module(__BASE_FILE__);
+
+static inline bool log_enabled(const LogModule *module, int level) {
+  if (!module) {
+    return level <= LOG_LEVEL_DEFAULT;
+  }
+  return level <= module->level.load(std::memory_order_relaxed);
+}
+
+/* Set the level of module "name", or of all modules if "name" is NULL.
+   Returns false if there is no such module */
+bool log_set_level(const char *name, int level);
+
+/* Parse a level name ("none", "error", ..., "trace") or number. Returns -1 if
+   the level is invalid */
+int log_parse_level(const char *level);
+
+/* Get the name of a log level */
+const char *log_level_name(int level);
+
+/* Maximum number of arguments, and bytes of string arguments, of a message.
+   Exceeding arguments are printed as "<?>", strings are truncated */
+const unsigned int LOG_MAX_ARGS = 10;
+const unsigned int LOG_MAX_STRINGS = 160;
+
+/* A log message, as stored in the ring */
+struct LogRecord {
+  const LogModule *module;
+  const char *file;
+  const char *fmt;
+  unsigned int line;
+  int level;
+  uint64_t pc;                  // Only with LOG_PC, -1 if unknown
+  unsigned int nargs;
+  unsigned int strings_len;
+  union {
+    uint64_t u;
+    double d;
+  } args[LOG_MAX_ARGS];         // For strings, offset inside "strings"
+  char strings[LOG_MAX_STRINGS];
+};
+
+/* Initialize a record, with no arguments */
+void log_record_init(LogRecord *record, const LogModule *module, int level,
+                     const char *file, unsigned int line, const char *fmt);
+
+/* Append a string argument to a record */
+void log_record_arg(LogRecord *record, const char *s);
+
+static inline void log_record_arg(LogRecord *record, char *s) {
+  log_record_arg(record, static_cast<const char *>(s));
+}
+
+/* Append an integer, floating-point or pointer argument to a record */
+static inline void log_record_value(LogRecord *record, uint64_t value) {
+  if (record->nargs < LOG_MAX_ARGS) {
+    record->args[record->nargs].u = value;
+  }
+  record->nargs++;
+}
+
+template <typename T>
+static inline typename std::enable_if<std::is_integral<T>::value ||
+                                      std::is_enum<T>::value>::type
+log_record_arg(LogRecord *record, T value) {
+  log_record_value(record, static_cast<uint64_t>(value));
+}
+
+template <typename T>
+static inline typename std::enable_if<std::is_floating_point<T>::value>::type
+log_record_arg(LogRecord *record, T value) {
+  if (record->nargs < LOG_MAX_ARGS) {
+    record->args[record->nargs].d = value;
+  }
+  record->nargs++;
+}
+
+template <typename T>
+static inline void log_record_arg(LogRecord *record, T *value) {
+  log_record_value(record, reinterpret_cast<uintptr_t>(value));
+}
+
+/* Format a record, as printf() would have formatted its format string and
+   arguments (without the message header) */
+std::string log_format(const LogRecord &record);
+
+/* Queue a record for formatting, or format it now if the logger is not
+   running */
+void log_submit(const LogRecord &record);
+
+/* Initialize the logging subsystem, and start the background thread */
 int log_init(const char *filename);
 
 /* Internal logging function. Log macros eventually use this function to write
    log messages. Should not be directly invoked by external modules */
-void qtrace_log_(const char *f, unsigned int l, const char *tag, 
-                 const char *fmt, ...);
+template <typename... Args>
+void qtrace_log_(const LogModule *module, int level, const char *f,
+                 unsigned int l, const char *fmt, Args... args) {
+  LogRecord record;
+  log_record_init(&record, module, level, f, l, fmt);
+  int unused[] = { 0, (log_record_arg(&record, args), 0)... };
+  (void) unused;
+  log_submit(record);
+}
 
 #endif  // SRC_QTRACE_LOGGING_H_
@@ -4,6 +4,7 @@
 
 #include "qtrace/monitor.h"
 #include "qtrace/gate.h"
+#include "qtrace/hooks.h"
 
 void qtrace_qmp_qtrace_enable(Monitor *mon, const QDict *qdict) {
 #ifdef CONFIG_QTRACE_SYSCALL
@@ -23,6 +24,42 @@ void qtrace_qmp_qtrace_query(Monitor *mon, const QDict *qdict) {
 #endif
 }
 
+/* Print to the monitor passed as "stream", as monitor_fprintf() does */
+static int GCC_FMT_ATTR(2, 3) qtrace_monitor_fprintf(FILE *stream,
+                                                     const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  monitor_vprintf((Monitor *)stream, fmt, ap);
+  va_end(ap);
+  return 0;
+}
+
+void qtrace_qmp_qtrace_hooks(Monitor *mon, const QDict *qdict) {
+  if (qdict_haskey(qdict, "cycles")) {
+    qtrace_hooks_set_cycles(qdict_get_bool(qdict, "cycles"));
+  }
+
+  monitor_printf(mon, "QTrace hook cycle accounting is currently %s\n",
+                 qtrace_hook_cycles ? "ON" : "OFF");
+  qtrace_hooks_dump((FILE *)mon, qtrace_monitor_fprintf);
+}
+
+void qtrace_qmp_qtrace_log_level(Monitor *mon, const QDict *qdict) {
+  const char *level = qdict_get_try_str(qdict, "level");
+  const char *module = qdict_get_try_str(qdict, "module");
+  char *levels;
+
+  if (level && !qtrace_log_set_level(module, level)) {
+    monitor_printf(mon, "Invalid log level '%s' or module '%s'\n", level,
+                   module ? module : "all");
+    return;
+  }
+
+  levels = qtrace_log_get_levels();
+  monitor_printf(mon, "%s", levels);
+  free(levels);
+}
+
 #ifdef CONFIG_QTRACE_SYSCALL
 void qtrace_qmp_tracer_enable(Monitor *mon, const QDict *qdict) {
   bool state = qdict_get_bool(qdict, "enabled");
@@ -31,9 +68,44 @@ void qtrace_qmp_tracer_enable(Monitor *mon, const QDict *qdict) {
 
 void qtrace_qmp_tracer_query(Monitor *mon, const QDict *qdict) {
   bool state = qtrace_gate_tracer_get_state();
+  const char *expr;
+  uint64_t accepted, rejected;
+
   monitor_printf(mon, "QTrace syscall tracer is currently %s\n",
 		 state ? "ON" : "OFF");
 
+  if (qtrace_gate_tracer_get_output_filter(&expr, &accepted, &rejected)) {
+    monitor_printf(mon, "Output filter: %s (accepted %" PRIu64
+                   ", rejected %" PRIu64 ")\n", expr, accepted, rejected);
+  }
+
+}
+
+void qtrace_qmp_tracer_sampling(Monitor *mon, const QDict *qdict) {
+  const char *spec = qdict_get_try_str(qdict, "policy");
+  uint64_t sampled, skipped;
+
+  if (spec && !qtrace_gate_tracer_set_sampling(spec)) {
+    monitor_printf(mon, "Invalid sampling policy '%s'\n", spec);
+    return;
+  }
+
+  qtrace_gate_tracer_get_sampling(&spec, &sampled, &skipped);
+  monitor_printf(mon, "QTrace sampling policy is %s (sampled %" PRIu64
+                 ", skipped %" PRIu64 ")\n", spec, sampled, skipped);
+}
+
+void qtrace_qmp_tracer_stats(Monitor *mon, const QDict *qdict) {
+  const char *syscall = qdict_get_try_str(qdict, "syscall");
+  char *stats = qtrace_gate_tracer_get_stats(syscall);
+
+  if (!stats) {
+    monitor_printf(mon, "Unknown system call '%s'\n", syscall);
+    return;
+  }
+
+  monitor_printf(mon, "%s", stats);
+  free(stats);
 }
 #endif
 
@@ -3,8 +3,15 @@
 //
 
 #include <algorithm>
+#include <sstream>
 #include <string>
 
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
 #include "qtrace/options.h"
 
 const char* qtrace_get_profile_name(const enum QTraceProfile profile) {
@@ -39,3 +46,92 @@ enum QTraceProfile qtrace_parse_profile(const char *profilestring) {
 
   return profile;
 }
+
+const char* qtrace_get_layout_mode_name(const enum QTraceLayoutMode mode) {
+  const char *name;
+  switch (mode) {
+  case LayoutDisabled:
+    name = "OFF";
+    break;
+  case LayoutSyscall:
+    name = "per syscall";
+    break;
+  case LayoutCaller:
+    name = "per syscall and caller";
+    break;
+  case LayoutUnknown:
+  default:
+    name = "Unknown";
+    break;
+  }
+  return name;
+}
+
+enum QTraceLayoutMode qtrace_parse_layout_mode(const char *modestring) {
+  std::string str(modestring);
+  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+
+  enum QTraceLayoutMode mode;
+  if (str == "off") {
+    mode = LayoutDisabled;
+  } else if (str == "syscall") {
+    mode = LayoutSyscall;
+  } else if (str == "caller") {
+    mode = LayoutCaller;
+  } else {
+    mode = LayoutUnknown;
+  }
+
+  return mode;
+}
+
+int qtrace_parse_uint(const char *uintstring, unsigned int *value) {
+  // strtoul() accepts leading blanks and signs
+  if (!isdigit(static_cast<unsigned char>(uintstring[0]))) {
+    return -1;
+  }
+
+  char *end;
+  errno = 0;
+  unsigned long v = strtoul(uintstring, &end, 0);
+  if (errno != 0 || *end != '\0' || v > UINT_MAX) {
+    return -1;
+  }
+
+  *value = v;
+  return 0;
+}
+
+int qtrace_parse_capture_limits(const char *limitsstring,
+                                struct CaptureLimits *limits) {
+  memset(limits, 0, sizeof(*limits));
+
+  std::stringstream ss(limitsstring);
+  std::string limit;
+  while (std::getline(ss, limit, ',')) {
+    size_t sep = limit.find('=');
+    if (sep == std::string::npos) {
+      return -1;
+    }
+
+    std::string name = limit.substr(0, sep);
+    unsigned int *value;
+    if (name == "arg") {
+      value = &limits->arg_bytes;
+    } else if (name == "syscall") {
+      value = &limits->syscall_bytes;
+    } else if (name == "depth") {
+      value = &limits->depth;
+    } else if (name == "candidates") {
+      value = &limits->candidates;
+    } else {
+      return -1;
+    }
+
+    if (qtrace_parse_uint(limit.c_str() + sep + 1, value) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
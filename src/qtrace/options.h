@@ -15,6 +15,21 @@ enum QTraceProfile {
   ProfileWindows7SP1,
 };
 
+enum QTraceLayoutMode {
+  LayoutDisabled = 0,
+  LayoutSyscall,                // Layouts keyed by syscall number
+  LayoutCaller,                 // Layouts keyed by syscall number and caller
+  LayoutUnknown,
+};
+
+// Upper bounds on the data captured for a system call. Zero means no limit
+struct CaptureLimits {
+  unsigned int arg_bytes;       // Data bytes per argument
+  unsigned int syscall_bytes;   // Data bytes per system call
+  unsigned int depth;           // Nesting depth of data pointers
+  unsigned int candidates;      // Candidate data pointers
+};
+
 struct QTraceOptions {
 #ifdef CONFIG_QTRACE_SYSCALL
   // Disable syscall tracer
@@ -38,12 +53,52 @@ struct QTraceOptions {
 
   // Tracking of foreign data pointers
   bool track_foreign;
+
+  // Serialize syscalls using the compact (version 2) trace format
+  bool trace_compact;
+
+  // Minimum size of data payloads to deduplicate (0 to disable)
+  unsigned int dedup_threshold;
+
+  // Write a columnar summary of the trace (in directory "<trace>.cols")
+  bool trace_columns;
+
+  // Comma-separated list of kernel copy routines (NAME=ADDRESS)
+  const char *copy_routines;
+
+  // Read level-0 syscall arguments with a single access at syscall entry
+  bool snapshot_args;
+
+  // Cache of syscall argument layouts
+  enum QTraceLayoutMode layout_mode;
+
+  // Capture limits for syscall arguments, as a comma-separated list of
+  // NAME=VALUE entries
+  const char *capture_limits;
+
+  // Sampling policy for traced system calls
+  const char *sampling;
+
+  // Predicate on completed system calls, to select the ones to serialize
+  const char *output_filter;
+
+  // Reconstruct syscall arguments on a worker thread
+  bool async_events;
+
+  // Account the host time spent inside QTrace to each system call
+  bool host_time;
 #endif
 
 #ifdef CONFIG_QTRACE_TAINT
   // Disable taint-propagation engine
   bool taint_disabled;
 #endif
+
+  // Account host cycles spent inside each hook, and report them at exit
+  bool hook_stats;
+
+  // Write a Linux perf map of translated code to /tmp/perf-<pid>.map
+  bool perfmap;
 };
 
 #ifdef __cplusplus
@@ -51,6 +106,19 @@ extern "C" {
 #endif
   enum QTraceProfile qtrace_parse_profile(const char *profilestring);
   const char *qtrace_get_profile_name(const enum QTraceProfile profile);
+  enum QTraceLayoutMode qtrace_parse_layout_mode(const char *modestring);
+  const char *qtrace_get_layout_mode_name(const enum QTraceLayoutMode mode);
+
+  // Parse an unsigned integer (decimal, or hexadecimal with a "0x" prefix),
+  // that must span the whole string. Returns 0 on success, or -1 if the
+  // string is malformed or out of range
+  int qtrace_parse_uint(const char *uintstring, unsigned int *value);
+
+  // Parse capture limits, given as a comma-separated list of NAME=VALUE
+  // entries, into @limits. Limits not in the list are set to zero. Returns 0
+  // on success, or -1 if the list is malformed
+  int qtrace_parse_capture_limits(const char *limitsstring,
+                                  struct CaptureLimits *limits);
 #ifdef __cplusplus
 }
 #endif
@@ -42,16 +42,32 @@ struct QTraceOptions qtrace_options = {
   NULL,                         // filter_syscalls
   NULL,                         // filter_process
   false,                        // track_foreign
+  false,                        // trace_compact
+  0,                            // dedup_threshold
+  false,                        // trace_columns
+  NULL,                         // copy_routines
+  false,                        // snapshot_args
+  LayoutDisabled,               // layout_mode
+  NULL,                         // capture_limits
+  NULL,                         // sampling
+  NULL,                         // output_filter
+  false,                        // async_events
+  false,                        // host_time
 #endif
 #ifdef CONFIG_QTRACE_TAINT
   false,                        // taint_disabled
 #endif
+  false,                        // hook_stats
+  false,                        // perfmap
 };
 
 int qtrace_initialize(qtrace_func_memread func_peek,
                       qtrace_func_regread func_regs,
                       qtrace_func_tbflush func_tbflush,
-                      qtrace_func_va2phy func_va2phy) {
+                      qtrace_func_va2phy func_va2phy,
+                      qtrace_func_memmap func_memmap,
+                      qtrace_func_icount func_icount,
+                      qtrace_func_event func_event) {
   DEBUG("Initalization started");
   assert(!qtrace_initialized);
 
@@ -66,9 +82,10 @@ int qtrace_initialize(qtrace_func_memread func_peek,
   memset(&gbl_context, 0, sizeof(gbl_context));
 
   // Set QEMU callbacks
-  assert(func_tbflush && func_va2phy);
+  assert(func_tbflush && func_va2phy && func_event);
   gbl_context.cb_tbflush = func_tbflush;
   gbl_context.cb_va2phy = func_va2phy;
+  gbl_context.cb_event = func_event;
 
   // Copy command-line options
   memcpy(&gbl_context.options, &qtrace_options, sizeof(gbl_context.options));
@@ -78,16 +95,25 @@ int qtrace_initialize(qtrace_func_memread func_peek,
   CHECK(log_init(gbl_context.options.filename_log), "Log");
 
   // Syscall tracing setup
-  assert(func_peek && func_regs);
+  assert(func_peek && func_regs && func_memmap && func_icount);
   gbl_context.cb_peek = func_peek;
   gbl_context.cb_regs = func_regs;
+  gbl_context.cb_memmap = func_memmap;
+  gbl_context.cb_icount = func_icount;
 
   CHECK(windows_init(&gbl_context.windows), "Windows");
   CHECK(serialize_init(), "Serialize");
 
+  stats_host_time = gbl_context.options.host_time;
   gbl_context.tracer_enabled = !gbl_context.options.trace_disabled;
+  qtrace_tracer_enabled = gbl_context.tracer_enabled;
   gbl_context.trace_manager =
     new TraceManager(gbl_context.options.track_foreign,
+                     gbl_context.options.snapshot_args,
+                     gbl_context.options.async_events,
+                     gbl_context.options.layout_mode,
+                     gbl_context.options.capture_limits,
+                     gbl_context.options.sampling,
                      gbl_context.options.filter_syscalls,
                      gbl_context.options.filter_process);
 #endif
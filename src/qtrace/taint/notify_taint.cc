@@ -36,6 +36,9 @@ static inline hwaddr notify_taint_isbadphy(hwaddr phyaddr) {
 }
 
 void notify_taint_register(bool istmp, unsigned char regno, int label) {
+  if (!istmp) {
+    context_event(QTRACE_EVENT_TAINT_SOURCE_REG, label, regno);
+  }
   gbl_context.taint_engine->setTaintedRegister(label, istmp, regno);
 }
 
@@ -45,6 +48,7 @@ void notify_taint_memory(target_ulong addr, unsigned int size, int label) {
     WARNING("VA %.8x is invalid, can't taint it", addr);
     return;
   }
+  context_event(QTRACE_EVENT_TAINT_SOURCE_MEM, label, addr, size);
   gbl_context.taint_engine->setTaintedMemory(label, phyaddr, size);
 }
 
@@ -60,7 +64,8 @@ void notify_taint_moveM2R(target_ulong addr, int size,
                           bool istmp, target_ulong reg) {
   hwaddr phyaddr = notify_taint_va2phy(addr, size);
   if (notify_taint_isbadphy(phyaddr)) {
-    WARNING("Invalid address (VA: %.8x, PHY: %.8x)", addr, phyaddr);
+    WARNING("Invalid address (VA: %.8x, PHY: %.8llx)", addr,
+            static_cast<unsigned long long>(phyaddr));
     return;
   }
   gbl_context.taint_engine->moveM2R(phyaddr, size, istmp, reg);
@@ -70,7 +75,8 @@ void notify_taint_moveR2M(bool istmp, target_ulong reg,
                           target_ulong addr, int size) {
   hwaddr phyaddr = notify_taint_va2phy(addr, size);
   if (notify_taint_isbadphy(phyaddr)) {
-    WARNING("Invalid address (VA: %.8x, PHY: %.8x)", addr, phyaddr);
+    WARNING("Invalid address (VA: %.8x, PHY: %.8llx)", addr,
+            static_cast<unsigned long long>(phyaddr));
     return;
   }
   gbl_context.taint_engine->moveR2M(istmp, reg, phyaddr, size);
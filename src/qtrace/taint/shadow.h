@@ -105,6 +105,11 @@ public:
     return mem_.at(addr).get();
   }
 
+  // Number of tainted bytes
+  inline size_t size() const {
+    return mem_.size();
+  }
+
 private:
   shadowmemory_t mem_;
 };
@@ -5,6 +5,7 @@
 #include "qtrace/taint/taintengine.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "qtrace/context.h"
 #include "qtrace/logging.h"
@@ -17,6 +18,7 @@
 
 bool qtrace_taint_enabled = false;
 bool qtrace_instrument = false;
+QTraceTaintCache qtrace_taint_cache;
 
 void TaintEngine::setEnabled(bool status) {
   qtrace_taint_enabled = status;
@@ -100,6 +102,7 @@ void TaintEngine::setTaintedMemory(int label, target_ulong addr,
   for (unsigned int i = 0; i < size; i++) {
     mem_.addLabel(addr+i, label);
   }
+  _updateMemoryCache();
 }
 
 bool TaintEngine::isTaintedMemory(target_ulong addr, unsigned int size) const {
@@ -125,6 +128,7 @@ void TaintEngine::clearRegister(bool tmp, target_ulong regno) {
 
 void TaintEngine::clearMemory(target_ulong addr, int size) {
   mem_.clear(addr, size);
+  _updateMemoryCache();
 }
 
 void TaintEngine::moveR2R(bool srctmp, target_ulong src,
@@ -234,6 +238,7 @@ void TaintEngine::moveR2M(bool regtmp, target_ulong reg,
       mem_.set(regobj->getTaintLocation(i), addr+i);
     }
   }
+  _updateMemoryCache();
 }
 
 void TaintEngine::combineR2M(bool regtmp, target_ulong reg,
@@ -245,15 +250,16 @@ void TaintEngine::combineR2M(bool regtmp, target_ulong reg,
       mem_.combine(regobj->getTaintLocation(i), addr+i);
     }
   }
+  _updateMemoryCache();
 }
 
 void TaintEngine::clearTempRegisters() {
   for (int regno = 0; regno < NUM_TMP_REGS; regno++) {
-    if (regcache_tmp_[regno]) {
+    if (isTaintedRegister(true, regno)) {
       tmpregs_[regno].clear();
     }
   }
-  regcache_tmp_.reset();
+  memset(qtrace_taint_cache.tmp, 0, sizeof(qtrace_taint_cache.tmp));
 }
 
 void TaintEngine::copyMemoryLabels(std::set<int> &labels,
@@ -6,14 +6,14 @@
 #define SRC_QTRACE_TAINT_TAINTENGINE_H_
 
 #include <cassert>
-#include <bitset>
 #include <set>
 #include <memory>
 
+#include "qtrace/fastpath.h"
 #include "qtrace/taint/shadow.h"
 
-const int NUM_CPU_REGS = 16;
-const int NUM_TMP_REGS = 512;
+const int NUM_CPU_REGS = QTRACE_TAINT_CPU_REGS;
+const int NUM_TMP_REGS = QTRACE_TAINT_TMP_REGS;
 
 //
 // The TaintEngine class implements the logic of the taint engine.
@@ -22,9 +22,14 @@ const int NUM_TMP_REGS = 512;
 // ShadowRegister instances, exposing APIs to set, clear and propagate taint
 // information.
 //
+// The engine keeps the taint cache exported to QEMU (qtrace_taint_cache) up to
+// date, thus only one instance at a time can be used.
+//
 class TaintEngine {
  public:
-  explicit TaintEngine() : taint_user_enabled_(true) {}
+  explicit TaintEngine() : taint_user_enabled_(true) {
+    qtrace_taint_cache = QTraceTaintCache();
+  }
 
   // Enable/disable the taint propagation engine
   void setEnabled(bool status);
@@ -58,7 +63,7 @@ class TaintEngine {
                          int size = -1);
 
   inline bool isTaintedRegister(bool istmp, target_ulong regno) const {
-    return istmp ? regcache_tmp_[regno] : regcache_cpu_[regno];
+    return qtrace_fastpath_reg_tainted(istmp, regno);
   }
 
   inline bool hasRegisterLabel(bool tmp, target_ulong reg, int label) {
@@ -95,10 +100,6 @@ class TaintEngine {
   void combineM2R(target_ulong addr, int size, bool regtmp, target_ulong reg);
 
  private:
-  // Caches used to efficiently check if a register is tainted
-  std::bitset<NUM_CPU_REGS> regcache_cpu_;
-  std::bitset<NUM_TMP_REGS> regcache_tmp_;
-
   // User-controlled status
   bool taint_user_enabled_;
 
@@ -111,12 +112,20 @@ class TaintEngine {
 
   inline void _updateRegisterCache(bool istmp, target_ulong regno,
                                    bool tainted) {
-    if (istmp) {
-      regcache_tmp_[regno] = tainted;
+    uint64_t *word = istmp ?
+      &qtrace_taint_cache.tmp[regno / 64] : &qtrace_taint_cache.cpu;
+    uint64_t bit = 1ULL << (regno % 64);
+
+    if (tainted) {
+      *word |= bit;
     } else {
-      regcache_cpu_[regno] = tainted;
+      *word &= ~bit;
     }
   }
+
+  inline void _updateMemoryCache() {
+    qtrace_taint_cache.mem = mem_.size();
+  }
 };
 
 #endif  // SRC_QTRACE_TAINT_TAINTENGINE_H_
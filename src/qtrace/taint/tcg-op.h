@@ -2,6 +2,8 @@
 // Copyright 2014, Roberto Paleari <roberto@greyhats.it>
 //
 
+#include "qtrace/fastpath.h"
+#include "qtrace/hooks.h"
 #include "qtrace/taint.h"
 #include "qtrace/taint/notify_taint.h"
 
@@ -33,6 +35,13 @@
 #define QTRACE_ASSERT_TAINTED     0xabadb00b
 #define QTRACE_ASSERT_NOT_TAINTED (QTRACE_ASSERT_TAINTED + 1)
 
+/* Call flags of QTrace TCG helpers. Helpers receive registers as TCG indices
+   and only access their shadow state, thus they never read or write guest
+   globals. Idempotent helpers can be coalesced by the TCG optimizer */
+#define QTRACE_CALL            TCG_CALL_NO_RWG
+#define QTRACE_CALL_IDEMPOTENT (QTRACE_CALL | TCG_CALL_QTRACE_IDEMPOTENT)
+#define QTRACE_CALL_DEF        (QTRACE_CALL_IDEMPOTENT | TCG_CALL_QTRACE_DEF)
+
 /* Easy expression of flag-based conditions */
 #define FLG(v, f) (((v) & (f)) != 0)
 
@@ -47,24 +56,47 @@ static inline target_ulong register_temp_index(target_ulong idx) {
   return idx - tcg_ctx.nb_globals;
 }
 
+/* Check if the register with TCG index "idx" is tainted, without calling into
+   the taint engine */
+static inline bool register_is_tainted(target_ulong idx) {
+  bool istmp = register_is_temp(idx);
+  return qtrace_fastpath_reg_tainted(istmp, REG_IDX(istmp, idx));
+}
+
 static void tcg_helper_qtrace_assert(target_ulong reg, target_ulong istrue) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_ASSERT);
   assert(!register_is_temp(reg));
   notify_taint_assert(REG_IDX(false, reg), istrue);
 }
 
 static void tcg_helper_qtrace_reg2mem(target_ulong reg, target_ulong addr,
                                      int size) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_REG2MEM);
+  if (!register_is_tainted(reg) && !qtrace_fastpath_mem_tainted()) {
+    return;
+  }
+
   bool istmp = register_is_temp(reg);
   notify_taint_moveR2M(istmp, REG_IDX(istmp, reg), addr, size);
 }
 
 static void tcg_helper_qtrace_mem2reg(target_ulong reg, target_ulong addr,
                                      int size) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_MEM2REG);
+  if (!register_is_tainted(reg) && !qtrace_fastpath_mem_tainted()) {
+    return;
+  }
+
   bool istmp = register_is_temp(reg);
   notify_taint_moveM2R(addr, size, istmp, REG_IDX(istmp, reg));
 }
 
 static void tcg_helper_qtrace_mov(target_ulong ret, target_ulong arg) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_MOV);
+  if (!register_is_tainted(arg) && !register_is_tainted(ret)) {
+    return;
+  }
+
   bool srctmp = register_is_temp(arg);
   bool dsttmp = register_is_temp(ret);
   notify_taint_moveR2R(srctmp, REG_IDX(srctmp, arg),
@@ -72,11 +104,21 @@ static void tcg_helper_qtrace_mov(target_ulong ret, target_ulong arg) {
 }
 
 static void tcg_helper_qtrace_clearR(target_ulong reg) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_CLEARR);
+  if (!register_is_tainted(reg)) {
+    return;
+  }
+
   bool istmp = register_is_temp(reg);
   notify_taint_clearR(istmp, REG_IDX(istmp, reg));
 }
 
 static inline void tcg_helper_qtrace_endtb(void) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_ENDTB);
+  if (!qtrace_fastpath_tmp_tainted()) {
+    return;
+  }
+
   notify_taint_endtb();
 }
 
@@ -86,7 +128,9 @@ static inline void tcg_helper_qtrace_endtb(void) {
    labels(A) = labels(A) | labels(B)
  */
 static void tcg_helper_qtrace_combine2(target_ulong dst, target_ulong src) {
-  if (src == dst) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_COMBINE2);
+
+  if (src == dst || !register_is_tainted(src)) {
     return;
   }
 
@@ -104,6 +148,12 @@ static void tcg_helper_qtrace_combine2(target_ulong dst, target_ulong src) {
  */
 static void tcg_helper_qtrace_combine3(target_ulong dst, target_ulong op1,
                                       target_ulong op2) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_COMBINE3);
+  if (!register_is_tainted(dst) && !register_is_tainted(op1) &&
+      !register_is_tainted(op2)) {
+    return;
+  }
+
   bool dsttmp = register_is_temp(dst);
 
   /* Clear destination first! */
@@ -130,10 +180,16 @@ static void tcg_helper_qtrace_combine3(target_ulong dst, target_ulong op1,
 static void tcg_helper_qtrace_deposit(target_ulong dst,
                                      target_ulong op1, target_ulong op2,
                                      unsigned int ofs, unsigned int len) {
+  QTRACE_HOOK_SCOPE(QTRACE_HOOK_TAINT_DEPOSIT);
   /* We currently support only byte-level deposit instructions, also because
      taint-tracking is performed at the byte-level */
   assert((ofs % 8) == 0 && (len % 8) == 0 && (ofs+len) <= 32);
 
+  if (!register_is_tainted(dst) && !register_is_tainted(op1) &&
+      !register_is_tainted(op2)) {
+    return;
+  }
+
   bool dsttmp = register_is_temp(dst);
   bool op2tmp = register_is_temp(op2);
 
@@ -156,9 +212,9 @@ static void tcg_helper_qtrace_deposit(target_ulong dst,
   if (FLG((flg), QTRACE_TAINT_CONST_WRAP)) { tcg_temp_free_i32(args[num]); }
 
 #define OP_CALL_HELPER()                                                \
-  tcg_gen_helperN(helper, 0, sizemask, TCG_CALL_DUMMY_ARG, sizeof(args)/sizeof(TCGArg), args);
+  tcg_gen_helperN(helper, flags, sizemask, TCG_CALL_DUMMY_ARG, sizeof(args)/sizeof(TCGArg), args);
 
-static inline void tcg_gen_qtrace_op1(void *helper,
+static inline void tcg_gen_qtrace_op1(void *helper, int flags,
                                      TCGArg a1, int a1_f) {
   int sizemask = 0;
   TCGArg args[1];
@@ -174,7 +230,7 @@ static inline void tcg_gen_qtrace_op1(void *helper,
   QTRACE_INSTRUMENT_END();
 }
 
-static inline void tcg_gen_qtrace_op2(void *helper,
+static inline void tcg_gen_qtrace_op2(void *helper, int flags,
                                      TCGArg a1, int a1_f,
                                      TCGArg a2, int a2_f) {
   int sizemask = 0;
@@ -193,7 +249,7 @@ static inline void tcg_gen_qtrace_op2(void *helper,
   QTRACE_INSTRUMENT_END();
 }
 
-static inline void tcg_gen_qtrace_op3(void *helper,
+static inline void tcg_gen_qtrace_op3(void *helper, int flags,
                                      TCGArg a1, int a1_f,
                                      TCGArg a2, int a2_f,
                                      TCGArg a3, int a3_f) {
@@ -215,7 +271,7 @@ static inline void tcg_gen_qtrace_op3(void *helper,
   QTRACE_INSTRUMENT_END();
 }
 
-static inline void tcg_gen_qtrace_op5(void *helper,
+static inline void tcg_gen_qtrace_op5(void *helper, int flags,
                                      TCGArg a1, int a1_f,
                                      TCGArg a2, int a2_f,
                                      TCGArg a3, int a3_f,
@@ -245,44 +301,46 @@ static inline void tcg_gen_qtrace_op5(void *helper,
 
 #undef OP_SET_ARG
 #undef OP_FREE_ARG
+#undef OP_CALL_HELPER
 
 static inline void tcg_gen_qtrace_endtb(void) {
   QTRACE_INSTRUMENT_START();
 
-  tcg_gen_helperN(tcg_helper_qtrace_endtb, 0, 0, TCG_CALL_DUMMY_ARG, 0, NULL);
+  tcg_gen_helperN(tcg_helper_qtrace_endtb, QTRACE_CALL_IDEMPOTENT, 0,
+                  TCG_CALL_DUMMY_ARG, 0, NULL);
 
   QTRACE_INSTRUMENT_END();
 }
 
 static inline void tcg_gen_qtrace_qemu_ld(TCGv arg, TCGv addr, int size) {
-  tcg_gen_qtrace_op3(tcg_helper_qtrace_mem2reg,
+  tcg_gen_qtrace_op3(tcg_helper_qtrace_mem2reg, QTRACE_CALL,
                     GET_TCGV_I32(arg), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(addr), 0,
                     size, QTRACE_TAINT_CONST_WRAP | QTRACE_TAINT_SIGNED);
 }
 
 static inline void tcg_gen_qtrace_qemu_st(TCGv arg, TCGv addr, int size) {
-  tcg_gen_qtrace_op3(tcg_helper_qtrace_reg2mem,
+  tcg_gen_qtrace_op3(tcg_helper_qtrace_reg2mem, QTRACE_CALL,
                     GET_TCGV_I32(arg), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(addr), 0,
                     size, QTRACE_TAINT_CONST_WRAP | QTRACE_TAINT_SIGNED);
 }
 
 static inline void tcg_gen_qtrace_mov(TCGv_i32 ret, TCGv_i32 arg) {
-  tcg_gen_qtrace_op2(tcg_helper_qtrace_mov,
+  tcg_gen_qtrace_op2(tcg_helper_qtrace_mov, QTRACE_CALL_DEF,
                     GET_TCGV_I32(ret), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(arg), QTRACE_TAINT_CONST_WRAP);
 }
 
 static inline void tcg_gen_qtrace_clearR(TCGv_i32 ret) {
-  tcg_gen_qtrace_op1(tcg_helper_qtrace_clearR,
+  tcg_gen_qtrace_op1(tcg_helper_qtrace_clearR, QTRACE_CALL_DEF,
                     GET_TCGV_I32(ret), QTRACE_TAINT_CONST_WRAP);
 }
 
 static inline void tcg_gen_qtrace_combine2(TCGOpcode opc,
                                           TCGv_i32 ret, TCGv_i32 arg) {
   assert(!TCGV_EQUAL_I32(ret, arg));
-  tcg_gen_qtrace_op2(tcg_helper_qtrace_combine2,
+  tcg_gen_qtrace_op2(tcg_helper_qtrace_combine2, QTRACE_CALL_IDEMPOTENT,
                     GET_TCGV_I32(ret), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(arg), QTRACE_TAINT_CONST_WRAP);
 }
@@ -290,7 +348,7 @@ static inline void tcg_gen_qtrace_combine2(TCGOpcode opc,
 static inline void tcg_gen_qtrace_combine3(TCGOpcode opc, TCGv_i32 ret,
                                           TCGv_i32 arg1, TCGv_i32 arg2) {
   assert(!TCGV_EQUAL_I32(arg1, arg2));
-  tcg_gen_qtrace_op3(tcg_helper_qtrace_combine3,
+  tcg_gen_qtrace_op3(tcg_helper_qtrace_combine3, QTRACE_CALL_DEF,
                     GET_TCGV_I32(ret), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(arg1), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(arg2), QTRACE_TAINT_CONST_WRAP);
@@ -299,7 +357,7 @@ static inline void tcg_gen_qtrace_combine3(TCGOpcode opc, TCGv_i32 ret,
 static inline void tcg_gen_qtrace_deposit(TCGv_i32 ret, TCGv_i32 arg1,
                                          TCGv_i32 arg2, unsigned int ofs,
                                          unsigned int len) {
-  tcg_gen_qtrace_op5(tcg_helper_qtrace_deposit,
+  tcg_gen_qtrace_op5(tcg_helper_qtrace_deposit, QTRACE_CALL,
                     GET_TCGV_I32(ret), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(arg1), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(arg2), QTRACE_TAINT_CONST_WRAP,
@@ -308,7 +366,7 @@ static inline void tcg_gen_qtrace_deposit(TCGv_i32 ret, TCGv_i32 arg1,
 }
 
 static inline void tcg_gen_qtrace_assert(TCGv reg, bool istrue) {
-  tcg_gen_qtrace_op2(tcg_helper_qtrace_assert,
+  tcg_gen_qtrace_op2(tcg_helper_qtrace_assert, QTRACE_CALL,
                     GET_TCGV_I32(reg), QTRACE_TAINT_CONST_WRAP,
                     GET_TCGV_I32(istrue), QTRACE_TAINT_CONST_WRAP);
 }
@@ -43,10 +43,13 @@ static void track_syscall_arg(SyscallArg *arg, target_ulong label) {
   if (arg->direction == DirectionIn) {
     if (notify_taint_check_memory(arg->addr, arg->getSize())) {
       TRACE("Found tainted IN | IN/OUT arg in range %.8x-%.8x "
-            "[phy %.8x-%.8x]",
+            "[phy %.8llx-%.8llx]",
             arg->addr, arg->addr + arg->getSize() - 1,
-            gbl_context.cb_va2phy(arg->addr),
-            gbl_context.cb_va2phy(arg->addr + arg->getSize() - 1));
+            static_cast<unsigned long long>(gbl_context.cb_va2phy(arg->addr)),
+            static_cast<unsigned long long>(
+              gbl_context.cb_va2phy(arg->addr + arg->getSize() - 1)));
+      context_event(QTRACE_EVENT_TAINT_SINK, label, arg->addr,
+                    arg->getSize());
       track_copy_input_labels(arg);
     }
   }
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../digest.h"
+
+// Reference MurmurHash3 x64 128-bit values, covering blocks and all tails
+TEST(DigestTest, Reference) {
+  PayloadDigest digest = digest_compute(std::string());
+  EXPECT_EQ(0, digest.h1);
+  EXPECT_EQ(0, digest.h2);
+  EXPECT_EQ(0, digest.length);
+
+  digest = digest_compute(std::string("hello"));
+  EXPECT_EQ(0xcbd8a7b341bd9b02ULL, digest.h1);
+  EXPECT_EQ(0x5b1e906a48ae1d19ULL, digest.h2);
+  EXPECT_EQ(5, digest.length);
+
+  digest = digest_compute(
+    std::string("The quick brown fox jumps over the lazy dog"));
+  EXPECT_EQ(0xe34bbc7bbc071b6cULL, digest.h1);
+  EXPECT_EQ(0x7a433ca9c49a9347ULL, digest.h2);
+
+  unsigned char bytes[32];
+  for (unsigned int i = 0; i < sizeof(bytes); i++) {
+    bytes[i] = i;
+  }
+
+  digest = digest_compute(bytes, 25);
+  EXPECT_EQ(0x3bbe7cb52ee982cbULL, digest.h1);
+  EXPECT_EQ(0xa2d35433beef9ffcULL, digest.h2);
+
+  digest = digest_compute(bytes, 32);
+  EXPECT_EQ(0xc66d9022b62f500fULL, digest.h1);
+  EXPECT_EQ(0x1c050a6e34c31151ULL, digest.h2);
+
+  digest = digest_compute("hello", 5, 42);
+  EXPECT_EQ(0xc4b8b3c960af6f08ULL, digest.h1);
+  EXPECT_EQ(0x2334b875b0efbc7aULL, digest.h2);
+}
+
+// Payloads that only differ in trailing zeroes have different digests
+TEST(DigestTest, Length) {
+  std::string data(16, '\0');
+  EXPECT_FALSE(digest_compute(data) == digest_compute(data.substr(0, 15)));
+  EXPECT_TRUE(digest_compute(data) == digest_compute(std::string(16, '\0')));
+}
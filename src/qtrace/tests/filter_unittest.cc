@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../filter.h"
+
+static int resolve_syscall(const std::string &name) {
+  return name == "NtOpenFile" ? 0x74 : -1;
+}
+
+static FilterRecord make_record(target_ulong sysno, target_ulong retval,
+                                const std::string *process,
+                                unsigned int nargs, unsigned int bytes,
+                                bool tainted) {
+  FilterRecord record;
+  record.sysno = sysno;
+  record.retval = retval;
+  record.process = process;
+  record.nargs = nargs;
+  record.bytes = bytes;
+  record.tainted = tainted;
+  return record;
+}
+
+// Invalid expressions are rejected
+TEST(OutputFilterTest, InvalidExpression) {
+  OutputFilter filter;
+  std::string error;
+
+  EXPECT_FALSE(filter.compile("", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("foo", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("nargs >", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("nargs > x", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("nargs > 1 &&", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("nargs > 1 nargs", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("nargs & 1", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("process < a", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("sysno == NtFoo", resolve_syscall, error));
+  EXPECT_FALSE(filter.compile("process == \"a", resolve_syscall, error));
+}
+
+// Conditions on numeric fields, and field usage
+TEST(OutputFilterTest, Numeric) {
+  OutputFilter filter;
+  std::string error;
+  std::string process("a.exe");
+
+  ASSERT_TRUE(filter.compile("nargs>=2 && bytes < 0x10", resolve_syscall,
+                             error)) << error;
+  EXPECT_TRUE(filter.uses(FieldNumArgs));
+  EXPECT_TRUE(filter.uses(FieldBytes));
+  EXPECT_FALSE(filter.uses(FieldProcess));
+
+  EXPECT_TRUE(filter.accept(make_record(1, 0, &process, 2, 15, false)));
+  EXPECT_FALSE(filter.accept(make_record(1, 0, &process, 1, 15, false)));
+  EXPECT_FALSE(filter.accept(make_record(1, 0, &process, 2, 16, false)));
+  EXPECT_EQ(1, filter.getNumAccepted());
+  EXPECT_EQ(2, filter.getNumRejected());
+}
+
+// Syscall names, status classes and process names
+TEST(OutputFilterTest, Names) {
+  OutputFilter filter;
+  std::string error;
+  std::string process1("a.exe"), process2("b.exe");
+
+  ASSERT_TRUE(filter.compile("sysno == NtOpenFile && status != error && "
+                             "process == \"a.exe\"", resolve_syscall, error))
+    << error;
+
+  EXPECT_TRUE(filter.accept(make_record(0x74, 0, &process1, 0, 0, false)));
+  EXPECT_TRUE(filter.accept(make_record(0x74, 0x80000005, &process1, 0, 0,
+                                        false)));
+  EXPECT_FALSE(filter.accept(make_record(0x74, 0xc0000022, &process1, 0, 0,
+                                         false)));
+  EXPECT_FALSE(filter.accept(make_record(0x75, 0, &process1, 0, 0, false)));
+  EXPECT_FALSE(filter.accept(make_record(0x74, 0, &process2, 0, 0, false)));
+}
+
+// Alternatives, negations and bare fields
+TEST(OutputFilterTest, Alternatives) {
+  OutputFilter filter;
+  std::string error;
+  std::string process("a.exe");
+
+  ASSERT_TRUE(filter.compile("tainted || !status <= warning && bytes",
+                             resolve_syscall, error)) << error;
+
+  EXPECT_TRUE(filter.accept(make_record(1, 0, &process, 0, 0, true)));
+  EXPECT_TRUE(filter.accept(make_record(1, 0xc0000001, &process, 0, 4,
+                                        false)));
+  EXPECT_FALSE(filter.accept(make_record(1, 0xc0000001, &process, 0, 0,
+                                         false)));
+  EXPECT_FALSE(filter.accept(make_record(1, 0, &process, 0, 4, false)));
+}
@@ -188,3 +188,31 @@ TEST(DataIntervalSetTest, ReadFail) {
 			 reinterpret_cast<unsigned char*>(buffer));
   ASSERT_NE(0, r);
 }
+
+// Data size only accounts for bytes actually stored
+TEST(DataIntervalSetTest, DataSize) {
+  DataIntervalSet intervals;
+  EXPECT_EQ(0, intervals.getDataSize());
+
+  intervals.add(DataInterval(0, 1, "ab"), true);
+  intervals.add(DataInterval(4, 5, "cd"), true);
+  intervals.add(DataInterval(5, 6, "ef"), true);
+
+  EXPECT_EQ(5, intervals.getDataSize());
+  EXPECT_EQ(7, intervals.getMaxLength());
+}
+
+// Missing size only accounts for bytes not stored yet
+TEST(DataIntervalSetTest, MissingSize) {
+  DataIntervalSet intervals;
+  EXPECT_EQ(4, intervals.getMissingSize(0, 4));
+
+  intervals.add(DataInterval(2, 3, "ab"), true);
+  intervals.add(DataInterval(6, 7, "cd"), true);
+
+  EXPECT_EQ(0, intervals.getMissingSize(2, 2));
+  EXPECT_EQ(0, intervals.getMissingSize(0, 0));
+  EXPECT_EQ(2, intervals.getMissingSize(0, 4));
+  EXPECT_EQ(4, intervals.getMissingSize(1, 8));
+  EXPECT_EQ(2, intervals.getMissingSize(8, 2));
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <map>
+
+#include "../layout.h"
+#include "../winxpsp3.h"
+#include "qtrace/context.h"
+
+struct QTraceContext gbl_context;
+
+// Guest memory, byte by byte
+static std::map<target_ulong, unsigned char> guest_memory;
+
+static int peek_guest(target_ulong addr, unsigned char *buffer, int len) {
+  for (int i = 0; i < len; i++) {
+    auto it = guest_memory.find(addr + i);
+    if (it == guest_memory.end()) {
+      return -1;
+    }
+    buffer[i] = it->second;
+  }
+  return 0;
+}
+
+static void poke_guest(target_ulong addr, target_ulong value) {
+  for (unsigned int i = 0; i < sizeof(value); i++) {
+    guest_memory[addr + i] = (value >> (8 * i)) & 0xff;
+  }
+}
+
+// User-space stack pointer at syscall entry
+const target_ulong STACK = 0x0012f000;
+
+class LayoutTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    guest_memory.clear();
+    memset(&gbl_context, 0, sizeof(gbl_context));
+    gbl_context.cb_peek = peek_guest;
+    gbl_context.windows = new WindowsXPSP3();
+  }
+
+  virtual void TearDown() {
+    delete gbl_context.windows;
+  }
+
+  // Add a level-0 argument holding @value to @syscall
+  static SyscallArg *addLevel0(Syscall *syscall, target_ulong value) {
+    SyscallArg *arg = new SyscallArg();
+    arg->addr = syscall->getArgumentsAddress() +
+      syscall->args.size() * sizeof(target_ulong);
+    arg->indata.add(DataInterval(0, sizeof(value) - 1,
+                                 std::string(reinterpret_cast<char *>(&value),
+                                             sizeof(value))), false);
+    syscall->addArgument(arg);
+    return arg;
+  }
+
+  // Add a confirmed pointer to @size bytes at @addr, at offset @offset of
+  // @parent
+  static SyscallArg *addPointer(SyscallArg *parent, int offset,
+                                target_ulong addr, unsigned int size) {
+    SyscallArg *arg = new SyscallArg();
+    arg->addr = addr;
+    arg->offset = offset;
+    arg->parent = parent;
+    arg->indata.add(DataInterval(0, size - 1, std::string(size, 'A')), false);
+    parent->ptrs.push_back(arg);
+    return arg;
+  }
+};
+
+// A learned layout pre-creates the argument tree of later invocations
+TEST_F(LayoutTest, LearnAndApply) {
+  LayoutCache cache(LayoutSyscall);
+
+  // arg0 -> 8 bytes, with a pointer at offset 4 -> 16 bytes
+  Syscall learned(0, 0x10, STACK, 0x1000);
+  addLevel0(&learned, 0x80001234);
+  SyscallArg *arg = addPointer(addLevel0(&learned, 0x00400000), 0,
+                               0x00400000, 8);
+  addPointer(arg, 4, 0x00500000, 16);
+  cache.learn(&learned);
+
+  Syscall syscall(1, 0x10, STACK, 0x1000);
+  addLevel0(&syscall, 0x80001234);
+  addLevel0(&syscall, 0x00600000);
+  poke_guest(0x00600004, 0x00700000);
+  ASSERT_TRUE(cache.apply(&syscall));
+
+  EXPECT_EQ(0, syscall.args[0]->ptrs.size());
+  ASSERT_EQ(1, syscall.args[1]->ptrs.size());
+  SyscallArg *child = syscall.args[1]->ptrs[0];
+  EXPECT_EQ(0x00600000, child->addr);
+  EXPECT_EQ(0, child->offset);
+  EXPECT_EQ(8, child->learned_size);
+  EXPECT_TRUE(child->speculative);
+
+  ASSERT_EQ(1, child->ptrs.size());
+  SyscallArg *grandchild = child->ptrs[0];
+  EXPECT_EQ(0x00700000, grandchild->addr);
+  EXPECT_EQ(4, grandchild->offset);
+  EXPECT_EQ(16, grandchild->learned_size);
+  EXPECT_EQ(2, grandchild->depth);
+
+  // Accesses within the expected ranges are matched directly
+  EXPECT_EQ(child, syscall.findLearnedArgument(0x00600004, 4));
+  EXPECT_EQ(grandchild, syscall.findLearnedArgument(0x0070000c, 4));
+  EXPECT_EQ(NULL, syscall.findLearnedArgument(0x0070000e, 4));
+  EXPECT_EQ(NULL, syscall.findLearnedArgument(0x005ffffc, 4));
+
+  // Arguments that are never accessed are pruned
+  grandchild->speculative = false;
+  syscall.pruneLearnedArguments();
+  ASSERT_EQ(1, syscall.args[1]->ptrs.size());
+  EXPECT_EQ(1, syscall.args[1]->ptrs[0]->ptrs.size());
+}
+
+// No layout is cached for other system calls, and values that are not user
+// pointers are not followed
+TEST_F(LayoutTest, ApplyMismatch) {
+  LayoutCache cache(LayoutSyscall);
+
+  Syscall learned(0, 0x10, STACK, 0x1000);
+  addPointer(addLevel0(&learned, 0x00400000), 0, 0x00400000, 8);
+  cache.learn(&learned);
+
+  Syscall other(1, 0x11, STACK, 0x1000);
+  addLevel0(&other, 0x00400000);
+  EXPECT_FALSE(cache.apply(&other));
+  EXPECT_EQ(0, other.args[0]->ptrs.size());
+
+  Syscall syscall(2, 0x10, STACK, 0x1000);
+  addLevel0(&syscall, 0x80001234);
+  EXPECT_TRUE(cache.apply(&syscall));
+  EXPECT_EQ(0, syscall.args[0]->ptrs.size());
+  EXPECT_EQ(NULL, syscall.findLearnedArgument(0x80001234, 4));
+}
+
+// Accesses past a nested argument are matched to the enclosing one
+TEST_F(LayoutTest, Nested) {
+  LayoutCache cache(LayoutSyscall);
+
+  // arg0 -> 32 bytes, with a pointer at offset 0 to its own bytes 8-15
+  Syscall learned(0, 0x10, STACK, 0x1000);
+  SyscallArg *arg = addPointer(addLevel0(&learned, 0x00400000), 0,
+                               0x00400000, 32);
+  addPointer(arg, 0, 0x00400008, 8);
+  cache.learn(&learned);
+
+  Syscall syscall(1, 0x10, STACK, 0x1000);
+  addLevel0(&syscall, 0x00600000);
+  poke_guest(0x00600000, 0x00600008);
+  ASSERT_TRUE(cache.apply(&syscall));
+
+  ASSERT_EQ(1, syscall.args[0]->ptrs.size());
+  SyscallArg *outer = syscall.args[0]->ptrs[0];
+  ASSERT_EQ(1, outer->ptrs.size());
+  SyscallArg *inner = outer->ptrs[0];
+
+  EXPECT_EQ(outer, syscall.findLearnedArgument(0x00600000, 4));
+  EXPECT_EQ(inner, syscall.findLearnedArgument(0x0060000c, 4));
+  EXPECT_EQ(outer, syscall.findLearnedArgument(0x00600010, 4));
+  EXPECT_EQ(outer, syscall.findLearnedArgument(0x0060000c, 8));
+  EXPECT_EQ(NULL, syscall.findLearnedArgument(0x0060001e, 4));
+}
+
+// Pointers to data that is already learned are not pre-created twice
+TEST_F(LayoutTest, DuplicateAddress) {
+  LayoutCache cache(LayoutSyscall);
+
+  Syscall learned(0, 0x10, STACK, 0x1000);
+  addPointer(addLevel0(&learned, 0x00400000), 0, 0x00400000, 8);
+  addPointer(addLevel0(&learned, 0x00500000), 0, 0x00500000, 16);
+  cache.learn(&learned);
+
+  // Both arguments point to the same buffer
+  Syscall syscall(1, 0x10, STACK, 0x1000);
+  addLevel0(&syscall, 0x00600000);
+  addLevel0(&syscall, 0x00600000);
+  ASSERT_TRUE(cache.apply(&syscall));
+
+  ASSERT_EQ(1, syscall.args[0]->ptrs.size());
+  EXPECT_EQ(0, syscall.args[1]->ptrs.size());
+  EXPECT_EQ(syscall.args[0]->ptrs[0],
+            syscall.findLearnedArgument(0x00600000, 8));
+
+  // Already known pointers are not pre-created either
+  EXPECT_EQ(NULL, syscall.addLearnedArgument(syscall.args[0], 0, 0x00800000,
+                                             8));
+}
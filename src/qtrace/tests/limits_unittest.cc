@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../syscall.h"
+#include "qtrace/context.h"
+
+struct QTraceContext gbl_context;
+
+class LimitsTest : public testing::Test {
+ protected:
+  LimitsTest() : syscall(0, 0x10, 0x0012f000, 0x1000) {}
+
+  // Add a level-0 argument holding @value to the system call
+  SyscallArg *addLevel0(target_ulong value) {
+    SyscallArg *arg = new SyscallArg();
+    arg->addr = syscall.getArgumentsAddress() +
+      syscall.args.size() * sizeof(target_ulong);
+    arg->indata.add(DataInterval(0, sizeof(value) - 1,
+                                 std::string(reinterpret_cast<char *>(&value),
+                                             sizeof(value))), false);
+    syscall.addArgument(arg);
+    return arg;
+  }
+
+  Syscall syscall;
+};
+
+// Argument data is limited for each direction, and only new bytes are charged
+TEST_F(LimitsTest, ArgBytes) {
+  syscall.limits.arg_bytes = 8;
+
+  SyscallArg *arg = addLevel0(0x00400000);
+  arg->indata.add(DataInterval(4, 5, "ab"), false);
+
+  // Re-reading stored data is always allowed
+  EXPECT_EQ(6, syscall.getCaptureAllowance(arg, 0, 6, DirectionIn));
+  EXPECT_EQ(4, syscall.getCaptureAllowance(arg, 4, 4, DirectionIn));
+  EXPECT_EQ(2, syscall.getCaptureAllowance(arg, 6, 4, DirectionIn));
+
+  arg->indata.add(DataInterval(6, 7, "cd"), false);
+  EXPECT_EQ(0, syscall.getCaptureAllowance(arg, 10, 4, DirectionIn));
+  EXPECT_EQ(8, syscall.getCaptureAllowance(arg, 0, 8, DirectionIn));
+
+  // Output data has its own budget
+  EXPECT_EQ(8, syscall.getCaptureAllowance(arg, 0, 12, DirectionOut));
+}
+
+// System call data is shared by all arguments
+TEST_F(LimitsTest, SyscallBytes) {
+  syscall.limits.syscall_bytes = 6;
+
+  SyscallArg *arg0 = addLevel0(0x00400000);
+  SyscallArg *arg1 = addLevel0(0x00500000);
+  syscall.captured_bytes = 4;
+
+  EXPECT_EQ(4, syscall.getCaptureAllowance(arg0, 0, 4, DirectionIn));
+  EXPECT_EQ(6, syscall.getCaptureAllowance(arg0, 0, 8, DirectionIn));
+  EXPECT_EQ(2, syscall.getCaptureAllowance(arg1, 4, 4, DirectionIn));
+  EXPECT_EQ(2, syscall.getCaptureAllowance(arg1, 0, 4, DirectionOut));
+
+  syscall.captured_bytes = 6;
+  EXPECT_EQ(4, syscall.getCaptureAllowance(arg1, 0, 4, DirectionIn));
+  EXPECT_EQ(0, syscall.getCaptureAllowance(arg1, 4, 4, DirectionIn));
+  EXPECT_FALSE(arg1->truncated);
+}
+
+// Pointers are not followed past the maximum depth
+TEST_F(LimitsTest, Depth) {
+  syscall.limits.depth = 1;
+
+  SyscallArg *arg = addLevel0(0x00400000);
+  syscall.addCandidate(arg, 0);
+  EXPECT_TRUE(syscall.hasCandidate(0x00400000));
+  EXPECT_FALSE(syscall.truncated);
+
+  syscall.actualizeCandidate(0x00400000, 0x00600000, sizeof(target_ulong),
+                             DirectionIn);
+  ASSERT_EQ(1, arg->ptrs.size());
+  SyscallArg *child = arg->ptrs[0];
+  EXPECT_EQ(1, child->depth);
+
+  syscall.addCandidate(child, 0);
+  EXPECT_FALSE(syscall.hasCandidate(0x00600000));
+  EXPECT_TRUE(child->truncated);
+  EXPECT_TRUE(syscall.truncated);
+}
+
+// Learned layouts are cut at the maximum depth as well
+TEST_F(LimitsTest, DepthLearned) {
+  syscall.limits.depth = 1;
+
+  SyscallArg *arg = addLevel0(0x00400000);
+  SyscallArg *child = syscall.addLearnedArgument(arg, 0, 0x00400000, 8);
+  ASSERT_TRUE(child != NULL);
+  EXPECT_FALSE(syscall.truncated);
+
+  EXPECT_EQ(NULL, syscall.addLearnedArgument(child, 0, 0x00500000, 8));
+  EXPECT_TRUE(child->truncated);
+  EXPECT_TRUE(syscall.truncated);
+}
+
+// Candidates are counted since the system call started, including the ones
+// that are no longer pending
+TEST_F(LimitsTest, Candidates) {
+  syscall.limits.candidates = 2;
+
+  SyscallArg *arg0 = addLevel0(0x00400000);
+  SyscallArg *arg1 = addLevel0(0x00500000);
+  SyscallArg *arg2 = addLevel0(0x00600000);
+
+  syscall.addCandidate(arg0, 0);
+  syscall.actualizeCandidate(0x00400000, 0, 0, DirectionIn);
+  EXPECT_FALSE(syscall.hasCandidate(0x00400000));
+
+  syscall.addCandidate(arg1, 0);
+  EXPECT_TRUE(syscall.hasCandidate(0x00500000));
+  EXPECT_FALSE(syscall.truncated);
+
+  syscall.addCandidate(arg2, 0);
+  EXPECT_FALSE(syscall.hasCandidate(0x00600000));
+  EXPECT_TRUE(arg2->truncated);
+  EXPECT_TRUE(syscall.truncated);
+}
+
+TEST(CaptureLimitsTest, Parse) {
+  CaptureLimits limits;
+
+  ASSERT_EQ(0, qtrace_parse_capture_limits("arg=4096,depth=0x2", &limits));
+  EXPECT_EQ(4096, limits.arg_bytes);
+  EXPECT_EQ(0, limits.syscall_bytes);
+  EXPECT_EQ(2, limits.depth);
+  EXPECT_EQ(0, limits.candidates);
+
+  ASSERT_EQ(0, qtrace_parse_capture_limits("syscall=1,candidates=16",
+                                           &limits));
+  EXPECT_EQ(0, limits.arg_bytes);
+  EXPECT_EQ(1, limits.syscall_bytes);
+  EXPECT_EQ(16, limits.candidates);
+}
+
+// Malformed limits are rejected, rather than disabling the limit
+TEST(CaptureLimitsTest, ParseInvalid) {
+  CaptureLimits limits;
+
+  EXPECT_NE(0, qtrace_parse_capture_limits("arg", &limits));
+  EXPECT_NE(0, qtrace_parse_capture_limits("arg=", &limits));
+  EXPECT_NE(0, qtrace_parse_capture_limits("arg=4k", &limits));
+  EXPECT_NE(0, qtrace_parse_capture_limits("arg=-1", &limits));
+  EXPECT_NE(0, qtrace_parse_capture_limits("arg= 1", &limits));
+  EXPECT_NE(0, qtrace_parse_capture_limits("arg=99999999999", &limits));
+  EXPECT_NE(0, qtrace_parse_capture_limits("bytes=10", &limits));
+  EXPECT_NE(0, qtrace_parse_capture_limits("arg=1,,depth=2", &limits));
+}
+
+TEST(CaptureLimitsTest, ParseUint) {
+  unsigned int value = 0;
+
+  EXPECT_EQ(0, qtrace_parse_uint("4096", &value));
+  EXPECT_EQ(4096U, value);
+  EXPECT_EQ(0, qtrace_parse_uint("0x100", &value));
+  EXPECT_EQ(256U, value);
+  EXPECT_NE(0, qtrace_parse_uint("", &value));
+  EXPECT_NE(0, qtrace_parse_uint("-1", &value));
+  EXPECT_NE(0, qtrace_parse_uint("64k", &value));
+  EXPECT_EQ(256U, value);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../logging.h"
+
+// Capture a message as log macros do, and format it
+template <typename... Args>
+static std::string format(const char *fmt, Args... args) {
+  LogRecord record;
+  log_record_init(&record, NULL, 3, __FILE__, __LINE__, fmt);
+  int unused[] = { 0, (log_record_arg(&record, args), 0)... };
+  (void) unused;
+  return log_format(record);
+}
+
+// Records are formatted as printf() would
+TEST(LoggingTest, Format) {
+  EXPECT_EQ("no arguments", format("no arguments"));
+  EXPECT_EQ("100%", format("100%%"));
+  EXPECT_EQ("#-3 (00001234)", format("#%d (%.8x)", -3, 0x1234));
+  EXPECT_EQ("size 16", format("size %d", static_cast<size_t>(16)));
+  EXPECT_EQ("ffffffffffffffff -1",
+            format("%llx %lld", static_cast<unsigned long long>(-1), -1LL));
+  EXPECT_EQ("[  ab] 1.50", format("[%*s] %.2f", 4, "ab", 1.5));
+  EXPECT_EQ("x <?>", format("%c %d", 'x'));
+}
+
+// String arguments are copied, and truncated if they do not fit
+TEST(LoggingTest, Strings) {
+  std::string temporary("temporary");
+  LogRecord record;
+  log_record_init(&record, NULL, 3, __FILE__, __LINE__, "%s %s %s");
+  log_record_arg(&record, temporary.c_str());
+  temporary.assign("overwritten");
+  log_record_arg(&record, static_cast<const char *>(NULL));
+  log_record_arg(&record, std::string(LOG_MAX_STRINGS * 2, 'a').c_str());
+  std::string formatted = log_format(record);
+
+  EXPECT_EQ(0, formatted.find("temporary (null) aaa"));
+  EXPECT_EQ(LOG_MAX_STRINGS - 1, formatted.size());
+
+  // No room left for more strings
+  log_record_init(&record, NULL, 3, __FILE__, __LINE__, "%s|%s");
+  log_record_arg(&record, std::string(LOG_MAX_STRINGS, 'b').c_str());
+  log_record_arg(&record, "lost");
+  EXPECT_EQ(std::string(LOG_MAX_STRINGS - 1, 'b') + "|", log_format(record));
+}
+
+// Levels are set per module at runtime
+TEST(LoggingTest, Levels) {
+  EXPECT_EQ(0, log_parse_level("none"));
+  EXPECT_EQ(5, log_parse_level("TRACE"));
+  EXPECT_EQ(4, log_parse_level("4"));
+  EXPECT_EQ(-1, log_parse_level("verbose"));
+  EXPECT_STREQ("warning", log_level_name(2));
+
+  LogModule *module = log_register_module("some/path/logging_unittest.cc");
+  EXPECT_EQ(qtrace_log_module, module);
+  EXPECT_EQ("logging_unittest", module->name);
+  EXPECT_EQ(LOG_LEVEL_DEFAULT, module->level);
+
+  EXPECT_TRUE(log_set_level("logging_unittest", 5));
+  EXPECT_TRUE(log_enabled(module, 5));
+  EXPECT_TRUE(log_set_level(NULL, 1));
+  EXPECT_FALSE(log_enabled(module, 2));
+  EXPECT_FALSE(log_set_level("nonexistent", 3));
+}
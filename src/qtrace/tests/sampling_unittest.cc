@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "../sampling.h"
+
+// Without a policy, every system call is traced
+TEST(SamplingPolicyTest, Disabled) {
+  SamplingPolicy policy;
+  EXPECT_FALSE(policy.isEnabled());
+  EXPECT_EQ("off", policy.getSpec());
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(policy.shouldSample(1, 0x1000, i));
+  }
+  EXPECT_EQ(10, policy.getNumSampled());
+  EXPECT_EQ(0, policy.getNumSkipped());
+}
+
+// Invalid specifications are rejected, and leave the policy unchanged
+TEST(SamplingPolicyTest, InvalidSpec) {
+  SamplingPolicy policy;
+  ASSERT_TRUE(policy.configure("every=2"));
+
+  EXPECT_FALSE(policy.configure("every"));
+  EXPECT_FALSE(policy.configure("every=x"));
+  EXPECT_FALSE(policy.configure("every=-1"));
+  EXPECT_FALSE(policy.configure("foo=1"));
+  EXPECT_FALSE(policy.configure("rate=1,per=thread"));
+  EXPECT_EQ("every=2", policy.getSpec());
+
+  EXPECT_TRUE(policy.configure("off"));
+  EXPECT_FALSE(policy.isEnabled());
+}
+
+// One call every N, counted separately for each syscall number
+TEST(SamplingPolicyTest, Every) {
+  SamplingPolicy policy;
+  ASSERT_TRUE(policy.configure("every=3"));
+
+  int sampled1 = 0, sampled2 = 0;
+  for (int i = 0; i < 9; i++) {
+    sampled1 += policy.shouldSample(1, 0x1000, 0);
+    sampled2 += policy.shouldSample(2, 0x1000, 0);
+  }
+  EXPECT_EQ(3, sampled1);
+  EXPECT_EQ(3, sampled2);
+  EXPECT_EQ(6, policy.getNumSampled());
+  EXPECT_EQ(12, policy.getNumSkipped());
+}
+
+// First K calls, then sampling
+TEST(SamplingPolicyTest, FirstThenEvery) {
+  SamplingPolicy policy;
+  ASSERT_TRUE(policy.configure("first=2,every=4"));
+
+  bool expected[] = { true, true, true, false, false, false, true };
+  for (unsigned int i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    EXPECT_EQ(expected[i], policy.shouldSample(1, 0x1000, 0)) << i;
+  }
+
+  // Without "every", calls after the first K are skipped
+  ASSERT_TRUE(policy.configure("first=1"));
+  EXPECT_TRUE(policy.shouldSample(1, 0x1000, 0));
+  EXPECT_FALSE(policy.shouldSample(1, 0x1000, 0));
+}
+
+// Token bucket, keyed by syscall number
+TEST(SamplingPolicyTest, RatePerSyscall) {
+  SamplingPolicy policy;
+  ASSERT_TRUE(policy.configure("rate=2,burst=2"));
+
+  EXPECT_TRUE(policy.shouldSample(1, 0x1000, 0));
+  EXPECT_TRUE(policy.shouldSample(1, 0x2000, 0));
+  EXPECT_FALSE(policy.shouldSample(1, 0x3000, 0));
+  EXPECT_TRUE(policy.shouldSample(2, 0x1000, 0));
+
+  // Half a second later, one token is available again
+  EXPECT_TRUE(policy.shouldSample(1, 0x1000, 500000));
+  EXPECT_FALSE(policy.shouldSample(1, 0x1000, 500000));
+
+  // Buckets never exceed their capacity
+  EXPECT_TRUE(policy.shouldSample(1, 0x1000, 10000000));
+  EXPECT_TRUE(policy.shouldSample(1, 0x1000, 10000000));
+  EXPECT_FALSE(policy.shouldSample(1, 0x1000, 10000000));
+}
+
+// Token bucket, keyed by process
+TEST(SamplingPolicyTest, RatePerProcess) {
+  SamplingPolicy policy;
+  ASSERT_TRUE(policy.configure("rate=1,per=process"));
+
+  EXPECT_TRUE(policy.shouldSample(1, 0x1000, 0));
+  EXPECT_FALSE(policy.shouldSample(2, 0x1000, 0));
+  EXPECT_TRUE(policy.shouldSample(1, 0x2000, 0));
+}
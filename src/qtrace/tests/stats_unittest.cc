@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include "../stats.h"
+
+// Values fall into log2 buckets
+TEST(HistogramTest, Buckets) {
+  EXPECT_EQ(0, Histogram::getBucket(0));
+  EXPECT_EQ(1, Histogram::getBucket(1));
+  EXPECT_EQ(2, Histogram::getBucket(2));
+  EXPECT_EQ(2, Histogram::getBucket(3));
+  EXPECT_EQ(11, Histogram::getBucket(1024));
+  EXPECT_EQ(64, Histogram::getBucket(UINT64_MAX));
+
+  Histogram histogram;
+  EXPECT_EQ(0, histogram.getMin());
+  EXPECT_EQ(0, histogram.getMean());
+
+  histogram.add(3);
+  histogram.add(2);
+  histogram.add(1000);
+  EXPECT_EQ(3, histogram.getCount());
+  EXPECT_EQ(1005, histogram.getSum());
+  EXPECT_EQ(2, histogram.getMin());
+  EXPECT_EQ(1000, histogram.getMax());
+  EXPECT_EQ(2, histogram.getBucketCount(2));
+  EXPECT_EQ(1, histogram.getBucketCount(10));
+}
+
+// Percentiles are bounded by bucket limits and by the maximum value
+TEST(HistogramTest, Percentile) {
+  Histogram histogram;
+  for (int i = 0; i < 99; i++) {
+    histogram.add(5);
+  }
+  histogram.add(300);
+
+  EXPECT_EQ(7, histogram.getPercentile(50));
+  EXPECT_EQ(7, histogram.getPercentile(99));
+  EXPECT_EQ(300, histogram.getPercentile(100));
+}
+
+// Costs are aggregated by syscall number
+TEST(SyscallStatsTest, Aggregate) {
+  SyscallStats stats;
+  SyscallCost cost = { 2000, -1, 500, 3, 16 };
+  stats.add(1, cost);
+  stats.add(1, cost);
+  cost.instructions = 100;
+  stats.add(2, cost);
+
+  EXPECT_EQ(2, stats.getCount(1));
+  EXPECT_EQ(1, stats.getCount(2));
+  EXPECT_EQ(0, stats.getCount(3));
+
+  StatsSyscallNamer namer = [](target_ulong sysno) -> const char * {
+    return sysno == 1 ? "NtFoo" : NULL;
+  };
+
+  std::string summary = stats.formatSummary(namer);
+  EXPECT_NE(std::string::npos, summary.find("NtFoo"));
+
+  std::string details = stats.formatSyscall(2, namer);
+  EXPECT_NE(std::string::npos, details.find("Guest instructions"));
+  details = stats.formatSyscall(1, namer);
+  EXPECT_EQ(std::string::npos, details.find("Guest instructions"));
+  EXPECT_NE(std::string::npos, details.find("count 2"));
+
+  stats.reset();
+  EXPECT_EQ(0, stats.getCount(1));
+}
+
+// Host time is charged only while accounting is enabled
+TEST(HostTimerTest, Charge) {
+  uint64_t counter = 0;
+
+  stats_host_time = false;
+  {
+    HostTimer timer;
+    timer.charge(&counter);
+  }
+  EXPECT_EQ(0, counter);
+
+  stats_host_time = true;
+  {
+    HostTimer timer;
+    timer.charge(&counter);
+    uint64_t start = stats_clock_ns();
+    while (stats_clock_ns() == start) {
+    }
+  }
+  EXPECT_LT(0, counter);
+  stats_host_time = false;
+}
@@ -262,3 +262,30 @@ TEST(TaintPropagationCombine, MemoryToRegister) {
   ASSERT_TRUE(engine.hasRegisterLabel(istmpreg, regno, TEST_TAINTLABEL));
   ASSERT_TRUE(engine.hasRegisterLabel(istmpreg, regno, TEST_TAINTLABEL+1));
 }
+
+TEST(TaintEngineTest, FastPathCache) {
+  const target_ulong tmpreg = 70, cpureg = 2;
+  const target_ulong addr = 0xcafebabe;
+
+  TaintEngine engine;
+
+  ASSERT_FALSE(qtrace_fastpath_tmp_tainted());
+  ASSERT_FALSE(qtrace_fastpath_mem_tainted());
+
+  engine.setTaintedRegister(TEST_TAINTLABEL, true, tmpreg);
+  engine.moveR2R(true, tmpreg, false, cpureg);
+  EXPECT_TRUE(qtrace_fastpath_reg_tainted(true, tmpreg));
+  EXPECT_FALSE(qtrace_fastpath_reg_tainted(true, tmpreg + 1));
+  EXPECT_TRUE(qtrace_fastpath_reg_tainted(false, cpureg));
+  EXPECT_TRUE(qtrace_fastpath_tmp_tainted());
+
+  engine.moveR2M(false, cpureg, addr, 4);
+  EXPECT_TRUE(qtrace_fastpath_mem_tainted());
+
+  engine.clearTempRegisters();
+  engine.clearRegister(false, cpureg);
+  engine.clearMemory(addr, 4);
+  EXPECT_FALSE(qtrace_fastpath_tmp_tainted());
+  EXPECT_FALSE(qtrace_fastpath_reg_tainted(false, cpureg));
+  EXPECT_FALSE(qtrace_fastpath_mem_tainted());
+}
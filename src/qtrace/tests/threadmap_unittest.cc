@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "../threadmap.h"
+
+struct ThreadObject {
+  explicit ThreadObject(target_ulong t) : thread(t) {}
+  target_ulong thread;
+};
+
+// Objects are told apart by address space and thread
+TEST(ThreadMapTest, Find) {
+  ThreadMap<ThreadObject> map;
+  ThreadObject a(0x81000000), b(0x82000000), c(0x81000000);
+
+  map.insert(0x1000, &a);
+  map.insert(0x1000, &b);
+  map.insert(0x2000, &c);
+  EXPECT_EQ(3, map.size());
+
+  EXPECT_TRUE(map.contains(0x1000));
+  EXPECT_FALSE(map.contains(0x3000));
+  EXPECT_EQ(&a, map.find(0x1000, 0x81000000)->second);
+  EXPECT_EQ(&b, map.find(0x1000, 0x82000000)->second);
+  EXPECT_EQ(&c, map.find(0x2000, 0x81000000)->second);
+
+  EXPECT_TRUE(map.find(0x1000, 0x83000000) == map.end());
+  EXPECT_TRUE(map.find(0x2000, 0x82000000) == map.end());
+  EXPECT_TRUE(map.find(0x3000, 0x81000000) == map.end());
+}
+
+// Objects are looked up by address space only, while the thread is unknown
+TEST(ThreadMapTest, UnknownThread) {
+  ThreadMap<ThreadObject> map;
+  ThreadObject a(0x81000000);
+
+  map.insert(0x1000, &a);
+  EXPECT_EQ(&a, map.find(0x1000, 0)->second);
+  EXPECT_EQ(0x81000000, a.thread);
+  EXPECT_TRUE(map.find(0x2000, 0) == map.end());
+}
+
+// An object inserted with an unknown thread is bound to the first thread that
+// finds it
+TEST(ThreadMapTest, BindThread) {
+  ThreadMap<ThreadObject> map;
+  ThreadObject a(0);
+
+  map.insert(0x1000, &a);
+  EXPECT_EQ(&a, map.find(0x1000, 0x81000000)->second);
+  EXPECT_EQ(0x81000000, a.thread);
+
+  EXPECT_TRUE(map.find(0x1000, 0x82000000) == map.end());
+  EXPECT_EQ(&a, map.find(0x1000, 0x81000000)->second);
+}
+
+TEST(ThreadMapTest, Erase) {
+  ThreadMap<ThreadObject> map;
+  ThreadObject a(0x81000000), b(0x82000000);
+
+  map.insert(0x1000, &a);
+  map.insert(0x1000, &b);
+  map.erase(map.find(0x1000, 0x81000000));
+  EXPECT_EQ(1, map.size());
+  EXPECT_TRUE(map.find(0x1000, 0x81000000) == map.end());
+  EXPECT_EQ(&b, map.find(0x1000, 0x82000000)->second);
+
+  map.erase(map.find(0x1000, 0x82000000));
+  EXPECT_FALSE(map.contains(0x1000));
+}
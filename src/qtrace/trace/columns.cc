@@ -0,0 +1,155 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+
+#include "qtrace/trace/columns.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "qtrace/logging.h"
+
+// Accumulate data and label counters of an argument and its children
+static void columns_count_argument(const SyscallArg *arg, uint32_t &inbytes,
+                                   uint32_t &outbytes, uint32_t &labels_in,
+                                   uint32_t &labels_out) {
+  inbytes += arg->indata.getDataSize();
+  outbytes += arg->outdata.getDataSize();
+
+#ifdef CONFIG_QTRACE_TAINT
+  labels_in += arg->taint_labels_in.size();
+  labels_out += arg->taint_labels_out.size();
+#endif
+
+  for (auto it = arg->ptrs.begin(); it != arg->ptrs.end(); it++) {
+    columns_count_argument(*it, inbytes, outbytes, labels_in, labels_out);
+  }
+}
+
+SummaryColumns::SummaryColumns(const std::string &dirname)
+  : dirname_(dirname), dictfile_(NULL) {
+  for (int i = 0; i < ColumnMax; i++) {
+    files_[i] = NULL;
+    block_[i].reserve(SUMMARY_BLOCK_ROWS);
+  }
+  narrow_.reserve(SUMMARY_BLOCK_ROWS);
+}
+
+SummaryColumns::~SummaryColumns() {
+  flush();
+
+  for (int i = 0; i < ColumnMax; i++) {
+    if (files_[i]) {
+      fclose(files_[i]);
+    }
+  }
+
+  if (dictfile_) {
+    fclose(dictfile_);
+  }
+}
+
+const char *SummaryColumns::getColumnName(SummaryColumn column) {
+  static const char *names[ColumnMax] = {
+    "id", "sysno", "pid", "tid", "process", "retval", "nargs",
+    "inbytes", "outbytes", "labels_in", "labels_out", "cpu",
+  };
+
+  assert(column < ColumnMax);
+  return names[column];
+}
+
+size_t SummaryColumns::getColumnWidth(SummaryColumn column) {
+  assert(column < ColumnMax);
+  return column == ColumnRetval ? sizeof(target_ulong) : sizeof(uint32_t);
+}
+
+int SummaryColumns::open() {
+  if (mkdir(dirname_.c_str(), 0755) != 0 && errno != EEXIST) {
+    ERROR("Cannot create sidecar directory %s: %s", dirname_.c_str(),
+          strerror(errno));
+    return -1;
+  }
+
+  for (int i = 0; i < ColumnMax; i++) {
+    SummaryColumn column = static_cast<SummaryColumn>(i);
+    std::string filename = dirname_ + "/" + getColumnName(column) +
+      (getColumnWidth(column) == sizeof(uint64_t) ? ".u64" : ".u32");
+    files_[i] = fopen(filename.c_str(), "wb");
+    if (!files_[i]) {
+      ERROR("Cannot open column file %s", filename.c_str());
+      return -1;
+    }
+  }
+
+  std::string filename = dirname_ + "/process.dict";
+  dictfile_ = fopen(filename.c_str(), "wb");
+  if (!dictfile_) {
+    ERROR("Cannot open dictionary file %s", filename.c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+uint32_t SummaryColumns::getNameIndex(const std::string &name) {
+  auto it = names_.find(name);
+  if (it != names_.end()) {
+    return it->second;
+  }
+
+  // Dictionary entries are NUL-terminated, in index order
+  uint32_t index = names_.size();
+  names_[name] = index;
+  fwrite(name.c_str(), 1, name.length() + 1, dictfile_);
+  return index;
+}
+
+void SummaryColumns::add(const Syscall *syscall) {
+  uint32_t inbytes = 0, outbytes = 0, labels_in = 0, labels_out = 0;
+  for (auto it = syscall->args.begin(); it != syscall->args.end(); it++) {
+    columns_count_argument(*it, inbytes, outbytes, labels_in, labels_out);
+  }
+
+  block_[ColumnId].push_back(syscall->id);
+  block_[ColumnSysno].push_back(syscall->sysno);
+  block_[ColumnPid].push_back(syscall->pid);
+  block_[ColumnTid].push_back(syscall->tid);
+  block_[ColumnProcess].push_back(getNameIndex(syscall->name));
+  block_[ColumnRetval].push_back(syscall->retval);
+  block_[ColumnNumArgs].push_back(syscall->args.size());
+  block_[ColumnInBytes].push_back(inbytes);
+  block_[ColumnOutBytes].push_back(outbytes);
+  block_[ColumnLabelsIn].push_back(labels_in);
+  block_[ColumnLabelsOut].push_back(labels_out);
+  block_[ColumnCpu].push_back(syscall->cpu);
+
+  if (block_[ColumnId].size() >= SUMMARY_BLOCK_ROWS) {
+    flush();
+  }
+}
+
+void SummaryColumns::flush() {
+  // Dictionary goes first, so rows never reference missing entries
+  if (dictfile_) {
+    fflush(dictfile_);
+  }
+
+  for (int i = 0; i < ColumnMax; i++) {
+    if (files_[i] && !block_[i].empty()) {
+      if (getColumnWidth(static_cast<SummaryColumn>(i)) ==
+          sizeof(target_ulong)) {
+        fwrite(block_[i].data(), sizeof(target_ulong), block_[i].size(),
+               files_[i]);
+      } else {
+        narrow_.assign(block_[i].begin(), block_[i].end());
+        fwrite(narrow_.data(), sizeof(uint32_t), narrow_.size(), files_[i]);
+      }
+      fflush(files_[i]);
+    }
+    block_[i].clear();
+  }
+}
@@ -0,0 +1,82 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// This QTrace module writes a columnar summary of serialized system calls (the
+// "sidecar"), meant for fast off-line analytics. The sidecar is a directory
+// with one file per column, each being a flat array of native unsigned
+// integers (one per syscall), plus a dictionary of process names. The file
+// extension gives the integer width: the return value column is stored at
+// target_ulong width (".u64" on 64-bit targets), all the others as ".u32".
+// Files can be memory-mapped and scanned directly.
+//
+
+#ifndef SRC_QTRACE_TRACE_COLUMNS_H_
+#define SRC_QTRACE_TRACE_COLUMNS_H_
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "qtrace/common.h"
+#include "qtrace/trace/syscall.h"
+
+// Columns included in the sidecar
+enum SummaryColumn {
+  ColumnId = 0,
+  ColumnSysno,
+  ColumnPid,
+  ColumnTid,
+  ColumnProcess,      // Index inside the process names dictionary
+  ColumnRetval,       // Stored at target_ulong width
+  ColumnNumArgs,      // Number of level-0 arguments
+  ColumnInBytes,      // Input data bytes, including nested arguments
+  ColumnOutBytes,     // Output data bytes, including nested arguments
+  ColumnLabelsIn,     // Taint labels used
+  ColumnLabelsOut,    // Taint labels defined
+  ColumnCpu,          // Index of the vCPU
+  ColumnMax,
+};
+
+// Number of rows buffered in memory before being flushed to disk
+const unsigned int SUMMARY_BLOCK_ROWS = 4096;
+
+class SummaryColumns {
+ private:
+  std::string dirname_;
+
+  // Column files and in-memory buffers for the current block
+  FILE *files_[ColumnMax];
+  std::vector<target_ulong> block_[ColumnMax];
+
+  // Scratch buffer to narrow 32-bit columns when flushing
+  std::vector<uint32_t> narrow_;
+
+  // Process names dictionary
+  FILE *dictfile_;
+  std::unordered_map<std::string, uint32_t> names_;
+
+  // Get the dictionary index for a process name, adding it if needed
+  uint32_t getNameIndex(const std::string &name);
+
+ public:
+  explicit SummaryColumns(const std::string &dirname);
+  ~SummaryColumns();
+
+  // Open the column files. Returns 0 on success, -1 on error
+  int open();
+
+  // Add a row for the specified system call
+  void add(const Syscall *syscall);
+
+  // Write buffered rows to disk
+  void flush();
+
+  // Get the file name of a column
+  static const char *getColumnName(SummaryColumn column);
+
+  // Get the size of each column element, in bytes
+  static size_t getColumnWidth(SummaryColumn column);
+};
+
+#endif  // SRC_QTRACE_TRACE_COLUMNS_H_
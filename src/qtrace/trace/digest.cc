@@ -0,0 +1,73 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+
+#include "qtrace/trace/digest.h"
+
+#include <cstring>
+
+static inline uint64_t digest_rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// Final avalanche of a 64-bit lane
+static inline uint64_t digest_fmix(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+PayloadDigest digest_compute(const void *data, size_t len, uint32_t seed) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+  uint64_t h1 = seed, h2 = seed;
+
+  // Body, in 16-byte blocks (little-endian, as on x86 hosts)
+  size_t nblocks = len / 16;
+  for (size_t i = 0; i < nblocks; i++) {
+    uint64_t k1, k2;
+    memcpy(&k1, bytes + i * 16, sizeof(k1));
+    memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+
+    k1 *= c1; k1 = digest_rotl(k1, 31); k1 *= c2; h1 ^= k1;
+    h1 = digest_rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2; k2 = digest_rotl(k2, 33); k2 *= c1; h2 ^= k2;
+    h2 = digest_rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  // Tail, the last (len % 16) bytes
+  const uint8_t *tail = bytes + nblocks * 16;
+  size_t tail_len = len & 15;
+  uint64_t k1 = 0, k2 = 0;
+  for (size_t i = 0; i < tail_len; i++) {
+    if (i < 8) {
+      k1 |= static_cast<uint64_t>(tail[i]) << (i * 8);
+    } else {
+      k2 |= static_cast<uint64_t>(tail[i]) << ((i - 8) * 8);
+    }
+  }
+  if (tail_len > 8) {
+    k2 *= c2; k2 = digest_rotl(k2, 33); k2 *= c1; h2 ^= k2;
+  }
+  if (tail_len > 0) {
+    k1 *= c1; k1 = digest_rotl(k1, 31); k1 *= c2; h1 ^= k1;
+  }
+
+  // Finalization
+  h1 ^= len;
+  h2 ^= len;
+  h1 += h2;
+  h2 += h1;
+  h1 = digest_fmix(h1);
+  h2 = digest_fmix(h2);
+  h1 += h2;
+  h2 += h1;
+
+  PayloadDigest digest = { h1, h2, len };
+  return digest;
+}
@@ -0,0 +1,41 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// Fixed-size digests of data payloads, used to deduplicate payloads without
+// keeping a copy of them. Digests are 128-bit MurmurHash3 (x64 variant) values
+// of the payload, together with its length. MurmurHash3 is not cryptographic,
+// but collisions of non-adversarial payloads are negligible at this size.
+//
+
+#ifndef SRC_QTRACE_TRACE_DIGEST_H_
+#define SRC_QTRACE_TRACE_DIGEST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct PayloadDigest {
+  uint64_t h1;
+  uint64_t h2;
+  size_t length;
+
+  bool operator==(const PayloadDigest &other) const {
+    return h1 == other.h1 && h2 == other.h2 && length == other.length;
+  }
+};
+
+// Hash function for PayloadDigest keys, as digests are uniformly distributed
+struct PayloadDigestHash {
+  size_t operator()(const PayloadDigest &digest) const {
+    return static_cast<size_t>(digest.h1);
+  }
+};
+
+// Compute the digest of @len bytes at @data, with seed @seed
+PayloadDigest digest_compute(const void *data, size_t len, uint32_t seed = 0);
+
+static inline PayloadDigest digest_compute(const std::string &data) {
+  return digest_compute(data.data(), data.length());
+}
+
+#endif  // SRC_QTRACE_TRACE_DIGEST_H_
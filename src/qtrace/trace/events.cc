@@ -0,0 +1,153 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+
+#include "qtrace/trace/events.h"
+
+#include <cassert>
+#include <cstdlib>
+
+#include "qtrace/logging.h"
+#include "qtrace/trace/memory.h"
+#include "qtrace/trace/serialize.h"
+
+// Queue whose worker must be stopped at process exit, replaying pending events
+static TraceEventQueue *running_queue = NULL;
+
+static void trace_events_atexit(void) {
+  if (running_queue) {
+    running_queue->stop();
+  }
+}
+
+void trace_event_replay(const TraceEvent &event) {
+  switch (event.type) {
+  case EventMemRead:
+    memory_read_levelN(event.pc, event.syscall, event.addr, event.size,
+                       event.value);
+    break;
+  case EventMemWrite:
+    memory_write(event.pc, event.syscall, event.addr, event.size,
+                 event.value);
+    break;
+  case EventReadRange:
+    memory_read_range(event.pc, event.syscall, event.addr, *event.data);
+    delete event.data;
+    break;
+  case EventWriteRange:
+    memory_write_range(event.pc, event.syscall, event.addr, *event.data);
+    delete event.data;
+    break;
+  case EventSerialize:
+    serialize_syscall(event.syscall);
+    delete event.syscall;
+    break;
+  default:
+    assert(false);
+  }
+}
+
+TraceEventQueue::TraceEventQueue(unsigned int capacity)
+  : ring_(capacity), mask_(capacity - 1), head_(0), tail_(0), idle_(false),
+    waiting_(0), running_(false), stop_(false) {
+  assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+}
+
+TraceEventQueue::~TraceEventQueue() {
+  stop();
+}
+
+void TraceEventQueue::start() {
+  assert(!running_);
+  worker_ = std::thread(&TraceEventQueue::run, this);
+  running_ = true;
+
+  if (!running_queue) {
+    running_queue = this;
+    atexit(trace_events_atexit);
+  }
+}
+
+void TraceEventQueue::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_worker_.notify_one();
+  worker_.join();
+
+  if (running_queue == this) {
+    running_queue = NULL;
+  }
+
+  DEBUG("Event worker stopped, %llu events replayed",
+        static_cast<unsigned long long>(tail_.load()));
+}
+
+void TraceEventQueue::run() {
+  while (true) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      // Ring is empty: sleep until new events are queued, or we are stopped.
+      // The producer checks idle_ after publishing an event, so either we see
+      // the event here or the producer wakes us up
+      std::unique_lock<std::mutex> lock(mutex_);
+      idle_ = true;
+      cond_worker_.wait(lock, [&] { return head_ != tail || stop_; });
+      idle_ = false;
+      if (head_ == tail) {
+        break;
+      }
+      continue;
+    }
+
+    trace_event_replay(ring_[tail & mask_]);
+    tail_ = tail + 1;
+
+    // Wake up the producer, if it is waiting for this event
+    uint64_t waiting = waiting_;
+    if (waiting != 0 && tail + 1 >= waiting) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cond_producer_.notify_one();
+    }
+  }
+}
+
+uint64_t TraceEventQueue::push(const TraceEvent &event) {
+  if (!running_) {
+    // Worker stopped (e.g., at exit), replay on the current thread
+    trace_event_replay(event);
+    return 0;
+  }
+
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  if (head - tail_.load(std::memory_order_acquire) > mask_) {
+    // Ring is full, wait for the worker to free a slot
+    wait(head - mask_);
+  }
+
+  ring_[head & mask_] = event;
+  head_ = head + 1;
+
+  if (idle_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cond_worker_.notify_one();
+  }
+
+  return head + 1;
+}
+
+void TraceEventQueue::wait(uint64_t seq) {
+  if (tail_.load(std::memory_order_acquire) >= seq) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  waiting_ = seq;
+  cond_producer_.wait(lock, [&] { return tail_ >= seq; });
+  waiting_ = 0;
+}
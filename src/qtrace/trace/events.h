@@ -0,0 +1,100 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// This QTrace module decouples the reconstruction of syscall arguments from
+// the vCPU thread. Memory hooks describe each access with a compact TraceEvent
+// record; records are either replayed immediately, or appended to a ring and
+// replayed by a worker thread through the usual memory.cc/syscall.cc code.
+// Completed system calls are serialized by the worker as well.
+//
+// Only the vCPU thread touches the ring head and a Syscall object being
+// traced, with one exception: events queued for a system call are owned by the
+// worker until they have been replayed. Paths that need live guest state
+// (level-0 arguments, argument layouts, taint dependencies) stay synchronous,
+// and wait until all the events queued for their system call have been
+// replayed.
+//
+
+#ifndef SRC_QTRACE_TRACE_EVENTS_H_
+#define SRC_QTRACE_TRACE_EVENTS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "qtrace/common.h"
+#include "qtrace/trace/syscall.h"
+
+// Number of records in the event ring (must be a power of two)
+const unsigned int TRACE_EVENT_RING_SIZE = 64 * 1024;
+
+enum TraceEventType {
+  EventMemRead = 0,       // Word-sized kernel read of user memory
+  EventMemWrite,          // Word-sized kernel write to user memory
+  EventReadRange,         // Read of a whole buffer (string ops, copy routines)
+  EventWriteRange,        // Write of a whole buffer
+  EventSerialize,         // System call completed, serialize and delete it
+};
+
+struct TraceEvent {
+  TraceEventType type;
+  int size;
+  Syscall *syscall;
+  target_ulong pc;
+  target_ulong addr;
+  target_ulong value;
+  std::string *data;      // Range events only, owned by the event
+};
+
+// Process an event on the current thread
+void trace_event_replay(const TraceEvent &event);
+
+// Single-producer, single-consumer ring of events, with its worker thread
+class TraceEventQueue {
+ private:
+  std::vector<TraceEvent> ring_;
+  const uint64_t mask_;
+
+  // Number of events queued (written by the producer) and replayed (written by
+  // the worker) so far
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> tail_;
+
+  // Sleeping worker, and producer waiting for the worker to reach an event
+  std::atomic<bool> idle_;
+  std::atomic<uint64_t> waiting_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_worker_;
+  std::condition_variable cond_producer_;
+
+  std::thread worker_;
+  std::atomic<bool> running_;
+  bool stop_;
+
+  // Worker thread main loop
+  void run();
+
+ public:
+  explicit TraceEventQueue(unsigned int capacity);
+  ~TraceEventQueue();
+
+  // Start the worker thread. Pending events are replayed at process exit
+  void start();
+
+  // Replay all pending events and stop the worker thread
+  void stop();
+
+  // Append an event, waiting if the ring is full. Returns the sequence number
+  // of the event
+  uint64_t push(const TraceEvent &event);
+
+  // Wait until the event with sequence number @seq has been replayed
+  void wait(uint64_t seq);
+};
+
+#endif  // SRC_QTRACE_TRACE_EVENTS_H_
@@ -0,0 +1,298 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+
+#include "qtrace/trace/filter.h"
+
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+// Field names, indexed by FilterField
+static const char *filter_field_names[FieldMax] = {
+  "sysno", "retval", "status", "process", "nargs", "bytes", "tainted",
+};
+
+// Values of the "status" field, indexed by FilterStatus
+static const char *filter_status_names[] = {
+  "success", "info", "warning", "error",
+};
+
+// Split a filter expression into tokens: operators, quoted strings and words
+static bool filter_tokenize(const std::string &expr,
+                            std::vector<std::string> &tokens) {
+  static const char *operators[] = {
+    "&&", "||", "==", "!=", "<=", ">=", "<", ">", "!",
+  };
+  static const char *separators = " \t&|=!<>\"";
+
+  size_t i = 0;
+  while (i < expr.length()) {
+    if (isspace(expr[i])) {
+      i++;
+      continue;
+    }
+
+    if (expr[i] == '"') {
+      size_t end = expr.find('"', i + 1);
+      if (end == std::string::npos) {
+        return false;
+      }
+      // Keep the opening quote, to tell strings apart from operators
+      tokens.push_back(expr.substr(i, end - i));
+      i = end + 1;
+      continue;
+    }
+
+    bool found = false;
+    for (unsigned int j = 0; j < sizeof(operators) / sizeof(operators[0]);
+         j++) {
+      size_t len = strlen(operators[j]);
+      if (expr.compare(i, len, operators[j]) == 0) {
+        tokens.push_back(operators[j]);
+        i += len;
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      size_t end = expr.find_first_of(separators, i);
+      if (end == i) {
+        // A lone '&', '|' or '='
+        return false;
+      }
+      if (end == std::string::npos) {
+        end = expr.length();
+      }
+      tokens.push_back(expr.substr(i, end - i));
+      i = end;
+    }
+  }
+
+  return true;
+}
+
+// Parse an unsigned number (decimal, hex or octal)
+static bool filter_parse_number(const std::string &s, uint64_t &value) {
+  char *end;
+  value = strtoull(s.c_str(), &end, 0);
+  return !s.empty() && isdigit(s[0]) && *end == '\0';
+}
+
+bool OutputFilter::parseCondition(const std::vector<std::string> &tokens,
+                                  size_t &pos,
+                                  const FilterSyscallResolver &resolver,
+                                  FilterCondition &cond, std::string &error) {
+  cond.negated = false;
+  while (pos < tokens.size() && tokens[pos] == "!") {
+    cond.negated = !cond.negated;
+    pos++;
+  }
+
+  if (pos >= tokens.size()) {
+    error = "missing field name";
+    return false;
+  }
+
+  int field;
+  for (field = 0; field < FieldMax; field++) {
+    if (tokens[pos] == filter_field_names[field]) {
+      break;
+    }
+  }
+
+  if (field == FieldMax) {
+    error = "unknown field '" + tokens[pos] + "'";
+    return false;
+  }
+
+  cond.field = static_cast<FilterField>(field);
+  pos++;
+
+  static const char *ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+  int op = -1;
+  if (pos < tokens.size()) {
+    for (unsigned int i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+      if (tokens[pos] == ops[i]) {
+        op = i;
+        break;
+      }
+    }
+  }
+
+  if (op == -1) {
+    // Bare field, holds if non-zero
+    if (cond.field == FieldProcess) {
+      error = "field 'process' requires a value";
+      return false;
+    }
+    cond.op = OpNe;
+    cond.value = 0;
+    return true;
+  }
+
+  cond.op = static_cast<FilterOp>(op);
+  pos++;
+
+  if (pos >= tokens.size() || tokens[pos] == "&&" || tokens[pos] == "||") {
+    error = std::string("missing value for field '") +
+      filter_field_names[field] + "'";
+    return false;
+  }
+
+  std::string value = tokens[pos++];
+  if (value[0] == '"') {
+    value = value.substr(1);
+  }
+
+  if (cond.field == FieldProcess) {
+    if (cond.op != OpEq && cond.op != OpNe) {
+      error = "field 'process' supports only == and !=";
+      return false;
+    }
+    cond.str = value;
+    return true;
+  }
+
+  if (filter_parse_number(value, cond.value)) {
+    return true;
+  }
+
+  if (cond.field == FieldStatus) {
+    for (unsigned int i = 0;
+         i < sizeof(filter_status_names) / sizeof(filter_status_names[0]);
+         i++) {
+      if (value == filter_status_names[i]) {
+        cond.value = i;
+        return true;
+      }
+    }
+  }
+
+  if (cond.field == FieldSysno && resolver) {
+    int sysno = resolver(value);
+    if (sysno != -1) {
+      cond.value = sysno;
+      return true;
+    }
+  }
+
+  error = "invalid value '" + value + "' for field '" +
+    filter_field_names[field] + "'";
+  return false;
+}
+
+bool OutputFilter::compile(const std::string &expr,
+                           const FilterSyscallResolver &resolver,
+                           std::string &error) {
+  std::vector<std::string> tokens;
+  if (!filter_tokenize(expr, tokens)) {
+    error = "syntax error";
+    return false;
+  }
+
+  if (tokens.empty()) {
+    error = "empty expression";
+    return false;
+  }
+
+  std::vector<FilterClause> clauses(1);
+  unsigned int fields = 0;
+  size_t pos = 0;
+  while (true) {
+    FilterCondition cond;
+    if (!parseCondition(tokens, pos, resolver, cond, error)) {
+      return false;
+    }
+
+    clauses.back().push_back(cond);
+    fields |= 1 << cond.field;
+
+    if (pos >= tokens.size()) {
+      break;
+    }
+
+    if (tokens[pos] == "||") {
+      clauses.push_back(FilterClause());
+    } else if (tokens[pos] != "&&") {
+      error = "unexpected token '" + tokens[pos] + "'";
+      return false;
+    }
+    pos++;
+  }
+
+  expr_ = expr;
+  clauses_.swap(clauses);
+  fields_ = fields;
+  accepted_.store(0, std::memory_order_relaxed);
+  rejected_.store(0, std::memory_order_relaxed);
+  return true;
+}
+
+bool OutputFilter::evalCondition(const FilterCondition &cond,
+                                 const FilterRecord &record) {
+  uint64_t value;
+  switch (cond.field) {
+  case FieldSysno:
+    value = record.sysno;
+    break;
+  case FieldRetval:
+    value = record.retval;
+    break;
+  case FieldStatus:
+    // NTSTATUS severity is stored in the two most significant bits
+    value = static_cast<uint32_t>(record.retval) >> 30;
+    break;
+  case FieldProcess:
+    assert(record.process);
+    return ((*record.process == cond.str) == (cond.op == OpEq)) !=
+      cond.negated;
+  case FieldNumArgs:
+    value = record.nargs;
+    break;
+  case FieldBytes:
+    value = record.bytes;
+    break;
+  case FieldTainted:
+    value = record.tainted;
+    break;
+  default:
+    assert(false);
+    return false;
+  }
+
+  bool r;
+  switch (cond.op) {
+  case OpEq: r = value == cond.value; break;
+  case OpNe: r = value != cond.value; break;
+  case OpLt: r = value < cond.value; break;
+  case OpLe: r = value <= cond.value; break;
+  case OpGt: r = value > cond.value; break;
+  case OpGe: r = value >= cond.value; break;
+  default:
+    assert(false);
+    return false;
+  }
+
+  return r != cond.negated;
+}
+
+bool OutputFilter::accept(const FilterRecord &record) {
+  bool r = clauses_.empty();
+  for (auto it = clauses_.begin(); !r && it != clauses_.end(); it++) {
+    r = true;
+    for (auto itcond = it->begin(); r && itcond != it->end(); itcond++) {
+      r = evalCondition(*itcond, record);
+    }
+  }
+
+  if (r) {
+    accepted_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return r;
+}
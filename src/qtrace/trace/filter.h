@@ -0,0 +1,133 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// This QTrace module implements output filters, i.e., predicates evaluated on
+// completed system calls before they are serialized. System calls rejected by
+// the filter are not encoded at all. Filters are expressions in disjunctive
+// normal form:
+//
+//   expr   := clause ("||" clause)*
+//   clause := cond ("&&" cond)*
+//   cond   := ["!"] FIELD [OP VALUE]
+//
+// where OP is one of ==, !=, <, <=, >, >=, and FIELD is one of:
+//
+//   sysno      System call number (VALUE can also be a syscall name)
+//   retval     Return value
+//   status     NTSTATUS severity: success, info, warning or error
+//   process    Process name (only == and !=)
+//   nargs      Number of level-0 arguments
+//   bytes      Input and output data bytes, including nested arguments
+//   tainted    Non-zero if any argument uses taint labels
+//
+// A condition without an operator holds if the field is non-zero.
+//
+
+#ifndef SRC_QTRACE_TRACE_FILTER_H_
+#define SRC_QTRACE_TRACE_FILTER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "qtrace/common.h"
+
+enum FilterField {
+  FieldSysno = 0,
+  FieldRetval,
+  FieldStatus,
+  FieldProcess,
+  FieldNumArgs,
+  FieldBytes,
+  FieldTainted,
+  FieldMax,
+};
+
+// Values of the "status" field
+enum FilterStatus {
+  StatusSuccess = 0,
+  StatusInfo,
+  StatusWarning,
+  StatusError,
+};
+
+// Fields of a completed system call, as seen by filters. Fields not used by
+// the filter can be left uninitialized
+struct FilterRecord {
+  target_ulong sysno;
+  target_ulong retval;
+  const std::string *process;
+  unsigned int nargs;
+  unsigned int bytes;
+  bool tainted;
+};
+
+// Resolve a syscall name to its number. Returns -1 for unknown names
+typedef std::function<int(const std::string &)> FilterSyscallResolver;
+
+class OutputFilter {
+ private:
+  enum FilterOp { OpEq, OpNe, OpLt, OpLe, OpGt, OpGe };
+
+  struct FilterCondition {
+    FilterField field;
+    FilterOp op;
+    bool negated;
+    uint64_t value;
+    std::string str;
+  };
+
+  typedef std::vector<FilterCondition> FilterClause;
+
+  // Filter expression, as specified, and its compiled form
+  std::string expr_;
+  std::vector<FilterClause> clauses_;
+
+  // Bitmap of the fields used by the filter
+  unsigned int fields_;
+
+  // Statistics. Filters may run on the worker thread (-qtrace-async), while
+  // the monitor reads these counters
+  std::atomic<uint64_t> accepted_;
+  std::atomic<uint64_t> rejected_;
+
+  // Parse a single condition from @tokens, starting at @pos
+  bool parseCondition(const std::vector<std::string> &tokens, size_t &pos,
+                      const FilterSyscallResolver &resolver,
+                      FilterCondition &cond, std::string &error);
+
+  static bool evalCondition(const FilterCondition &cond,
+                            const FilterRecord &record);
+
+ public:
+  OutputFilter() : fields_(0), accepted_(0), rejected_(0) {}
+
+  // Compile the filter expression @expr. Returns false and sets @error if the
+  // expression is invalid
+  bool compile(const std::string &expr, const FilterSyscallResolver &resolver,
+               std::string &error);
+
+  // Check if the filter uses field @field
+  bool uses(FilterField field) const {
+    return (fields_ & (1 << field)) != 0;
+  }
+
+  // Evaluate the filter on a completed system call, updating statistics
+  bool accept(const FilterRecord &record);
+
+  const std::string &getExpression() const {
+    return expr_;
+  }
+
+  uint64_t getNumAccepted() const {
+    return accepted_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t getNumRejected() const {
+    return rejected_.load(std::memory_order_relaxed);
+  }
+};
+
+#endif  // SRC_QTRACE_TRACE_FILTER_H_
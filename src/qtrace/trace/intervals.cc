@@ -105,6 +105,35 @@ unsigned int DataIntervalSet::getMaxLength() const {
   return size;
 }
 
+unsigned int DataIntervalSet::getDataSize() const {
+  unsigned int size = 0;
+
+  for (auto it = elements_.begin(); it != elements_.end(); it++) {
+    size += it->getLength();
+  }
+
+  return size;
+}
+
+unsigned int DataIntervalSet::getMissingSize(unsigned int start,
+                                             unsigned int size) const {
+  if (size == 0) {
+    return 0;
+  }
+
+  // Intervals are coalesced when added, thus they never overlap each other
+  unsigned int end = start + size - 1;
+  for (auto it = elements_.begin(); it != elements_.end(); it++) {
+    unsigned int low  = std::max(start, it->getLow());
+    unsigned int high = std::min(end, it->getHigh());
+    if (low <= high) {
+      size -= high - low + 1;
+    }
+  }
+
+  return size;
+}
+
 int DataIntervalSet::read(unsigned int start, unsigned int size,
                           unsigned char *buffer) const {
   int r = -1;
@@ -69,6 +69,13 @@ class DataIntervalSet {
   // endpoints) otherwise
   unsigned int getMaxLength() const;
 
+  // Get the number of data bytes stored in this set
+  unsigned int getDataSize() const;
+
+  // Get the number of bytes in [start, start+size-1] that are not stored in
+  // this set
+  unsigned int getMissingSize(unsigned int start, unsigned int size) const;
+
   // Read "size" bytes starting from offset "start" into buffer "buffer". If a
   // sub-interval of [start, start+size-1] is not present in this set, -1 is
   // returned. Otherwise, data is written into "buffer" and function returns 0.
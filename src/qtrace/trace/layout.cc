@@ -0,0 +1,129 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+
+#include "qtrace/trace/layout.h"
+
+#include <cassert>
+
+#include "qtrace/context.h"
+#include "qtrace/logging.h"
+
+bool LayoutCache::getKey(const Syscall *syscall, uint64_t &key) const {
+  target_ulong caller = 0;
+
+  if (per_caller_) {
+    // Return address of the syscall stub, inside the user-space caller
+    target_ulong addr = syscall->stack + sizeof(target_ulong);
+    if (gbl_context.cb_peek(addr, reinterpret_cast<unsigned char *>(&caller),
+                            sizeof(caller)) != 0) {
+      return false;
+    }
+  }
+
+  key = (static_cast<uint64_t>(syscall->sysno) << 32) | caller;
+  return true;
+}
+
+void LayoutCache::learnPointers(const SyscallArg *arg, unsigned int depth,
+                                std::vector<LayoutPointer> &ptrs) {
+  if (depth >= MAX_LAYOUT_DEPTH) {
+    return;
+  }
+
+  for (auto it = arg->ptrs.begin(); it != arg->ptrs.end(); it++) {
+    LayoutPointer ptr;
+    ptr.offset = (*it)->offset;
+    ptr.size = (*it)->getSize();
+    learnPointers(*it, depth + 1, ptr.ptrs);
+    ptrs.push_back(ptr);
+  }
+}
+
+void LayoutCache::learn(const Syscall *syscall) {
+  uint64_t key;
+  if (!getKey(syscall, key)) {
+    return;
+  }
+
+  SyscallLayout layout;
+  target_ulong base = syscall->getArgumentsAddress();
+  for (auto it = syscall->args.begin(); it != syscall->args.end(); it++) {
+    std::vector<LayoutPointer> ptrs;
+    learnPointers(*it, 0, ptrs);
+
+    // Rebase top-level offsets on the arguments block
+    for (auto itptr = ptrs.begin(); itptr != ptrs.end(); itptr++) {
+      itptr->offset += (*it)->addr - base;
+      layout.push_back(*itptr);
+    }
+  }
+
+  if (layouts_.size() >= MAX_LAYOUT_CACHE_SIZE &&
+      layouts_.find(key) == layouts_.end()) {
+    TRACE("Argument layout cache is full, flushing");
+    layouts_.clear();
+  }
+
+  layouts_[key].swap(layout);
+}
+
+void LayoutCache::applyPointers(Syscall *syscall, SyscallArg *arg,
+                                const std::vector<LayoutPointer> &ptrs) {
+  for (auto it = ptrs.begin(); it != ptrs.end(); it++) {
+    // Pointed data has not been accessed yet, read pointer values directly
+    target_ulong value;
+    if (gbl_context.cb_peek(arg->addr + it->offset,
+                            reinterpret_cast<unsigned char *>(&value),
+                            sizeof(value)) != 0 ||
+        !gbl_context.windows->isUserPointer(value, sizeof(value))) {
+      continue;
+    }
+
+    SyscallArg *child = syscall->addLearnedArgument(arg, it->offset, value,
+                                                    it->size);
+    if (child) {
+      applyPointers(syscall, child, it->ptrs);
+    }
+  }
+}
+
+bool LayoutCache::apply(Syscall *syscall) {
+  uint64_t key;
+  if (!getKey(syscall, key)) {
+    return false;
+  }
+
+  auto it = layouts_.find(key);
+  if (it == layouts_.end()) {
+    return false;
+  }
+
+  target_ulong base = syscall->getArgumentsAddress();
+  for (auto itptr = it->second.begin(); itptr != it->second.end(); itptr++) {
+    unsigned int argno = itptr->offset / sizeof(target_ulong);
+    if (argno >= syscall->args.size()) {
+      continue;
+    }
+
+    // Level-0 pointer values have already been read
+    SyscallArg *arg = syscall->args[argno];
+    int offset = base + itptr->offset - arg->addr;
+    target_ulong value;
+    if (arg->indata.read(offset, sizeof(value),
+                         reinterpret_cast<unsigned char *>(&value)) != 0 ||
+        !gbl_context.windows->isUserPointer(value, sizeof(value))) {
+      continue;
+    }
+
+    SyscallArg *child = syscall->addLearnedArgument(arg, offset, value,
+                                                    itptr->size);
+    if (child) {
+      applyPointers(syscall, child, itptr->ptrs);
+    }
+  }
+
+  TRACE("Applied cached argument layout to syscall #%d (%s)", syscall->sysno,
+        gbl_context.windows->getSyscallName(syscall->sysno));
+  return true;
+}
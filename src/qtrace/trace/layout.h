@@ -0,0 +1,73 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// This QTrace module caches the layout of system call arguments (i.e., the
+// offsets of confirmed data pointers, their nesting and the size of pointed
+// data), learned from completed system calls. Later invocations of the same
+// system call use the cached layout to pre-create their argument tree, so that
+// memory accesses can be matched directly to arguments. Accesses that do not
+// fit the layout are processed by the usual pointer inference.
+//
+
+#ifndef SRC_QTRACE_TRACE_LAYOUT_H_
+#define SRC_QTRACE_TRACE_LAYOUT_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "qtrace/common.h"
+#include "qtrace/options.h"
+#include "qtrace/trace/syscall.h"
+
+// Maximum nesting depth of cached data pointers
+const unsigned int MAX_LAYOUT_DEPTH = 4;
+
+// Upper bound for the number of cached layouts
+const unsigned int MAX_LAYOUT_CACHE_SIZE = 4096;
+
+// A data pointer learned from a previous system call invocation
+struct LayoutPointer {
+  int offset;                           // Offset inside the parent argument
+  unsigned int size;                    // Size of the pointed data
+  std::vector<LayoutPointer> ptrs;      // Nested data pointers
+};
+
+// Layout of the arguments of a system call. Offsets of top-level pointers are
+// relative to the start of the level-0 arguments block
+typedef std::vector<LayoutPointer> SyscallLayout;
+
+class LayoutCache {
+ private:
+  // Are layouts keyed by user-space caller, besides syscall number?
+  bool per_caller_;
+
+  // Cached layouts, keyed by syscall number (and caller address)
+  std::unordered_map<uint64_t, SyscallLayout> layouts_;
+
+  // Get the cache key for a system call. Returns false if the key cannot be
+  // computed (e.g., the return address is not readable)
+  bool getKey(const Syscall *syscall, uint64_t &key) const;
+
+  // Collect the data pointers of @arg, recursively
+  static void learnPointers(const SyscallArg *arg, unsigned int depth,
+                            std::vector<LayoutPointer> &ptrs);
+
+  // Pre-create the arguments for data pointers @ptrs, embedded in @arg
+  static void applyPointers(Syscall *syscall, SyscallArg *arg,
+                            const std::vector<LayoutPointer> &ptrs);
+
+ public:
+  explicit LayoutCache(QTraceLayoutMode mode)
+    : per_caller_(mode == LayoutCaller) {}
+
+  // Record the argument layout of a completed system call
+  void learn(const Syscall *syscall);
+
+  // Pre-create the argument tree of a system call, according to the cached
+  // layout. Level-0 arguments must have been read already. Returns false if no
+  // layout is cached for this system call
+  bool apply(Syscall *syscall);
+};
+
+#endif  // SRC_QTRACE_TRACE_LAYOUT_H_
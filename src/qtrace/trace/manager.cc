@@ -4,38 +4,70 @@
 
 #include "qtrace/trace/manager.h"
 
-#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <vector>
 #include <string>
 
 #include "qtrace/logging.h"
 #include "qtrace/context.h"
+#include "qtrace/trace/memory.h"
 #include "qtrace/trace/serialize.h"
 
 #ifdef CONFIG_QTRACE_TAINT
 #include "qtrace/taint/tracker.h"
 #endif
 
+unsigned int qtrace_tracer_syscalls = 0;
+
 TraceManager::TraceManager(bool track_foreign,
+                           bool snapshot_args,
+                           bool async_events,
+                           QTraceLayoutMode layout_mode,
+                           const char *capturelimits,
+                           const char *sampling,
                            const char *filtersyscalls,
                            const char *filterprocess)
-  : current_syscall_id_(0), track_foreign_(track_foreign) {
+  : current_syscall_id_(0), track_foreign_(track_foreign),
+    snapshot_args_(snapshot_args) {
+  if (layout_mode != LayoutDisabled) {
+    layouts_.reset(new LayoutCache(layout_mode));
+  }
+
+  if (async_events) {
+    events_.reset(new TraceEventQueue(TRACE_EVENT_RING_SIZE));
+    events_->start();
+  }
+
+  // Capture limits are validated when parsing the command line
+  memset(&limits_, 0, sizeof(limits_));
+  if (capturelimits &&
+      qtrace_parse_capture_limits(capturelimits, &limits_) != 0) {
+    ERROR("Invalid capture limits '%s', ignoring", capturelimits);
+    memset(&limits_, 0, sizeof(limits_));
+  }
+
+  if (sampling && !sampling_.configure(sampling)) {
+    WARNING("Invalid sampling policy '%s', ignoring", sampling);
+  }
+
   // Split the system calls filter string on commas and resolve syscall names
   // to numbers
   if (filtersyscalls) {
+    filter_sysno_.resize(gbl_context.windows->getNumSyscalls(), false);
+
     std::stringstream ss(filtersyscalls);
     std::string syscall_name;
     while (std::getline(ss, syscall_name, ',')) {
       int sysno = gbl_context.windows->getSyscallNumber(syscall_name);
       if (sysno == -1) {
         WARNING("Invalid syscall name '%s', ignoring", syscall_name.c_str());
+        continue;
       }
-      filter_sysno_.push_back(sysno);
+      filter_sysno_[sysno] = true;
     }
-
-    // Keep filter_sysno_ sorted to optimize lookups
-    std::sort(filter_sysno_.begin(), filter_sysno_.end());
   }
 
   if (filterprocess) {
@@ -43,8 +75,18 @@ TraceManager::TraceManager(bool track_foreign,
   }
 }
 
+TraceManager::SyscallMap::const_iterator
+TraceManager::findSyscall(RunningProcess &rp) const {
+  // Locating the running thread requires reading guest memory
+  if (!current_syscalls_.contains(rp.getCr3())) {
+    return current_syscalls_.end();
+  }
+
+  return current_syscalls_.find(rp.getCr3(), rp.getThread());
+}
+
 Syscall* TraceManager::getSyscallForProcess(RunningProcess &rp) const {
-  auto it = current_syscalls_.find(rp.getCr3());
+  auto it = findSyscall(rp);
   if (it == current_syscalls_.end()) {
     return NULL;
   }
@@ -66,43 +108,129 @@ Syscall* TraceManager::getSyscallForProcess(RunningProcess &rp) const {
 
 void TraceManager::addSyscallForProcess(RunningProcess &rp, Syscall *syscall) {
   assert(getSyscallForProcess(rp) == NULL);
-  current_syscalls_[rp.getCr3()] = syscall;
+  syscall->thread = rp.getThread();
+  current_syscalls_.insert(rp.getCr3(), syscall);
+  qtrace_tracer_syscalls = current_syscalls_.size();
 }
 
 bool TraceManager::hasSyscallForProcess(const target_ulong cr3) const {
-  return current_syscalls_.count(cr3) > 0;
+  return current_syscalls_.contains(cr3);
+}
+
+void TraceManager::deleteSyscallForProcess(RunningProcess &rp) {
+  auto it = findSyscall(rp);
+  assert(it != current_syscalls_.end());
+  delete it->second;
+  current_syscalls_.erase(it);
+  qtrace_tracer_syscalls = current_syscalls_.size();
+}
+
+bool TraceManager::isAddressSpaceTraced(target_ulong cr3) {
+  if (filter_process_.length() == 0) {
+    return true;
+  }
+
+  bool traced;
+  return !getAddressSpaceDecision(cr3, traced) || traced;
+}
+
+bool TraceManager::getAddressSpaceDecision(target_ulong cr3, bool &traced) {
+  auto it = address_spaces_.find(cr3);
+  if (it == address_spaces_.end()) {
+    return false;
+  }
+
+  target_ulong eprocess;
+  uint64_t create_time;
+  if (!gbl_context.windows->isKernelReady() ||
+      gbl_context.windows->getCurrentProcess(eprocess, create_time) != 0) {
+    return false;
+  }
+
+  if (eprocess != it->second.eprocess ||
+      create_time != it->second.create_time) {
+    // The process has been torn down, and its CR3 value recycled
+    DEBUG("Address space @%.8x now belongs to EPROCESS %.8x, dropping "
+          "filtering decision", cr3, eprocess);
+    address_spaces_.erase(it);
+    return false;
+  }
+
+  traced = it->second.traced;
+  return true;
 }
 
-void TraceManager::deleteSyscallForProcess(const RunningProcess &rp) {
-  delete current_syscalls_[rp.getCr3()];
-  current_syscalls_.erase(rp.getCr3());
+bool TraceManager::shouldProcessProcess(RunningProcess &rp) {
+  if (filter_process_.length() == 0) {
+    return true;
+  }
+
+  bool traced;
+  if (getAddressSpaceDecision(rp.getCr3(), traced)) {
+    return traced;
+  }
+
+  if (!rp.isInitialized() && !rp.canInitialize()) {
+    // Too early to resolve the process name
+    return true;
+  }
+
+  AddressSpace as;
+  if (gbl_context.windows->getCurrentProcess(as.eprocess,
+                                             as.create_time) != 0) {
+    // Can't identify the process, make the decision again next time
+    return rp.getName() == filter_process_;
+  }
+
+  as.traced = (rp.getName() == filter_process_);
+  address_spaces_[rp.getCr3()] = as;
+
+  DEBUG("Address space @%.8x (%s, EPROCESS %.8x) is %s", rp.getCr3(),
+        rp.getName().c_str(), as.eprocess,
+        as.traced ? "traced" : "filtered out");
+
+  return as.traced;
 }
 
 bool TraceManager::shouldProcessSyscall(target_ulong sysno,
-                                        RunningProcess &rp) const {
+                                        RunningProcess &rp) {
   bool traceme = true;
 
   // Check on syscall filter
   if (filter_sysno_.size() > 0) {
-    // Here we exploit the fact that filter_sysno_ is sorted
-    auto low = std::lower_bound(filter_sysno_.begin(),
-                                filter_sysno_.end(),
-                                sysno);
-
-    traceme = (low != filter_sysno_.end() && *low == sysno);
+    traceme = (sysno < filter_sysno_.size() && filter_sysno_[sysno]);
   }
 
   // Check on process name
-  if (traceme && filter_process_.length() > 0 &&
-      (rp.isInitialized() || rp.canInitialize())) {
-    traceme = (rp.getName() == filter_process_);
+  if (traceme) {
+    traceme = shouldProcessProcess(rp);
+  }
+
+  // Check on sampling policy, only for system calls that would be traced
+  if (traceme && sampling_.isEnabled()) {
+    uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+    traceme = sampling_.shouldSample(sysno, rp.getCr3(), now);
   }
 
   return traceme;
 }
 
-void TraceManager::eventSyscallStart(RunningProcess &rp, target_ulong sysno,
-                                     target_ulong stack) {
+bool TraceManager::setSamplingPolicy(const char *spec) {
+  if (!sampling_.configure(spec)) {
+    ERROR("Invalid sampling policy '%s'", spec);
+    return false;
+  }
+
+  INFO("Sampling policy is now %s", sampling_.getSpec().c_str());
+  return true;
+}
+
+SyscallStartResult TraceManager::eventSyscallStart(RunningProcess &rp,
+                                                   target_ulong sysno,
+                                                   target_ulong stack) {
+  HostTimer timer;
+
   if (getSyscallForProcess(rp)) {
     // Current system call is still active, terminate it.
     // FIXME: We put a dummy return value here, as we already missed the real
@@ -116,21 +244,122 @@ void TraceManager::eventSyscallStart(RunningProcess &rp, target_ulong sysno,
   if (!shouldProcessSyscall(sysno, rp)) {
     TRACE("Filtering out syscall (#%d, %s)", sysno,
           gbl_context.windows->getSyscallName(sysno));
-    return;
+    return shouldProcessProcess(rp) ?
+      SyscallStartSkipped : SyscallStartFiltered;
   }
 
   // Initiate a new Syscall object
   Syscall *current_syscall = new Syscall(current_syscall_id_++,
                                          sysno, stack, rp.getCr3());
+  current_syscall->limits = limits_;
+  current_syscall->start_time = stats_clock_ns();
+  current_syscall->start_icount = gbl_context.cb_icount();
+  timer.charge(&current_syscall->host_time);
+
+  CpuRegisters regs;
+  if (gbl_context.cb_regs(&regs) == 0) {
+    current_syscall->cpu = regs.cpu;
+  }
 
   addSyscallForProcess(rp, current_syscall);
 
+  if (snapshot_args_) {
+    snapshotArguments(current_syscall);
+  }
+
   DEBUG("Starting system call #%d (stack %08x): %s",
         current_syscall->sysno, current_syscall->stack,
         gbl_context.windows->getSyscallName(current_syscall->sysno));
+
+  return SyscallStartTraced;
+}
+
+void TraceManager::snapshotArguments(Syscall *syscall) {
+  unsigned int nargs;
+  if (gbl_context.windows->getSyscallArgumentCount(syscall->sysno, nargs) != 0
+      || nargs > MAX_SYSCALL_ARGS) {
+    return;
+  }
+
+  std::vector<target_ulong> values(nargs);
+  if (nargs > 0 &&
+      gbl_context.cb_peek(syscall->getArgumentsAddress(),
+                          reinterpret_cast<unsigned char *>(&values[0]),
+                          nargs * sizeof(target_ulong)) != 0) {
+    // Arguments are not mapped yet: the kernel copy will fault them in
+    return;
+  }
+
+  CpuRegisters regs;
+  int err = gbl_context.cb_regs(&regs);
+  assert(err == 0);
+
+  target_ulong addr = syscall->getArgumentsAddress();
+  for (unsigned int i = 0; i < nargs; i++) {
+    memory_read_level0(regs.pc, syscall, addr, sizeof(target_ulong),
+                       values[i]);
+    addr += sizeof(target_ulong);
+  }
+
+  syscall->missing_args = 0;
+  eventArgumentsComplete(syscall);
+}
+
+void TraceManager::eventArgumentsComplete(Syscall *syscall) {
+  if (layouts_) {
+    waitEvents(syscall);
+    layouts_->apply(syscall);
+  }
+}
+
+void TraceManager::dispatchEvent(const TraceEvent &event) {
+  if (!events_) {
+    trace_event_replay(event);
+    return;
+  }
+
+  // Serialized system calls are owned by the worker, and must not be touched
+  // anymore
+  Syscall *syscall = event.syscall;
+  uint64_t seq = events_->push(event);
+  if (event.type != EventSerialize) {
+    syscall->last_event = seq;
+  }
+}
+
+// Accumulate data bytes of an argument and its children
+static void manager_count_bytes(const SyscallArg *arg, unsigned int &bytes) {
+  bytes += arg->indata.getDataSize() + arg->outdata.getDataSize();
+  for (auto it = arg->ptrs.begin(); it != arg->ptrs.end(); it++) {
+    manager_count_bytes(*it, bytes);
+  }
+}
+
+void TraceManager::accountSyscall(const Syscall *syscall) {
+  SyscallCost cost;
+  cost.latency = syscall->end_time - syscall->start_time;
+  cost.instructions = -1;
+  if (syscall->start_icount >= 0 && syscall->end_icount >= 0) {
+    cost.instructions = syscall->end_icount - syscall->start_icount;
+  }
+  cost.host_time = syscall->host_time;
+  cost.hooks = syscall->hooks;
+  cost.bytes = 0;
+  for (auto it = syscall->args.begin(); it != syscall->args.end(); it++) {
+    manager_count_bytes(*it, cost.bytes);
+  }
+
+  stats_.add(syscall->sysno, cost);
+}
+
+void TraceManager::waitEvents(const Syscall *syscall) {
+  if (events_) {
+    events_->wait(syscall->last_event);
+  }
 }
 
 void TraceManager::eventSyscallEnd(RunningProcess &rp, target_ulong retval) {
+  uint64_t now = stats_clock_ns();
   Syscall *current_syscall = getSyscallForProcess(rp);
 
   if (!current_syscall) {
@@ -138,14 +367,23 @@ void TraceManager::eventSyscallEnd(RunningProcess &rp, target_ulong retval) {
     return;
   }
 
+  current_syscall->end_time = now;
+  current_syscall->end_icount = gbl_context.cb_icount();
+
+  // Process all memory accesses first
+  waitEvents(current_syscall);
+
   // Update the system call return value
   current_syscall->retval = retval;
 
+  // Drop pre-created arguments the kernel did not access
+  current_syscall->pruneLearnedArguments();
+
   // Cleanup foreign data pointers
   if (isForeignEnabled()) {
     current_syscall->cleanupForeignPointers();
     if (current_syscall->foreign_ptrs.size() > 0) {
-      DEBUG("Got %d foreign pointer(s)",
+      DEBUG("Got %zu foreign pointer(s)",
             current_syscall->foreign_ptrs.size());
       for (auto it = current_syscall->foreign_ptrs.begin();
            it != current_syscall->foreign_ptrs.end(); it++) {
@@ -161,19 +399,37 @@ void TraceManager::eventSyscallEnd(RunningProcess &rp, target_ulong retval) {
 #endif
 
   // Dump this system call
-  DEBUG(current_syscall->to_string().c_str());
+  DEBUG("%s", current_syscall->to_string().c_str());
+
+  // The Syscall object may be handed over to the worker thread below, thus we
+  // cannot rely on a HostTimer here
+  if (stats_host_time) {
+    current_syscall->host_time += stats_clock_ns() - now;
+  }
+  accountSyscall(current_syscall);
 
   // Ensure we processed all "level 0" arguments. The '< 0' case is for system
   // calls with no arguments, as in this case missing_args equals to -1 (not
   // initialized).
   if (current_syscall->missing_args <= 0) {
-    serialize_syscall(current_syscall);
+    if (layouts_) {
+      layouts_->learn(current_syscall);
+    }
 
     DEBUG("Returning from system call #%d (%.8x): %s",
           current_syscall->sysno, current_syscall->sysno,
           gbl_context.windows->getSyscallName(current_syscall->sysno));
+
+    // Serialize and delete the system call, possibly on the worker thread.
+    // The worker owns the object from now on
+    current_syscalls_.erase(findSyscall(rp));
+    qtrace_tracer_syscalls = current_syscalls_.size();
+    TraceEvent event = { EventSerialize, 0, current_syscall, 0, 0, 0, NULL };
+    dispatchEvent(event);
+    return;
   } else {
-    ERROR("Still %d missing arguments for this system call. Skipping it!");
+    ERROR("Still %d missing arguments for this system call. Skipping it!",
+          current_syscall->missing_args);
   }
 
   deleteSyscallForProcess(rp);
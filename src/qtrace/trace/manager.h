@@ -8,46 +8,109 @@
 #ifndef SRC_QTRACE_TRACE_MANAGER_H_
 #define SRC_QTRACE_TRACE_MANAGER_H_
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <string>
 
 #include "qtrace/common.h"
+#include "qtrace/options.h"
+#include "qtrace/trace/events.h"
+#include "qtrace/trace/layout.h"
+#include "qtrace/trace/notify_syscall.h"
+#include "qtrace/trace/sampling.h"
+#include "qtrace/trace/stats.h"
 #include "qtrace/trace/syscall.h"
 #include "qtrace/trace/process.h"
+#include "qtrace/trace/threadmap.h"
 
 class TraceManager {
  private:
+  // Filtering decision for an address space, and the process it was made for
+  struct AddressSpace {
+    bool traced;
+    target_ulong eprocess;
+    uint64_t create_time;
+  };
+
   // Identifier of of the last instantiated system call object
   unsigned int current_syscall_id_;
 
   // Should we track external references?
   bool track_foreign_;
 
-  // The structure that represents current system calls. Map key is the process
-  // CR3 value
-  std::unordered_map<target_ulong, Syscall*> current_syscalls_;
+  // Should level-0 arguments be read with a single access at syscall entry?
+  bool snapshot_args_;
+
+  // Cache of argument layouts, or NULL if disabled
+  std::unique_ptr<LayoutCache> layouts_;
+
+  // Ring of events replayed by a worker thread, or NULL if events are
+  // processed synchronously
+  std::unique_ptr<TraceEventQueue> events_;
+
+  // Capture limits, applied to every system call
+  CaptureLimits limits_;
+
+  // Sampling policy, applied to system calls that pass the filters
+  SamplingPolicy sampling_;
+
+  // Cost of completed system calls, by syscall number
+  SyscallStats stats_;
 
-  // List of system call numbers to process, extracted from command-line
-  //
-  // Constraint: after initialization, this vector is sorted
-  std::vector<target_ulong> filter_sysno_;
+  // The structure that represents current system calls, keyed by process CR3
+  // value and calling thread
+  typedef ThreadMap<Syscall> SyscallMap;
+  SyscallMap current_syscalls_;
+
+  // Bitmap of system call numbers to process, extracted from command-line and
+  // indexed by syscall number. Empty if all system calls must be processed
+  std::vector<bool> filter_sysno_;
 
   // Name of the process to trace. If not set (i.e., empty string), trace all
   // system processes
   std::string filter_process_;
 
+  // Filtering decisions for address spaces, according to the process filter.
+  // Map key is the process CR3 value
+  std::unordered_map<target_ulong, AddressSpace> address_spaces_;
+
   // Syscalls filtering
-  bool shouldProcessSyscall(target_ulong sysno, RunningProcess &rp) const;
+  bool shouldProcessSyscall(target_ulong sysno, RunningProcess &rp);
+
+  // Process filtering. The decision is cached for the address space of @rp
+  bool shouldProcessProcess(RunningProcess &rp);
+
+  // Get the cached filtering decision for address space @cr3, which must be
+  // loaded on the current vCPU. Returns false if there is none, or if it was
+  // made for a process that has been torn down since (i.e., @cr3 now belongs
+  // to another EPROCESS)
+  bool getAddressSpaceDecision(target_ulong cr3, bool &traced);
+
+  // Find the pending system call of the thread currently running in @rp
+  SyscallMap::const_iterator findSyscall(RunningProcess &rp) const;
 
   // Add a system call for the specified process
   void addSyscallForProcess(RunningProcess &rp, Syscall *syscall);
 
   // Remove the system call for the specified process
-  void deleteSyscallForProcess(const RunningProcess &rp);
+  void deleteSyscallForProcess(RunningProcess &rp);
+
+  // Account the cost of a completed system call
+  void accountSyscall(const Syscall *syscall);
+
+  // Read all level-0 arguments of a system call that is just starting, if
+  // their number is known. Otherwise, arguments are collected by memory hooks
+  // as the kernel copies them
+  void snapshotArguments(Syscall *syscall);
 
  public:
   explicit TraceManager(bool track_foreign,
+                        bool snapshot_args,
+                        bool async_events,
+                        QTraceLayoutMode layout_mode,
+                        const char *capture_limits,
+                        const char *sampling,
                         const char *filter_syscalls,
                         const char *filter_process);
 
@@ -62,10 +125,37 @@ class TraceManager {
   // Check if there exist any pending system call for a given process
   bool hasSyscallForProcess(const target_ulong cr3) const;
 
-  // Event processing for syscall start/end
-  void eventSyscallStart(RunningProcess &rp, target_ulong sysno,
-                         target_ulong stack);
+  // Check if the address space @cr3, which is being loaded on the current
+  // vCPU, must be instrumented. Address spaces not resolved yet are
+  // instrumented, until a decision can be made at their next system call
+  bool isAddressSpaceTraced(target_ulong cr3);
+
+  // Sampling policy
+  bool setSamplingPolicy(const char *spec);
+  const SamplingPolicy &getSamplingPolicy() const {
+    return sampling_;
+  }
+
+  // Per-syscall cost statistics
+  const SyscallStats &getStats() const {
+    return stats_;
+  }
+
+  // Event processing for syscall start/end. Syscall start tells whether the
+  // system call is traced, skipped, or its address space is filtered out
+  SyscallStartResult eventSyscallStart(RunningProcess &rp, target_ulong sysno,
+                                       target_ulong stack);
   void eventSyscallEnd(RunningProcess &rp, target_ulong retval);
+
+  // Notify that all level-0 arguments of @syscall have been read
+  void eventArgumentsComplete(Syscall *syscall);
+
+  // Process an event, either immediately or on the worker thread
+  void dispatchEvent(const TraceEvent &event);
+
+  // Wait until all the events of @syscall have been processed. Must be called
+  // before accessing the Syscall object synchronously
+  void waitEvents(const Syscall *syscall);
 };
 
 #endif  // SRC_QTRACE_TRACE_MANAGER_H_
@@ -4,7 +4,9 @@
 
 #include "qtrace/trace/memory.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <cstring>
 #include <cstdlib>
@@ -18,13 +20,14 @@
 
 static void memory_process_access(target_ulong pc,
                                   Syscall *syscall,
-                                  target_ulong addr, int size,
-                                  target_ulong buffer,
+                                  target_ulong addr,
+                                  const std::string &data,
                                   SyscallDirection direction);
 
 static inline bool memory_check_probing(SyscallDirection direction,
-                                        target_ulong offset, int size,
-                                        target_ulong buffer, SyscallArg *arg);
+                                        target_ulong offset,
+                                        const std::string &data,
+                                        SyscallArg *arg);
 
 void memory_read_level0(target_ulong pc, Syscall *syscall, target_ulong addr,
                         int size, target_ulong buffer) {
@@ -57,16 +60,17 @@ void memory_read_level0(target_ulong pc, Syscall *syscall, target_ulong addr,
 // "output" data buffer with the "input" one: if they match, we simply ignore
 // this write operation.
 static inline bool memory_check_probing(SyscallDirection direction,
-                                        target_ulong offset, int size,
-                                        target_ulong buffer, SyscallArg *arg) {
+                                        target_ulong offset,
+                                        const std::string &data,
+                                        SyscallArg *arg) {
   bool isprobing = false;
 
   if (direction == DirectionOut &&
       arg->indata.getNumDataIntervals() == 1) {
     // Get the data region that was previously read
-    unsigned char *olddata = new unsigned char[size];
-    int err = arg->indata.read(offset, size, olddata);
-    if (err == 0 && !memcmp(olddata, &buffer, size)) {
+    unsigned char *olddata = new unsigned char[data.size()];
+    int err = arg->indata.read(offset, data.size(), olddata);
+    if (err == 0 && !memcmp(olddata, data.data(), data.size())) {
       TRACE("Found output buffer matching input @%.8x, assuming "
             "kernel is probing memory",
             arg->addr + offset);
@@ -78,114 +82,205 @@ static inline bool memory_check_probing(SyscallDirection direction,
   return isprobing;
 }
 
-// Process a @size-byte memory access at address @addr. @buffer holds the data
-// that has been read or that is going to be written, while @is_input indicates
-// if this is a "read" (true) or "write" operation.
-static void memory_process_access(target_ulong pc,
-                                  Syscall *syscall,
-                                  target_ulong addr, int size,
-                                  target_ulong buffer,
-                                  SyscallDirection direction) {
-  // DEBUG DEBUG DEBUG DEBUG DEBUG DEBUG
-  // Do we need this check????? Why?????
-  bool is_pointer;
-  is_pointer = gbl_context.windows->isUserPointer(buffer, size);
-  // DEBUG DEBUG DEBUG DEBUG DEBUG DEBUG
+// Read the word at offset @offset of @data, truncated at the end of the
+// buffer. Returns the number of bytes read
+static inline int memory_read_word(const std::string &data, target_ulong offset,
+                                   target_ulong &value) {
+  int size = std::min(sizeof(target_ulong), data.size() - offset);
+  value = 0;
+  memcpy(&value, data.data() + offset, size);
+  return size;
+}
 
-  // Actualize candidate pointers: if this memory access reads from a location
-  // that was previously inserted inside the candidate pointers list, then
-  // assume this address corresponds to a true user-space data pointer.
-  if (syscall->hasCandidate(addr)) {
-    DEBUG("Actualizing (%s) user-space pointer at %.8x, size %d, buffer %.8x",
-          SyscallArg::directionToString(direction), addr, size, buffer);
-    syscall->actualizeCandidate(addr, buffer, size, direction);
-
-  } else if (gbl_context.trace_manager->isForeignEnabled() && \
-             syscall->hasForeignCandidate(addr)) {
-    DEBUG("Actualizing foreign user-space pointer at %.8x, size %d",
-          addr, size);
-    syscall->actualizeForeignCandidate(addr);
+// Store the data accessed at address @addr inside the closest syscall
+// argument, if any
+static void memory_process_segment(target_ulong pc,
+                                   Syscall *syscall,
+                                   target_ulong addr,
+                                   const std::string &data,
+                                   SyscallDirection direction) {
+  SyscallArg *nearest;
+
+  // Arguments pre-created from a learned layout are matched directly
+  nearest = syscall->findLearnedArgument(addr, data.size());
+  if (nearest == NULL) {
+    nearest = syscall->findClosestArgument(addr);
   }
+  TRACE("Accessing (%s) memory at %.8x, size %zu",
+        SyscallArg::directionToString(direction), addr, data.size());
 
-  // Process arguments access: we now have to store the contents of system call
-  // arguments. The tricky part here is to ascertain the memory address we are
-  // accessing really belongs to a syscall argument.
-  if (gbl_context.windows->isUserPointer(addr, sizeof(addr))) {
-    SyscallArg *nearest;
+  // Set to "true" if the accessed data contains a candidate syscall data
+  // pointer
+  bool is_syscall_candidate = false;
 
-    nearest = syscall->findClosestArgument(addr);
-    TRACE("Accessing (%s) memory at %.8x, size %d, buf %.8x",
-          SyscallArg::directionToString(direction), addr, size, buffer);
-
-    // Set to "true" if address "addr" is detected as a candidate syscall
-    // data pointer
-    bool is_syscall_candidate = false;
-
-    if (nearest != NULL) {
-      assert(addr >= nearest->addr);
-      target_ulong offset = addr - nearest->addr;
-
-      // FIXME: We need to make an educated guess to determine if an address
-      // being read from user-space belongs to an existing syscall argument.
-      //
-      // The current check (i.e., the offset is not too big) is quite bad
-      // (hack).
-      if (offset < MAX_ARGUMENT_OFFSET) {
-        TRACE(" -> nearest %.8x, offset: %d", nearest->addr, offset);
-
-        // Update the data buffer of the nearest argument, storing the pointer
-        // at the specifier offset
-        std::string datastring(reinterpret_cast<char*>(&buffer), size);
-        DataInterval di(offset, offset + size - 1, datastring);
-
-        assert(direction == DirectionIn || direction == DirectionOut);
-        if (direction == DirectionIn) {
-          nearest->indata.add(di, false);
-        } else if (direction == DirectionOut) {
-          nearest->outdata.add(di, true);
-        }
+  if (nearest != NULL) {
+    assert(addr >= nearest->addr);
+    target_ulong offset = addr - nearest->addr;
+
+    // FIXME: We need to make an educated guess to determine if an address
+    // being read from user-space belongs to an existing syscall argument.
+    //
+    // The current check (i.e., the offset is not too big) is quite bad
+    // (hack).
+    if (offset < MAX_ARGUMENT_OFFSET) {
+      TRACE(" -> nearest %.8x, offset: %d", nearest->addr, offset);
 
-        // Update the argument direction
-        if (nearest->direction != direction) {
-          // Check if this write access is due to a memory probing attempt
-          // (i.e., writing the same data that was reade before)
-          bool isprobing =
-            memory_check_probing(direction, offset, size, buffer, nearest);
-
-          if (isprobing) {
-            assert(nearest->indata.getNumDataIntervals() == 1);
-            nearest->indata.flush();
-            nearest->direction = DirectionOut;
-          } else {
-            nearest->direction = DirectionInOut;
+      // Enforce capture limits on argument and syscall data
+      bool limited = syscall->limits.arg_bytes > 0 ||
+        syscall->limits.syscall_bytes > 0;
+      if (limited) {
+        unsigned int len = syscall->getCaptureAllowance(nearest, offset,
+                                                        data.size(),
+                                                        direction);
+        if (len < data.size()) {
+          TRACE(" -> truncated to %d bytes, capture limits reached", len);
+          nearest->truncated = true;
+          syscall->truncated = true;
+          if (len > 0) {
+            memory_process_segment(pc, syscall, addr, data.substr(0, len),
+                                   direction);
           }
+          return;
+        }
+
+        // Charge only the bytes that are not stored yet
+        const DataIntervalSet &stored =
+          direction == DirectionIn ? nearest->indata : nearest->outdata;
+        syscall->captured_bytes += stored.getMissingSize(offset, data.size());
+      }
+
+      // Update the data buffer of the nearest argument, storing the data at
+      // the specified offset
+      DataInterval di(offset, offset + data.size() - 1, data);
+
+      assert(direction == DirectionIn || direction == DirectionOut);
+      if (direction == DirectionIn) {
+        nearest->indata.add(di, false);
+      } else if (direction == DirectionOut) {
+        nearest->outdata.add(di, true);
+      }
+
+      // Update the argument direction
+      if (nearest->speculative) {
+        // First access to an argument pre-created from a learned layout
+        nearest->speculative = false;
+        nearest->direction = direction;
+      } else if (nearest->direction != direction) {
+        // Check if this write access is due to a memory probing attempt
+        // (i.e., writing the same data that was reade before)
+        bool isprobing =
+          memory_check_probing(direction, offset, data, nearest);
+
+        if (isprobing) {
+          assert(nearest->indata.getNumDataIntervals() == 1);
+          nearest->indata.flush();
+          nearest->direction = DirectionOut;
+        } else {
+          nearest->direction = DirectionInOut;
         }
+      }
 
-        // Record this argument as a candidate data pointer
-        if (is_pointer) {
+      // Record user-space pointers as candidate data pointers
+      for (target_ulong i = 0; i < data.size(); i += sizeof(target_ulong)) {
+        target_ulong value;
+        int size = memory_read_word(data, i, value);
+        if (gbl_context.windows->isUserPointer(value, size)) {
           is_syscall_candidate = true;
-          syscall->addCandidate(nearest, offset);
+          syscall->addCandidate(nearest, offset + i);
         }
       }
     }
+  }
 
-    // If this is not a candidate syscall data pointer, then use it as a
-    // "foreign" data pointer
-    if (gbl_context.trace_manager->isForeignEnabled() &&
-        !is_syscall_candidate) {
+  // If this is not a candidate syscall data pointer, then use it as a
+  // "foreign" data pointer
+  if (gbl_context.trace_manager->isForeignEnabled() &&
+      !is_syscall_candidate) {
+    for (target_ulong i = 0; i < data.size(); i += sizeof(target_ulong)) {
+      target_ulong value;
+      memory_read_word(data, i, value);
       TRACE("Adding foreign candidate %.8x (val %.8x, pc %.8x)",
-            addr, buffer, pc);
-      syscall->addForeignCandidate(addr, buffer, pc);
+            addr + i, value, pc);
+      syscall->addForeignCandidate(addr + i, value, pc);
     }
   }
 }
 
+// Process a memory access to the data.size() bytes at address @addr. @data
+// holds the data that has been read or that is going to be written, while
+// @direction indicates if this is a "read" (DirectionIn) or "write" operation.
+// Ranges larger than a word (e.g., string operations) are handled one word at
+// a time for pointers, but data is stored with a single interval for each
+// argument.
+static void memory_process_access(target_ulong pc,
+                                  Syscall *syscall,
+                                  target_ulong addr,
+                                  const std::string &data,
+                                  SyscallDirection direction) {
+  // Offsets where newly actualized pointers begin. Data following each of
+  // these offsets belongs to a different argument
+  std::vector<target_ulong> boundaries;
+  boundaries.push_back(0);
+
+  // Actualize candidate pointers: if this memory access reads from a location
+  // that was previously inserted inside the candidate pointers list, then
+  // assume this address corresponds to a true user-space data pointer.
+  for (target_ulong i = 0; i < data.size(); i += sizeof(target_ulong)) {
+    target_ulong value;
+    int size = memory_read_word(data, i, value);
+
+    if (syscall->hasCandidate(addr + i)) {
+      DEBUG("Actualizing (%s) user-space pointer at %.8x, size %d, "
+            "buffer %.8x", SyscallArg::directionToString(direction),
+            addr + i, size, value);
+      context_event(QTRACE_EVENT_ACTUALIZE, syscall->id, addr + i, value,
+                    size);
+      syscall->actualizeCandidate(addr + i, value, size, direction);
+      if (i > 0) {
+        boundaries.push_back(i);
+      }
+    } else if (gbl_context.trace_manager->isForeignEnabled() && \
+               syscall->hasForeignCandidate(addr + i)) {
+      DEBUG("Actualizing foreign user-space pointer at %.8x, size %d",
+            addr + i, size);
+      context_event(QTRACE_EVENT_FOREIGN, syscall->id, addr + i);
+      syscall->actualizeForeignCandidate(addr + i);
+    }
+  }
+  boundaries.push_back(data.size());
+
+  // Process arguments access: we now have to store the contents of system call
+  // arguments. The tricky part here is to ascertain the memory address we are
+  // accessing really belongs to a syscall argument.
+  if (!gbl_context.windows->isUserPointer(addr, sizeof(addr))) {
+    return;
+  }
+
+  for (unsigned int i = 0; i + 1 < boundaries.size(); i++) {
+    target_ulong offset = boundaries[i];
+    std::string segment = data.substr(offset, boundaries[i+1] - offset);
+    memory_process_segment(pc, syscall, addr + offset, segment, direction);
+  }
+}
+
 void memory_read_levelN(target_ulong pc, Syscall *syscall, target_ulong addr,
                         int size, target_ulong buffer) {
-  memory_process_access(pc, syscall, addr, size, buffer, DirectionIn);
+  std::string data(reinterpret_cast<char*>(&buffer), size);
+  memory_process_access(pc, syscall, addr, data, DirectionIn);
 }
 
 void memory_write(target_ulong pc, Syscall *syscall, target_ulong addr,
                   int size, target_ulong buffer) {
-  memory_process_access(pc, syscall, addr, size, buffer, DirectionOut);
+  std::string data(reinterpret_cast<char*>(&buffer), size);
+  memory_process_access(pc, syscall, addr, data, DirectionOut);
+}
+
+void memory_read_range(target_ulong pc, Syscall *syscall, target_ulong addr,
+                       const std::string &data) {
+  memory_process_access(pc, syscall, addr, data, DirectionIn);
+}
+
+void memory_write_range(target_ulong pc, Syscall *syscall, target_ulong addr,
+                        const std::string &data) {
+  memory_process_access(pc, syscall, addr, data, DirectionOut);
 }
@@ -5,6 +5,8 @@
 #ifndef SRC_QTRACE_TRACE_MEMORY_H_
 #define SRC_QTRACE_TRACE_MEMORY_H_
 
+#include <string>
+
 #include "qtrace/common.h"
 #include "qtrace/trace/syscall.h"
 
@@ -20,4 +22,13 @@ void memory_read_levelN(target_ulong pc, Syscall *syscall, target_ulong addr,
 void memory_write(target_ulong pc, Syscall *syscall, target_ulong addr,
                   int size, target_ulong buffer);
 
+// Process a bulk memory read from user-space (e.g., by a string instruction).
+// @data holds the whole range, starting at @addr
+void memory_read_range(target_ulong pc, Syscall *syscall, target_ulong addr,
+                       const std::string &data);
+
+// Process a bulk memory write from kernel to user-space
+void memory_write_range(target_ulong pc, Syscall *syscall, target_ulong addr,
+                        const std::string &data);
+
 #endif  // SRC_QTRACE_TRACE_MEMORY_H_
@@ -4,37 +4,56 @@
 
 #include "qtrace/trace/notify_syscall.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <cassert>
+#include <utility>
 
 #include "qtrace/common.h"
 #include "qtrace/context.h"
 #include "qtrace/logging.h"
+#include "qtrace/trace/events.h"
 #include "qtrace/trace/process.h"
 #include "qtrace/trace/syscall.h"
 #include "qtrace/trace/memory.h"
+#include "qtrace/trace/serialize.h"
+#include "qtrace/trace/stats.h"
 
-// Parameters for memory read operations. These are saved before the operation
-// is performed (qtrace_gate_memread_pre()), and used after the memory location
-// is accessed (qtrace_gate_memread_post()).
-static target_ulong gbl_memread_addr;
-static target_ulong gbl_memread_addr_hi;
-static target_ulong gbl_memread_pc;
-static int gbl_memread_size;
+bool qtrace_tracer_enabled = false;
 
 // True if a state change (ON/OFF) for the syscall tracer is currently
 // pending. The state change will be applied as soon a safe execution state is
 // reached
 static bool gbl_tracer_state_change = false;
 
+// Record a word-sized memory access of the current system call
+static inline void qtrace_dispatch_access(TraceEventType type,
+                                          Syscall *syscall, target_ulong pc,
+                                          target_ulong addr, int size,
+                                          target_ulong value) {
+  TraceEvent event = { type, size, syscall, pc, addr, value, NULL };
+  syscall->hooks++;
+  gbl_context.trace_manager->dispatchEvent(event);
+}
+
+// Record a range access of the current system call, taking ownership of @data
+static void qtrace_dispatch_range(TraceEventType type, Syscall *syscall,
+                                  target_ulong pc, target_ulong addr,
+                                  std::string data) {
+  TraceEvent event = { type, static_cast<int>(data.size()), syscall, pc, addr,
+                       0, new std::string(std::move(data)) };
+  syscall->hooks++;
+  gbl_context.trace_manager->dispatchEvent(event);
+}
+
 // Check if a size-byte memory access operation (read/write) should be
 // analyzed.
 static inline bool qtrace_should_process_memaccess(target_ulong cr3, int cpl,
                                                   int size) {
   // FIXME: Skip memory access operations larger than the host system's word
   // size.
-  if (sizeof(void *) < size) {
+  if (size > static_cast<int>(sizeof(void *))) {
     return false;
   }
 
@@ -54,14 +73,16 @@ static inline bool qtrace_should_process_memaccess(target_ulong cr3, int cpl,
   return true;
 }
 
-void notify_syscall_start(target_ulong cr3, target_ulong sysno,
-                          target_ulong stack) {
+enum SyscallStartResult notify_syscall_start(target_ulong cr3,
+                                             target_ulong sysno,
+                                             target_ulong stack) {
   if (!gbl_context.tracer_enabled) {
-    return;
+    return SyscallStartTraced;
   }
 
   RunningProcess running_process(cr3);
-  gbl_context.trace_manager->eventSyscallStart(running_process, sysno, stack);
+  return gbl_context.trace_manager->eventSyscallStart(running_process, sysno,
+                                                     stack);
 }
 
 void notify_syscall_end(target_ulong cr3, target_ulong retval) {
@@ -75,115 +96,451 @@ void notify_syscall_end(target_ulong cr3, target_ulong retval) {
     INFO("Switching tracer state, now %s",
          gbl_context.tracer_enabled ? "ON" : "OFF");
     gbl_tracer_state_change = false;
+
+    // Retranslate guest code, to emit or drop memory hooks. The translation
+    // block that is currently executing is not chained to others, as the end
+    // of a system call always terminates it
+    qtrace_tracer_enabled = gbl_context.tracer_enabled;
+    gbl_context.cb_tbflush();
   }
 }
 
-void notify_memread_post(target_ulong cr3, target_ulong pc, int cpl,
-                         target_ulong buffer, target_ulong buffer_hi,
-                         int size) {
+bool notify_memread_post(target_ulong cr3, target_ulong pc, int cpl,
+                         target_ulong addr, target_ulong buffer,
+                         target_ulong buffer_hi, int size) {
   if (!gbl_context.tracer_enabled) {
-    return;
+    return false;
   }
 
   if (!qtrace_should_process_memaccess(cr3, cpl, size)) {
-    return;
+    return false;
   }
 
-  // Sanity checks. The first assertion is false only for 64-bit memory
-  // accesses where the target host is a 32-bit system. This combination is
-  // currently unsupported.
-  assert(gbl_memread_addr_hi == 0 && buffer_hi == 0);
-  assert(pc == gbl_memread_pc && size == gbl_memread_size);
+  // Sanity check. The assertion is false only for 64-bit memory accesses
+  // where the target host is a 32-bit system. This combination is currently
+  // unsupported.
+  assert(buffer_hi == 0);
 
   // Analyze only kernel reads to user-space addresses
-  if (!gbl_context.windows->isUserAddress(gbl_memread_addr)) {
-    return;
+  if (!gbl_context.windows->isUserAddress(addr)) {
+    return false;
   }
 
+  HostTimer timer;
   RunningProcess running_process(cr3);
   Syscall *current_syscall =
     gbl_context.trace_manager->getSyscallForProcess(running_process);
 
+  // Another thread of this process may be the one inside a system call
+  if (!current_syscall) {
+    return false;
+  }
+  timer.charge(&current_syscall->host_time);
+
 #define ARGNO(a) ((((a) - current_syscall->stack) / sizeof(target_ulong)) - 2)
 
   // Start processing first-level arguments
-  if (gbl_memread_addr > current_syscall->stack &&
-      gbl_memread_addr <
-          (current_syscall->stack + sizeof(target_ulong) * MAX_SYSCALL_ARGS)) {
-    if (ARGNO(gbl_memread_addr) == 0 && current_syscall->missing_args < 0) {
+  if (addr > current_syscall->stack &&
+      addr < current_syscall->stack + sizeof(target_ulong) * MAX_SYSCALL_ARGS) {
+    if (ARGNO(addr) == 0 && current_syscall->missing_args < 0) {
       CpuRegisters regs;
       int err = gbl_context.cb_regs(&regs);
       assert(err == 0);
       current_syscall->missing_args = regs.ecx;
+      gbl_context.windows->setSyscallArgumentCount(current_syscall->sysno,
+                                                   regs.ecx);
     }
   }
 
   if (current_syscall->missing_args > 0) {
-    if (ARGNO(gbl_memread_addr) == 0 ||  // First argument?
-        (current_syscall->args.size() >
-             0 &&             // Do we already have other arguments?
-         gbl_memread_addr ==  // Is the current address equal to the address of
-                              // the next argument?
+    if (ARGNO(addr) == 0 ||  // First argument?
+        (current_syscall->args.size() > 0 &&  // Do we already have other
+                                              // arguments?
+         addr ==  // Is the current address equal to the address of the next
+                  // argument?
              current_syscall->args[current_syscall->args.size() - 1]->addr +
                  sizeof(target_ulong))) {
       assert(size == sizeof(target_ulong));
       TRACE("Copying first-level argument #%d (addr: %.8x, cr3: %.8x, "
             "data %.8x)",
-            ARGNO(gbl_memread_addr), gbl_memread_addr, cr3, buffer);
+            static_cast<int>(ARGNO(addr)), addr, cr3, buffer);
 
-      memory_read_level0(pc, current_syscall, gbl_memread_addr, size, buffer);
+      // Level-0 arguments are recorded synchronously, after all the accesses
+      // that preceded them
+      gbl_context.trace_manager->waitEvents(current_syscall);
+      memory_read_level0(pc, current_syscall, addr, size, buffer);
+      current_syscall->hooks++;
       current_syscall->missing_args--;
+      if (current_syscall->missing_args == 0) {
+        gbl_context.trace_manager->eventArgumentsComplete(current_syscall);
+      }
     }
   } else {
 // TODO(roberto): check this is a "candidate" address
 // DEBUG CODE
 #if 0
-    if ((gbl_memread_addr & 0xf0000000) != 0x80000000) {
+    if ((addr & 0xf0000000) != 0x80000000) {
       TRACE("Accessing upper-level argument (addr: %.8x, cr3: %.8x, eip: %.8x, "
             "data %.8x)",
-            gbl_memread_addr, cr3, pc, buffer);
+            addr, cr3, pc, buffer);
     }
 #endif
-    memory_read_levelN(pc, current_syscall, gbl_memread_addr, size, buffer);
+    // Level-0 arguments have already been recorded
+    if (current_syscall->isArgumentsBlock(addr, size)) {
+      return current_syscall->missing_args == 0;
+    }
+
+    qtrace_dispatch_access(EventMemRead, current_syscall, pc, addr, size,
+                           buffer);
   }
 
 #undef ARGNO
-}
 
-void notify_memread_pre(target_ulong pc, target_ulong addr,
-                        target_ulong addr_hi, int size) {
-  if (!gbl_context.tracer_enabled) {
-    return;
-  }
-
-  gbl_memread_addr = addr;
-  gbl_memread_addr_hi = addr_hi;
-  gbl_memread_size = size;
-  gbl_memread_pc = pc;
+  // Accesses can be buffered once all level-0 arguments have been read
+  return current_syscall->missing_args == 0;
 }
 
-void notify_memwrite_pre(target_ulong cr3, target_ulong pc, int cpl,
+bool notify_memwrite_pre(target_ulong cr3, target_ulong pc, int cpl,
                          target_ulong addr, target_ulong addr_hi,
                          target_ulong buffer, target_ulong buffer_hi,
                          int size) {
   if (!gbl_context.tracer_enabled) {
-    return;
+    return false;
   }
 
   if (!qtrace_should_process_memaccess(cr3, cpl, size)) {
-    return;
+    return false;
   }
 
   // Analyze only kernel reads to user-space addresses
   if (!gbl_context.windows->isUserAddress(addr)) {
+    return false;
+  }
+
+  HostTimer timer;
+  RunningProcess running_process(cr3);
+  Syscall *current_syscall =
+    gbl_context.trace_manager->getSyscallForProcess(running_process);
+  if (!current_syscall) {
+    return false;
+  }
+  timer.charge(&current_syscall->host_time);
+
+  qtrace_dispatch_access(EventMemWrite, current_syscall, pc, addr, size,
+                         buffer);
+  return current_syscall->missing_args == 0;
+}
+
+void notify_memaccess_batch(target_ulong cr3, target_ulong thread,
+                            const QTraceAccess *accesses, int count) {
+  if (!gbl_context.tracer_enabled) {
+    return;
+  }
+
+  if (!gbl_context.trace_manager->hasSyscallForProcess(cr3)) {
+    return;
+  }
+
+  // The system call is looked up once for the whole batch. The thread that
+  // performed the accesses may have been switched out already
+  HostTimer timer;
+  RunningProcess running_process(cr3, thread);
+  Syscall *current_syscall =
+    gbl_context.trace_manager->getSyscallForProcess(running_process);
+  if (!current_syscall) {
+    return;
+  }
+  timer.charge(&current_syscall->host_time);
+
+  Windows *windows = gbl_context.windows;
+
+  // Buffering is armed only once level-0 arguments have been read, as they
+  // need the live CPU state
+  if (current_syscall->missing_args != 0) {
     return;
   }
 
+  for (int i = 0; i < count; i++) {
+    const QTraceAccess &access = accesses[i];
+    int size = QTRACE_ACCESS_SIZE(access.info);
+
+    // Same checks as notify_memread_post() and notify_memwrite_pre()
+    if (QTRACE_ACCESS_CPL(access.info) != 0 ||
+        size > static_cast<int>(sizeof(void *)) ||
+        !windows->isUserAddress(access.addr)) {
+      continue;
+    }
+
+    if (QTRACE_ACCESS_KIND(access.info) == QTRACE_ACCESS_WRITE) {
+      qtrace_dispatch_access(EventMemWrite, current_syscall, access.pc,
+                             access.addr, size, access.value);
+    } else if (!current_syscall->isArgumentsBlock(access.addr, size)) {
+      qtrace_dispatch_access(EventMemRead, current_syscall, access.pc,
+                             access.addr, size, access.value);
+    }
+  }
+}
+
+bool notify_memaccess_batchable(target_ulong cr3) {
+  if (!gbl_context.tracer_enabled ||
+      !gbl_context.trace_manager->hasSyscallForProcess(cr3)) {
+    return false;
+  }
+
+  RunningProcess running_process(cr3);
+  Syscall *current_syscall =
+    gbl_context.trace_manager->getSyscallForProcess(running_process);
+  return current_syscall && current_syscall->missing_args == 0;
+}
+
+// Check if all the pages in the @len-byte range at @addr are mapped
+static bool qtrace_is_range_mapped(target_ulong addr, target_ulong len) {
+  target_ulong first = addr / GUEST_PAGE_SIZE;
+  target_ulong last = (addr + len - 1) / GUEST_PAGE_SIZE;
+  for (target_ulong page = first; page <= last; page++) {
+    if (gbl_context.cb_va2phy(page * GUEST_PAGE_SIZE) ==
+        static_cast<hwaddr>(-1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Capture a @len-byte copy from @src to @dst, reading the source buffer with a
+// single access. Returns false if the copy must be left to per-access hooks
+static bool qtrace_capture_copy(Syscall *syscall, target_ulong pc,
+                                target_ulong src, target_ulong dst,
+                                target_ulong len) {
+  // Copies of level-0 arguments (e.g., from the user stack to the kernel
+  // one) have already been recorded
+  bool src_user = gbl_context.windows->isUserAddress(src) &&
+    !syscall->isArgumentsBlock(src, len);
+  bool dst_user = gbl_context.windows->isUserAddress(dst);
+  if (!src_user && !dst_user) {
+    return true;
+  }
+
+  if (len > MAX_BULK_ACCESS_SIZE) {
+    return false;
+  }
+
+  // Faulting copies are left to per-access hooks, that only see the accesses
+  // that actually took place
+  if (dst_user && !qtrace_is_range_mapped(dst, len)) {
+    return false;
+  }
+
+  std::string data(len, '\0');
+  if (gbl_context.cb_peek(src, reinterpret_cast<unsigned char *>(&data[0]),
+                          len) != 0) {
+    return false;
+  }
+
+  if (src_user) {
+    qtrace_dispatch_range(EventReadRange, syscall, pc, src,
+                          dst_user ? data : std::move(data));
+  }
+
+  if (dst_user) {
+    qtrace_dispatch_range(EventWriteRange, syscall, pc, dst, std::move(data));
+  }
+
+  return true;
+}
+
+bool notify_string_op(target_ulong cr3, target_ulong pc, bool is_stos,
+                      target_ulong src, target_ulong dst, target_ulong len,
+                      target_ulong value, int size) {
+  if (!gbl_context.tracer_enabled) {
+    return false;
+  }
+
+  if (!gbl_context.trace_manager->hasSyscallForProcess(cr3)) {
+    // Per-element memory accesses would be ignored as well
+    return true;
+  }
+
+  HostTimer timer;
+  RunningProcess running_process(cr3);
+  Syscall *current_syscall =
+    gbl_context.trace_manager->getSyscallForProcess(running_process);
+  if (!current_syscall) {
+    return true;
+  }
+  timer.charge(&current_syscall->host_time);
+
+  // Level-0 arguments are copied from the user stack with string operations,
+  // and must be processed one element at a time
+  if (current_syscall->missing_args != 0) {
+    return false;
+  }
+
+  TRACE("String operation at pc %.8x: %.8x -> %.8x, %d bytes", pc,
+        is_stos ? 0 : src, dst, len);
+
+  if (!is_stos) {
+    return qtrace_capture_copy(current_syscall, pc, src, dst, len);
+  }
+
+  if (!gbl_context.windows->isUserAddress(dst)) {
+    return true;
+  }
+
+  if (!qtrace_is_range_mapped(dst, len)) {
+    return false;
+  }
+
+  std::string data(len, '\0');
+  for (target_ulong i = 0; i < len; i += size) {
+    memcpy(&data[i], &value, size);
+  }
+
+  qtrace_dispatch_range(EventWriteRange, current_syscall, pc, dst,
+                        std::move(data));
+  return true;
+}
+
+// Capture a call to RtlCopyUnicodeString(), copying the UNICODE_STRING at
+// @src to the one at @dst. Returns false if the call must be left to
+// per-access hooks
+static bool qtrace_capture_unicode_string(Syscall *syscall, target_ulong pc,
+                                          target_ulong dst, target_ulong src) {
+  Windows *windows = gbl_context.windows;
+  UnicodeStringHeader dststr, srcstr;
+
+  if (windows->readUnicodeString(dst, dststr) != 0) {
+    return false;
+  }
+
+  // A NULL source produces an empty string
+  target_ulong len = 0;
+  if (src != 0) {
+    if (windows->readUnicodeString(src, srcstr) != 0) {
+      return false;
+    }
+    len = std::min(srcstr.length, dststr.max_length);
+  }
+
+  // The string is NUL-terminated, if there is room for it
+  target_ulong termlen = len < dststr.max_length ? 2 : 0;
+
+  if (windows->isUserAddress(dst) &&
+      !qtrace_is_range_mapped(dst, sizeof(dststr))) {
+    return false;
+  }
+
+  if (windows->isUserAddress(dststr.buffer) &&
+      !qtrace_is_range_mapped(dststr.buffer, len + termlen)) {
+    return false;
+  }
+
+  // Headers are read first, then the buffer is copied and the destination
+  // length updated
+  if (windows->isUserAddress(dst)) {
+    qtrace_dispatch_range(EventReadRange, syscall, pc, dst, std::string(
+                              reinterpret_cast<const char *>(&dststr),
+                              sizeof(dststr)));
+  }
+
+  if (src != 0 && windows->isUserAddress(src)) {
+    qtrace_dispatch_range(EventReadRange, syscall, pc, src, std::string(
+                              reinterpret_cast<const char *>(&srcstr),
+                              sizeof(srcstr)));
+  }
+
+  if (len > 0 &&
+      !qtrace_capture_copy(syscall, pc, srcstr.buffer, dststr.buffer, len)) {
+    return false;
+  }
+
+  if (termlen > 0 && windows->isUserAddress(dststr.buffer)) {
+    qtrace_dispatch_range(EventWriteRange, syscall, pc, dststr.buffer + len,
+                          std::string(termlen, '\0'));
+  }
+
+  if (windows->isUserAddress(dst)) {
+    uint16_t length = len;
+    qtrace_dispatch_range(EventWriteRange, syscall, pc, dst, std::string(
+                              reinterpret_cast<const char *>(&length),
+                              sizeof(length)));
+  }
+
+  return true;
+}
+
+bool notify_is_copy_routine(target_ulong pc) {
+  return gbl_context.windows && gbl_context.windows->isCopyRoutine(pc);
+}
+
+bool notify_copy_routine(target_ulong cr3, target_ulong pc,
+                         target_ulong esp) {
+  if (!gbl_context.tracer_enabled) {
+    return false;
+  }
+
+  if (!gbl_context.trace_manager->hasSyscallForProcess(cr3)) {
+    // Memory accesses inside the routine would be ignored as well
+    return true;
+  }
+
+  HostTimer timer;
   RunningProcess running_process(cr3);
   Syscall *current_syscall =
     gbl_context.trace_manager->getSyscallForProcess(running_process);
+  if (!current_syscall) {
+    return true;
+  }
+  timer.charge(&current_syscall->host_time);
+
+  if (current_syscall->missing_args != 0) {
+    return false;
+  }
+
+  CopyRoutineCall call;
+  if (gbl_context.windows->getCopyRoutineCall(pc, esp, call) != 0) {
+    return false;
+  }
 
-  memory_write(pc, current_syscall, addr, size, buffer);
+  TRACE("Copy routine at pc %.8x: %.8x -> %.8x, %d bytes", pc, call.src,
+        call.dst, call.len);
+
+  switch (call.kind) {
+  case CopyRoutineMemory:
+    return qtrace_capture_copy(current_syscall, pc, call.src, call.dst,
+                               call.len);
+  case CopyRoutineProbeForRead:
+  case CopyRoutineProbeForWrite:
+    // Probes only touch the buffer, and carry no argument data. Later
+    // accesses by the caller are processed by memory hooks
+    return true;
+  case CopyRoutineUnicodeString:
+    return qtrace_capture_unicode_string(current_syscall, pc, call.dst,
+                                         call.src);
+  default:
+    assert(false);
+  }
+
+  return false;
+}
+
+bool notify_current_thread(target_ulong *thread, target_ulong *stack_limit,
+                           target_ulong *stack_size) {
+  Windows *windows = gbl_context.windows;
+  target_ulong limit, base;
+
+  if (!windows->isKernelReady() || windows->getCurrentThread(*thread) != 0 ||
+      *thread == 0 || windows->getThreadStack(*thread, limit, base) != 0 ||
+      base <= limit) {
+    return false;
+  }
+
+  *stack_limit = limit;
+  *stack_size = base - limit;
+  return true;
+}
+
+bool notify_cr3_write(target_ulong cr3) {
+  return gbl_context.trace_manager->isAddressSpaceTraced(cr3);
 }
 
 void notify_tracer_set_state(bool state) {
@@ -202,3 +559,45 @@ void notify_tracer_set_state(bool state) {
 bool notify_tracer_get_state(void) {
   return gbl_context.tracer_enabled;
 }
+
+bool notify_tracer_set_sampling(const char *spec) {
+  return gbl_context.trace_manager->setSamplingPolicy(spec);
+}
+
+void notify_tracer_get_sampling(const char **spec, uint64_t *sampled,
+                                uint64_t *skipped) {
+  const SamplingPolicy &policy =
+    gbl_context.trace_manager->getSamplingPolicy();
+  *spec = policy.getSpec().c_str();
+  *sampled = policy.getNumSampled();
+  *skipped = policy.getNumSkipped();
+}
+
+bool notify_tracer_get_output_filter(const char **expr, uint64_t *accepted,
+                                     uint64_t *rejected) {
+  return serialize_get_filter_stats(expr, accepted, rejected);
+}
+
+char *notify_tracer_get_stats(const char *syscall) {
+  const SyscallStats &stats = gbl_context.trace_manager->getStats();
+  StatsSyscallNamer namer = [](target_ulong sysno) {
+    return gbl_context.windows->getSyscallName(sysno);
+  };
+
+  std::string out;
+  if (!syscall) {
+    out = stats.formatSummary(namer);
+  } else {
+    int sysno = gbl_context.windows->getSyscallNumber(syscall);
+    if (sysno == -1) {
+      char *end;
+      sysno = strtoul(syscall, &end, 0);
+      if (*syscall == '\0' || *end != '\0') {
+        return NULL;
+      }
+    }
+    out = stats.formatSyscall(sysno, namer);
+  }
+
+  return strdup(out.c_str());
+}
@@ -10,26 +10,92 @@
 extern "C" {
 #endif
 
-  void notify_syscall_start(target_ulong cr3, target_ulong sysno,
-                            target_ulong stack);
+  // Outcome of notify_syscall_start()
+  enum SyscallStartResult {
+    SyscallStartTraced = 0,   // System call is traced
+    SyscallStartSkipped,      // System call is filtered out or not sampled
+    SyscallStartFiltered,     // Address space is filtered out
+  };
 
-  void notify_syscall_end(target_ulong cr3, target_ulong retval);
+  // Memory hooks can be disarmed until the system call returns if the result
+  // is SyscallStartSkipped (as long as the calling thread runs), and until
+  // the next CR3 switch if it is SyscallStartFiltered
+  enum SyscallStartResult notify_syscall_start(target_ulong cr3,
+                                               target_ulong sysno,
+                                               target_ulong stack);
 
-  void notify_memread_post(target_ulong cr3, target_ulong pc, int cpl,
-                           target_ulong buffer, target_ulong buffer_hi,
-                           int size);
+  void notify_syscall_end(target_ulong cr3, target_ulong retval);
 
-  void notify_memread_pre(target_ulong pc, target_ulong addr,
-                          target_ulong addr_hi, int size);
+  // Notify a @size-byte memory read at @addr, that returned @buffer. Returns
+  // true if the following memory accesses can be buffered and processed in
+  // batches, i.e., level-0 arguments have all been read
+  bool notify_memread_post(target_ulong cr3, target_ulong pc, int cpl,
+                           target_ulong addr, target_ulong buffer,
+                           target_ulong buffer_hi, int size);
 
-  void notify_memwrite_pre(target_ulong cr3, target_ulong pc, int cpl,
+  // Notify a memory write. Returns true if the following memory accesses can
+  // be buffered, as for notify_memread_post()
+  bool notify_memwrite_pre(target_ulong cr3, target_ulong pc, int cpl,
                            target_ulong addr, target_ulong addr_hi,
                            target_ulong buffer, target_ulong buffer_hi,
                            int size);
 
+  // Process @count memory accesses buffered while address space @cr3 was
+  // active, in execution order. Accesses were performed by the thread whose
+  // ETHREAD is @thread, or by the running one if @thread is 0
+  void notify_memaccess_batch(target_ulong cr3, target_ulong thread,
+                              const QTraceAccess *accesses, int count);
+
+  // Returns true if memory accesses in address space @cr3 can be buffered
+  bool notify_memaccess_batchable(target_ulong cr3);
+
+  // Notify a string operation (rep movs/stos) executed in ring 0, copying
+  // @len bytes from @src to @dst (@src is ignored for stos, that stores the
+  // @size-byte @value). Returns true if per-element memory hooks can be skipped
+  // until the operation completes
+  bool notify_string_op(target_ulong cr3, target_ulong pc, bool is_stos,
+                        target_ulong src, target_ulong dst, target_ulong len,
+                        target_ulong value, int size);
+
+  // Returns true if @pc is the entry point of a known kernel copy routine
+  bool notify_is_copy_routine(target_ulong pc);
+
+  // Notify a call to the copy routine at @pc, where @esp is the stack pointer
+  // at routine entry. Returns true if memory hooks can be skipped until the
+  // routine returns
+  bool notify_copy_routine(target_ulong cr3, target_ulong pc,
+                           target_ulong esp);
+
+  // Locate the thread running on the current vCPU: its ETHREAD and kernel
+  // stack (@stack_size bytes, starting at @stack_limit). Returns false if it
+  // cannot be located yet
+  bool notify_current_thread(target_ulong *thread, target_ulong *stack_limit,
+                             target_ulong *stack_size);
+
+  // Returns true if the address space @cr3, being loaded on the current vCPU,
+  // must be instrumented
+  bool notify_cr3_write(target_ulong cr3);
+
   void notify_tracer_set_state(bool state);
 
   bool notify_tracer_get_state(void);
+
+  // Set the sampling policy. Returns false if @spec is invalid
+  bool notify_tracer_set_sampling(const char *spec);
+
+  // Get the sampling policy and the number of sampled and skipped syscalls
+  void notify_tracer_get_sampling(const char **spec, uint64_t *sampled,
+                                  uint64_t *skipped);
+
+  // Get the output filter and the number of accepted and rejected syscalls.
+  // Returns false if no output filter is set
+  bool notify_tracer_get_output_filter(const char **expr, uint64_t *accepted,
+                                       uint64_t *rejected);
+
+  // Format per-syscall cost statistics: a summary of all system calls if
+  // @syscall is NULL, or the histograms of @syscall (a name or a number).
+  // Returns a malloc()'ed string, or NULL if @syscall is unknown
+  char *notify_tracer_get_stats(const char *syscall);
 #ifdef __cplusplus
 }
 #endif
@@ -9,7 +9,24 @@
 #include "qtrace/logging.h"
 
 RunningProcess::RunningProcess(target_ulong cr3)
-  : cr3_(cr3), initialized_(false) {
+  : cr3_(cr3), initialized_(false), thread_(0), thread_initialized_(false) {
+}
+
+RunningProcess::RunningProcess(target_ulong cr3, target_ulong thread)
+  : cr3_(cr3), initialized_(false), thread_(thread),
+    thread_initialized_(true) {
+}
+
+target_ulong RunningProcess::getThread() {
+  if (!thread_initialized_) {
+    if (!canInitialize() ||
+        gbl_context.windows->getCurrentThread(thread_) != 0) {
+      thread_ = 0;
+    }
+    thread_initialized_ = true;
+  }
+
+  return thread_;
 }
 
 bool RunningProcess::canInitialize() const {
@@ -27,7 +44,8 @@ void RunningProcess::init(void) {
   int r;
 
   name_ = std::unique_ptr<std::string>(new std::string());
-  r = gbl_context.windows->getProcessData(pid_, tid_, *(name_.get()));
+  r = gbl_context.windows->getProcessData(cr3_, pid_, tid_,
+                                          *(name_.get()));
   if (r != 0) {
     // FIXME: error handling
   }
@@ -24,6 +24,10 @@ class RunningProcess {
   // Flag to implement lazy initialization of expensive process fields
   bool initialized_;
 
+  // ETHREAD object of the running thread, initialized lazily as well
+  target_ulong thread_;
+  bool thread_initialized_;
+
   // Complete the initialization of the process object, if required
   void init();
 
@@ -32,6 +36,10 @@ class RunningProcess {
   // is the content of the CR3 register for the running process
   explicit RunningProcess(target_ulong cr3);
 
+  // Same as above, for a thread of the process that may not be running
+  // anymore, given its ETHREAD object (0 if unknown)
+  RunningProcess(target_ulong cr3, target_ulong thread);
+
   target_ulong getCr3() const { return cr3_; }
 
   // Check if we can perform "late" initialization of this object, i.e.,
@@ -42,6 +50,10 @@ class RunningProcess {
   // Check if OS-dependent initialization has already been performed
   inline bool isInitialized() const { return initialized_; }
 
+  // Get the address of the ETHREAD object of the thread running on the
+  // current vCPU, or 0 if it cannot be located yet. Cheaper than getTid()
+  target_ulong getThread();
+
   target_ulong getPid() { init(); return pid_; }
   target_ulong getTid() { init(); return tid_; }
   const std::string& getName() { init(); return *name_; }
@@ -0,0 +1,151 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+
+#include "qtrace/trace/sampling.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+SamplingPolicy::SamplingPolicy()
+  : every_(0), first_(0), rate_(0), burst_(0), per_process_(false),
+    spec_("off"), sampled_(0), skipped_(0) {
+}
+
+// Parse a non-negative number, rejecting trailing garbage
+static bool sampling_parse_number(const std::string &s, double &value) {
+  char *end;
+  value = strtod(s.c_str(), &end);
+  return !s.empty() && *end == '\0' && value >= 0;
+}
+
+bool SamplingPolicy::configure(const char *spec) {
+  unsigned int every = 0, first = 0;
+  double rate = 0, burst = 0;
+  bool per_process = false;
+
+  std::string s(spec ? spec : "");
+  if (!s.empty() && s != "off") {
+    std::stringstream ss(s);
+    std::string entry;
+    while (std::getline(ss, entry, ',')) {
+      size_t sep = entry.find('=');
+      if (sep == std::string::npos) {
+        return false;
+      }
+
+      std::string name = entry.substr(0, sep);
+      std::string value = entry.substr(sep + 1);
+      double number = 0;
+      if (name == "per") {
+        if (value == "process") {
+          per_process = true;
+        } else if (value == "syscall") {
+          per_process = false;
+        } else {
+          return false;
+        }
+        continue;
+      }
+
+      if (!sampling_parse_number(value, number)) {
+        return false;
+      }
+
+      if (name == "every") {
+        every = static_cast<unsigned int>(number);
+      } else if (name == "first") {
+        first = static_cast<unsigned int>(number);
+      } else if (name == "rate") {
+        rate = number;
+      } else if (name == "burst") {
+        burst = number;
+      } else {
+        return false;
+      }
+    }
+  }
+
+  every_ = every;
+  first_ = first;
+  rate_ = rate;
+  burst_ = burst > 0 ? burst : std::max(rate, 1.0);
+  per_process_ = per_process;
+  spec_ = isEnabled() ? s : "off";
+
+  // Start over with the new policy
+  calls_.clear();
+  buckets_.clear();
+  sampled_ = skipped_ = 0;
+  return true;
+}
+
+bool SamplingPolicy::sampleCount(target_ulong sysno) {
+  if (every_ == 0 && first_ == 0) {
+    return true;
+  }
+
+  if (calls_.size() >= MAX_SAMPLING_KEYS &&
+      calls_.find(sysno) == calls_.end()) {
+    calls_.clear();
+  }
+
+  uint64_t n = ++calls_[sysno];
+  if (n <= first_) {
+    return true;
+  }
+
+  if (every_ == 0) {
+    return false;
+  }
+
+  return (n - first_ - 1) % every_ == 0;
+}
+
+bool SamplingPolicy::sampleRate(target_ulong key, uint64_t now) {
+  if (rate_ <= 0) {
+    return true;
+  }
+
+  auto it = buckets_.find(key);
+  if (it == buckets_.end()) {
+    if (buckets_.size() >= MAX_SAMPLING_KEYS) {
+      buckets_.clear();
+    }
+
+    // New buckets start full
+    TokenBucket bucket = { burst_, now };
+    it = buckets_.insert(std::make_pair(key, bucket)).first;
+  }
+
+  // Refill the bucket according to the time elapsed since the last refill
+  TokenBucket &bucket = it->second;
+  if (now > bucket.last) {
+    bucket.tokens = std::min(burst_,
+                             bucket.tokens + (now - bucket.last) * rate_ / 1e6);
+    bucket.last = now;
+  }
+
+  if (bucket.tokens < 1) {
+    return false;
+  }
+
+  bucket.tokens -= 1;
+  return true;
+}
+
+bool SamplingPolicy::shouldSample(target_ulong sysno, target_ulong cr3,
+                                  uint64_t now) {
+  // Calls rejected by the count policy do not consume tokens
+  bool sampleme = sampleCount(sysno) &&
+    sampleRate(per_process_ ? cr3 : sysno, now);
+
+  if (sampleme) {
+    sampled_++;
+  } else {
+    skipped_++;
+  }
+
+  return sampleme;
+}
@@ -0,0 +1,95 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// This QTrace module implements sampling policies for the syscall tracer, used
+// to trace only a subset of the system calls that pass the syscall and process
+// filters. Policies are specified as a comma-separated list of NAME=VALUE
+// entries:
+//
+//   every=N      Trace one call every N, for each syscall number
+//   first=K      Always trace the first K calls of each syscall number. When
+//                combined with "every", sampling starts after the first K
+//                calls; otherwise, later calls are skipped
+//   rate=R       Trace at most R calls per second (token bucket)
+//   burst=B      Token bucket capacity (defaults to R, at least 1)
+//   per=KEY      Token bucket key, either "syscall" (default) or "process"
+//
+
+#ifndef SRC_QTRACE_TRACE_SAMPLING_H_
+#define SRC_QTRACE_TRACE_SAMPLING_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "qtrace/common.h"
+
+// Upper bound for the number of tracked syscall numbers and token buckets
+const unsigned int MAX_SAMPLING_KEYS = 4096;
+
+class SamplingPolicy {
+ private:
+  // Token bucket state
+  struct TokenBucket {
+    double tokens;
+    uint64_t last;        // Time of the last refill (microseconds)
+  };
+
+  // Policy parameters. Zero means disabled
+  unsigned int every_;
+  unsigned int first_;
+  double rate_;
+  double burst_;
+  bool per_process_;
+
+  // Policy specification, as configured
+  std::string spec_;
+
+  // Number of calls seen so far, for each syscall number
+  std::unordered_map<target_ulong, uint64_t> calls_;
+
+  // Token buckets, keyed by syscall number or by process CR3 value
+  std::unordered_map<target_ulong, TokenBucket> buckets_;
+
+  // Statistics
+  uint64_t sampled_;
+  uint64_t skipped_;
+
+  // Decision according to the "every" and "first" parameters
+  bool sampleCount(target_ulong sysno);
+
+  // Decision according to the token bucket for @key
+  bool sampleRate(target_ulong key, uint64_t now);
+
+ public:
+  SamplingPolicy();
+
+  // Set the policy from a specification string. NULL, an empty string or "off"
+  // disable sampling. Returns false if the specification is invalid, leaving
+  // the current policy unchanged
+  bool configure(const char *spec);
+
+  // Check if a sampling policy is active
+  bool isEnabled() const {
+    return every_ > 0 || first_ > 0 || rate_ > 0;
+  }
+
+  // Get the current policy specification ("off" if disabled)
+  const std::string &getSpec() const {
+    return spec_;
+  }
+
+  // Check if system call @sysno, issued in address space @cr3 at time @now
+  // (microseconds, monotonic), must be traced
+  bool shouldSample(target_ulong sysno, target_ulong cr3, uint64_t now);
+
+  uint64_t getNumSampled() const {
+    return sampled_;
+  }
+
+  uint64_t getNumSkipped() const {
+    return skipped_;
+  }
+};
+
+#endif  // SRC_QTRACE_TRACE_SAMPLING_H_
@@ -6,11 +6,20 @@
 
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <cstdio>
+#include <cstdlib>
 
 #include "qtrace/common.h"
 #include "qtrace/context.h"
+#include "qtrace/logging.h"
+#include "qtrace/trace/columns.h"
+#include "qtrace/trace/digest.h"
+#include "qtrace/trace/filter.h"
 #include "qtrace/trace/intervals.h"
 #include "qtrace/trace/syscall.h"
 #include "qtrace/pb/syscall.pb.h"
@@ -18,16 +27,85 @@
 // Output file stream for serialized system calls
 static std::unique_ptr<std::fstream> outstream;
 
+// Columnar summary of serialized system calls (optional)
+static std::unique_ptr<SummaryColumns> columns;
+
+// Predicate selecting the system calls to serialize (optional)
+static std::unique_ptr<OutputFilter> filter;
+
+// Process and thread tables for compact traces. Processes are identified by
+// their PID and name (to cope with PID reuse), threads by their process
+// reference and TID
+static std::map<std::pair<target_ulong, std::string>, unsigned int> processes;
+static std::map<std::pair<unsigned int, target_ulong>, unsigned int> threads;
+
+// Maximum number of payloads in the deduplication dictionary. When the limit
+// is reached, new payloads are serialized inline
+const size_t MAX_BLOB_DICTIONARY_ENTRIES = 256 * 1024;
+
+// Deduplication dictionary, mapping payload digests to their BlobRecord
+// reference. Payloads themselves are not kept
+static std::unordered_map<PayloadDigest, unsigned int, PayloadDigestHash>
+  blobs;
+
+// Write a length-prefixed message to the output stream
+static void serialize_write(const ::google::protobuf::Message &msg) {
+  unsigned int size = msg.ByteSize();
+  outstream.get()->write(reinterpret_cast<char *>(&size), sizeof(size));
+  msg.SerializeToOstream(outstream.get());
+}
+
+// Get the BlobRecord reference for @data, emitting the record upon the first
+// occurrence. Returns -1 if the payload cannot be added to the dictionary
+static int serialize_blob_ref(const std::string &data) {
+  PayloadDigest digest = digest_compute(data);
+  if (blobs.size() >= MAX_BLOB_DICTIONARY_ENTRIES) {
+    auto it = blobs.find(digest);
+    return it != blobs.end() ? it->second : -1;
+  }
+
+  // Look up and insert with a single hash table probe
+  unsigned int ref = blobs.size();
+  auto inserted = blobs.insert(std::make_pair(digest, ref));
+  if (!inserted.second) {
+    return inserted.first->second;
+  }
+
+  syscall::TraceRecord record;
+  syscall::BlobRecord *out_blob = record.mutable_blob();
+  out_blob->set_ref(ref);
+  out_blob->set_data(data);
+  serialize_write(record);
+
+  return ref;
+}
+
 static void serialize_interval(const DataInterval &di,
                                syscall::DataInterval *out_di) {
   out_di->set_offset(di.getLow());
-  out_di->set_data(di.getData());
   assert(di.getHigh() == di.getLow() + di.getData().length() - 1);
+
+  if (gbl_context.options.dedup_threshold > 0 &&
+      di.getLength() >= gbl_context.options.dedup_threshold) {
+    int ref = serialize_blob_ref(di.getData());
+    if (ref >= 0) {
+      out_di->set_blob(ref);
+      return;
+    }
+  }
+
+  out_di->set_data(di.getData());
 }
 
 static void serialize_argument(SyscallArg *arg,
                                syscall::SyscallArg *out_arg) {
-  out_arg->set_addr(arg->addr);
+  if (gbl_context.options.trace_compact && arg->parent) {
+    // Nested arguments are usually close to their parent
+    out_arg->set_addr_delta(static_cast<int64_t>(arg->addr) -
+                            static_cast<int64_t>(arg->parent->addr));
+  } else {
+    out_arg->set_addr(arg->addr);
+  }
 
   for (auto it = arg->indata.begin(); it != arg->indata.end(); it++) {
     syscall::DataInterval *di = out_arg->add_indata();
@@ -58,6 +136,10 @@ static void serialize_argument(SyscallArg *arg,
   out_arg->set_direction(direction);
   out_arg->set_offset(arg->offset);
 
+  if (arg->truncated) {
+    out_arg->set_truncated(true);
+  }
+
 #ifdef CONFIG_QTRACE_TAINT
   for (auto it = arg->taint_labels_in.begin();
        it != arg->taint_labels_in.end();
@@ -113,39 +195,192 @@ static void serialize_header() {
   header.set_hastaint(false);
 #endif
 
-  unsigned int header_size = header.ByteSize();
-  outstream.get()->write(reinterpret_cast<char *>(&header_size),
-                         sizeof(header_size));
-  header.SerializeToOstream(outstream.get());
+  if (gbl_context.options.trace_compact) {
+    // Embed syscall names, so readers do not need the profile tables
+    header.set_version(2);
+    for (unsigned int i = 0; i < gbl_context.windows->getNumSyscalls(); i++) {
+      header.add_sysname(gbl_context.windows->getSyscallName(i));
+    }
+  }
+
+  serialize_write(header);
+}
+
+// Get the reference of the thread that issued @syscall, emitting process and
+// thread records the first time they are seen
+static unsigned int serialize_thread_ref(const Syscall *syscall) {
+  auto process_key = std::make_pair(syscall->pid, syscall->name);
+  auto it_process = processes.find(process_key);
+  if (it_process == processes.end()) {
+    unsigned int ref = processes.size();
+    it_process = processes.insert(std::make_pair(process_key, ref)).first;
+
+    syscall::TraceRecord record;
+    syscall::ProcessRecord *out_process = record.mutable_process();
+    out_process->set_ref(ref);
+    out_process->set_pid(syscall->pid);
+    out_process->set_name(syscall->name);
+    serialize_write(record);
+  }
+
+  auto thread_key = std::make_pair(it_process->second, syscall->tid);
+  auto it_thread = threads.find(thread_key);
+  if (it_thread == threads.end()) {
+    unsigned int ref = threads.size();
+    it_thread = threads.insert(std::make_pair(thread_key, ref)).first;
+
+    syscall::TraceRecord record;
+    syscall::ThreadRecord *out_thread = record.mutable_thread();
+    out_thread->set_ref(ref);
+    out_thread->set_process(it_process->second);
+    out_thread->set_tid(syscall->tid);
+    serialize_write(record);
+  }
+
+  return it_thread->second;
+}
+
+// Accumulate data bytes and taint uses of an argument and its children
+static void serialize_filter_argument(const SyscallArg *arg,
+                                      unsigned int &bytes, bool &tainted) {
+  bytes += arg->indata.getDataSize() + arg->outdata.getDataSize();
+
+#ifdef CONFIG_QTRACE_TAINT
+  tainted = tainted || !arg->taint_labels_in.empty();
+#endif
+
+  for (auto it = arg->ptrs.begin(); it != arg->ptrs.end(); it++) {
+    serialize_filter_argument(*it, bytes, tainted);
+  }
+}
+
+// Evaluate the output filter on @syscall. Fields that are expensive to
+// compute are collected only if the filter uses them
+static bool serialize_filter_syscall(const Syscall *syscall) {
+  FilterRecord record;
+  record.sysno = syscall->sysno;
+  record.retval = syscall->retval;
+  record.process = &syscall->name;
+  record.nargs = syscall->args.size();
+  record.bytes = 0;
+  record.tainted = false;
+
+  if (filter->uses(FieldBytes) || filter->uses(FieldTainted)) {
+    for (auto it = syscall->args.begin(); it != syscall->args.end(); it++) {
+      serialize_filter_argument(*it, record.bytes, record.tainted);
+    }
+  }
+
+  return filter->accept(record);
+}
+
+bool serialize_get_filter_stats(const char **expr, uint64_t *accepted,
+                                uint64_t *rejected) {
+  if (!filter) {
+    return false;
+  }
+
+  *expr = filter->getExpression().c_str();
+  *accepted = filter->getNumAccepted();
+  *rejected = filter->getNumRejected();
+  return true;
 }
 
 int serialize_init(void) {
+  if (gbl_context.options.dedup_threshold > 0 &&
+      !gbl_context.options.trace_compact) {
+    // Blob records are available only in compact traces
+    INFO("Payload deduplication requires the compact trace format, "
+         "enabling it");
+    gbl_context.options.trace_compact = true;
+  }
+
   if (gbl_context.options.filename_trace) {
     outstream = std::unique_ptr<std::fstream>(
         new std::fstream(gbl_context.options.filename_trace,
                          std::ios::out | std::ios::trunc | std::ios::binary));
     serialize_header();
+
+    if (gbl_context.options.trace_columns) {
+      std::string dirname =
+        std::string(gbl_context.options.filename_trace) + ".cols";
+      columns = std::unique_ptr<SummaryColumns>(new SummaryColumns(dirname));
+      if (columns->open() != 0) {
+        return -1;
+      }
+    }
+
+    // Event queues are started later, so their atexit handlers replay pending
+    // system calls before this one runs
+    atexit(serialize_fini);
+  }
+
+  if (gbl_context.options.output_filter) {
+    std::string error;
+    filter = std::unique_ptr<OutputFilter>(new OutputFilter());
+    if (!filter->compile(gbl_context.options.output_filter,
+                         [](const std::string &name) {
+                           return gbl_context.windows->getSyscallNumber(name);
+                         }, error)) {
+      ERROR("Invalid output filter '%s': %s", gbl_context.options.output_filter,
+            error.c_str());
+      return -1;
+    }
   }
 
   return 0;
 }
 
+void serialize_fini(void) {
+  // Closing the sidecar writes its last, partial block
+  columns.reset();
+
+  if (outstream) {
+    outstream->flush();
+  }
+}
+
 void serialize_syscall(const Syscall *syscall) {
   if (!gbl_context.options.filename_trace) {
     // Serialization is disabled
     return;
   }
 
-  syscall::Syscall_Process out_process;
-  out_process.set_pid(syscall->pid);
-  out_process.set_tid(syscall->tid);
-  out_process.set_name(syscall->name);
+  // Rejected system calls are only counted
+  if (filter && !serialize_filter_syscall(syscall)) {
+    TRACE("Syscall #%d rejected by the output filter", syscall->id);
+    return;
+  }
 
-  syscall::Syscall out_syscall;
+  syscall::TraceRecord record;
+  syscall::Syscall &out_syscall = *record.mutable_syscall();
   out_syscall.set_id(syscall->id);
   out_syscall.set_sysno(syscall->sysno);
   out_syscall.set_retval(syscall->retval);
-  out_syscall.mutable_process()->CopyFrom(out_process);
+
+  if (syscall->cpu != 0) {
+    out_syscall.set_cpu(syscall->cpu);
+  }
+
+  out_syscall.set_start_time(syscall->start_time);
+  out_syscall.set_end_time(syscall->end_time);
+  if (syscall->start_icount >= 0 && syscall->end_icount >= 0) {
+    out_syscall.set_start_icount(syscall->start_icount);
+    out_syscall.set_end_icount(syscall->end_icount);
+  }
+
+  if (syscall->truncated) {
+    out_syscall.set_truncated(true);
+  }
+
+  if (gbl_context.options.trace_compact) {
+    out_syscall.set_thread(serialize_thread_ref(syscall));
+  } else {
+    syscall::Syscall_Process *out_process = out_syscall.mutable_process();
+    out_process->set_pid(syscall->pid);
+    out_process->set_tid(syscall->tid);
+    out_process->set_name(syscall->name);
+  }
 
   for (auto it = syscall->args.begin(); it != syscall->args.end(); it++) {
     syscall::SyscallArg *out_arg = out_syscall.add_arg();
@@ -162,8 +397,13 @@ void serialize_syscall(const Syscall *syscall) {
   out_syscall.set_taintlabel_retval(syscall->taint_label_retval);
 #endif
 
-  unsigned int syscall_size = out_syscall.ByteSize();
-  outstream.get()->write(reinterpret_cast<char *>(&syscall_size),
-                         sizeof(syscall_size));
-  out_syscall.SerializeToOstream(outstream.get());
+  if (gbl_context.options.trace_compact) {
+    serialize_write(record);
+  } else {
+    serialize_write(out_syscall);
+  }
+
+  if (columns) {
+    columns->add(syscall);
+  }
 }
@@ -8,6 +8,15 @@
 #include "qtrace/trace/syscall.h"
 
 int serialize_init(void);
+
+// Flush buffered output (e.g., the columnar summary) and close the trace.
+// Registered to run at process exit by serialize_init()
+void serialize_fini(void);
 void serialize_syscall(const Syscall *syscall);
 
+// Get the output filter expression and the number of system calls it accepted
+// and rejected. Returns false if no output filter is set
+bool serialize_get_filter_stats(const char **expr, uint64_t *accepted,
+                                uint64_t *rejected);
+
 #endif  // SRC_QTRACE_TRACE_SERIALIZE_H_
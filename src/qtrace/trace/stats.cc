@@ -0,0 +1,179 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+
+#include "qtrace/trace/stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+bool stats_host_time = false;
+
+Histogram::Histogram() : count_(0), sum_(0), min_(UINT64_MAX), max_(0) {
+  memset(buckets_, 0, sizeof(buckets_));
+}
+
+unsigned int Histogram::getBucket(uint64_t value) {
+  unsigned int bucket = 0;
+  while (value != 0) {
+    value >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void Histogram::add(uint64_t value) {
+  buckets_[getBucket(value)]++;
+  count_++;
+  sum_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+uint64_t Histogram::getPercentile(unsigned int p) const {
+  // Rank of the requested sample, rounded up
+  uint64_t rank = (count_ * p + 99) / 100;
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += buckets_[i];
+    if (seen >= rank && seen > 0) {
+      // Bucket i holds values up to 2^i - 1
+      uint64_t upper = i == 0 ? 0 : (i == 64 ? UINT64_MAX : (1ULL << i) - 1);
+      return std::min(upper, max_);
+    }
+  }
+  return max_;
+}
+
+void SyscallStats::add(target_ulong sysno, const SyscallCost &cost) {
+  Entry &entry = entries_[sysno];
+  entry.latency.add(cost.latency);
+  if (cost.instructions >= 0) {
+    entry.instructions.add(cost.instructions);
+  }
+  entry.host_time += cost.host_time;
+  entry.hooks += cost.hooks;
+  entry.bytes += cost.bytes;
+}
+
+uint64_t SyscallStats::getCount(target_ulong sysno) const {
+  auto it = entries_.find(sysno);
+  return it == entries_.end() ? 0 : it->second.latency.getCount();
+}
+
+// Get a printable name for system call @sysno
+static std::string stats_syscall_name(target_ulong sysno,
+                                      const StatsSyscallNamer &namer) {
+  const char *name = namer ? namer(sysno) : NULL;
+  return name ? name : "-";
+}
+
+std::string SyscallStats::formatSummary(const StatsSyscallNamer &namer) const {
+  std::vector<std::pair<target_ulong, const Entry *> > rows;
+  for (auto it = entries_.begin(); it != entries_.end(); it++) {
+    rows.push_back(std::make_pair(it->first, &it->second));
+  }
+
+  std::sort(rows.begin(), rows.end(),
+            [](const std::pair<target_ulong, const Entry *> &a,
+               const std::pair<target_ulong, const Entry *> &b) {
+              if (a.second->host_time != b.second->host_time) {
+                return a.second->host_time > b.second->host_time;
+              }
+              return a.second->latency.getSum() > b.second->latency.getSum();
+            });
+
+  char line[256];
+  snprintf(line, sizeof(line), "%-6s %-32s %10s %10s %10s %10s %10s %12s "
+           "%10s\n", "sysno", "name", "calls", "avg(us)", "p99(us)",
+           "avg insns", "hooks", "bytes", "qtrace(ms)");
+  std::string out(line);
+
+  for (auto it = rows.begin(); it != rows.end(); it++) {
+    const Entry &entry = *it->second;
+    const Histogram &latency = entry.latency;
+    std::string insns = "-";
+    if (entry.instructions.getCount() > 0) {
+      insns = std::to_string(entry.instructions.getMean());
+    }
+
+    snprintf(line, sizeof(line), "%-6u %-32.32s %10llu %10llu %10llu %10s "
+             "%10llu %12llu %10llu\n", static_cast<unsigned int>(it->first),
+             stats_syscall_name(it->first, namer).c_str(),
+             static_cast<unsigned long long>(latency.getCount()),
+             static_cast<unsigned long long>(latency.getMean() / 1000),
+             static_cast<unsigned long long>(latency.getPercentile(99) / 1000),
+             insns.c_str(),
+             static_cast<unsigned long long>(entry.hooks),
+             static_cast<unsigned long long>(entry.bytes),
+             static_cast<unsigned long long>(entry.host_time / 1000000));
+    out += line;
+  }
+
+  return out;
+}
+
+// Format the non-empty buckets of a histogram, one per line
+static void stats_format_histogram(std::string &out, const char *title,
+                                   const Histogram &histogram) {
+  char line[256];
+  snprintf(line, sizeof(line), "%s: count %llu, min %llu, mean %llu, "
+           "p50 %llu, p99 %llu, max %llu\n", title,
+           static_cast<unsigned long long>(histogram.getCount()),
+           static_cast<unsigned long long>(histogram.getMin()),
+           static_cast<unsigned long long>(histogram.getMean()),
+           static_cast<unsigned long long>(histogram.getPercentile(50)),
+           static_cast<unsigned long long>(histogram.getPercentile(99)),
+           static_cast<unsigned long long>(histogram.getMax()));
+  out += line;
+
+  uint64_t peak = 0;
+  for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    peak = std::max(peak, histogram.getBucketCount(i));
+  }
+
+  for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    uint64_t count = histogram.getBucketCount(i);
+    if (count == 0) {
+      continue;
+    }
+
+    uint64_t low = i == 0 ? 0 : 1ULL << (i - 1);
+    std::string bar(count * 40 / peak, '#');
+    snprintf(line, sizeof(line), "  >= %-20llu %10llu %s\n",
+             static_cast<unsigned long long>(low),
+             static_cast<unsigned long long>(count), bar.c_str());
+    out += line;
+  }
+}
+
+std::string SyscallStats::formatSyscall(target_ulong sysno,
+                                        const StatsSyscallNamer &namer) const {
+  char line[256];
+  snprintf(line, sizeof(line), "System call #%u (%s)\n",
+           static_cast<unsigned int>(sysno),
+           stats_syscall_name(sysno, namer).c_str());
+  std::string out(line);
+
+  auto it = entries_.find(sysno);
+  if (it == entries_.end()) {
+    out += "No completed calls\n";
+    return out;
+  }
+
+  const Entry &entry = it->second;
+  snprintf(line, sizeof(line), "hooks %llu, bytes %llu, qtrace time %llu us\n",
+           static_cast<unsigned long long>(entry.hooks),
+           static_cast<unsigned long long>(entry.bytes),
+           static_cast<unsigned long long>(entry.host_time / 1000));
+  out += line;
+
+  stats_format_histogram(out, "Latency (ns)", entry.latency);
+  if (entry.instructions.getCount() > 0) {
+    stats_format_histogram(out, "Guest instructions", entry.instructions);
+  }
+
+  return out;
+}
@@ -0,0 +1,140 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// This QTrace module aggregates the cost of completed system calls, for each
+// system call number: latency in the guest (host time and, with -icount,
+// guest instructions), memory hooks processed, data bytes captured and host
+// time spent inside QTrace. Latencies are kept in log2 histograms.
+//
+
+#ifndef SRC_QTRACE_TRACE_STATS_H_
+#define SRC_QTRACE_TRACE_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "qtrace/common.h"
+
+// Number of buckets of a histogram. Bucket 0 counts zero values, bucket i
+// values in [2^(i-1), 2^i)
+const unsigned int HISTOGRAM_BUCKETS = 65;
+
+// Read the host monotonic clock, in nanoseconds
+static inline uint64_t stats_clock_ns(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Histogram {
+ private:
+  uint64_t buckets_[HISTOGRAM_BUCKETS];
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_;
+  uint64_t max_;
+
+ public:
+  Histogram();
+
+  void add(uint64_t value);
+
+  // Get the bucket a value falls into
+  static unsigned int getBucket(uint64_t value);
+
+  uint64_t getBucketCount(unsigned int bucket) const {
+    return buckets_[bucket];
+  }
+
+  uint64_t getCount() const { return count_; }
+  uint64_t getSum() const { return sum_; }
+  uint64_t getMin() const { return count_ > 0 ? min_ : 0; }
+  uint64_t getMax() const { return max_; }
+
+  uint64_t getMean() const {
+    return count_ > 0 ? sum_ / count_ : 0;
+  }
+
+  // Upper bound of the @p-th percentile (0 < p <= 100), at the resolution of
+  // histogram buckets
+  uint64_t getPercentile(unsigned int p) const;
+};
+
+// Cost of a completed system call
+struct SyscallCost {
+  uint64_t latency;       // Host time between syscall start and end (ns)
+  int64_t instructions;   // Guest instructions executed, -1 if unknown
+  uint64_t host_time;     // Host time spent inside QTrace (ns)
+  unsigned int hooks;     // Memory accesses processed
+  unsigned int bytes;     // Data bytes captured
+};
+
+// Get the name of a system call, or NULL if unknown
+typedef std::function<const char *(target_ulong)> StatsSyscallNamer;
+
+class SyscallStats {
+ private:
+  struct Entry {
+    Histogram latency;
+    Histogram instructions;
+    uint64_t host_time;
+    uint64_t hooks;
+    uint64_t bytes;
+
+    Entry() : host_time(0), hooks(0), bytes(0) {}
+  };
+
+  std::unordered_map<target_ulong, Entry> entries_;
+
+ public:
+  // Account a completed system call
+  void add(target_ulong sysno, const SyscallCost &cost);
+
+  void reset() {
+    entries_.clear();
+  }
+
+  // Number of system calls accounted for @sysno
+  uint64_t getCount(target_ulong sysno) const;
+
+  // Format a table with one row per system call number, most expensive ones
+  // (in terms of QTrace host time, then of latency) first
+  std::string formatSummary(const StatsSyscallNamer &namer) const;
+
+  // Format the latency histograms of system call @sysno
+  std::string formatSyscall(target_ulong sysno,
+                            const StatsSyscallNamer &namer) const;
+};
+
+// Set to "true" to charge the host time spent inside QTrace to system calls.
+// Timing costs two clock reads in each hook, thus it is off by default
+extern bool stats_host_time;
+
+// Charge the host time elapsed between construction and destruction to a
+// counter, that can be chosen after construction. The clock is not read at
+// all unless stats_host_time is set
+class HostTimer {
+ private:
+  uint64_t start_;
+  uint64_t *counter_;
+
+ public:
+  HostTimer() : start_(stats_host_time ? stats_clock_ns() : 0),
+                counter_(NULL) {}
+
+  ~HostTimer() {
+    if (counter_) {
+      *counter_ += stats_clock_ns() - start_;
+    }
+  }
+
+  void charge(uint64_t *counter) {
+    if (start_ != 0) {
+      counter_ = counter;
+    }
+  }
+};
+
+#endif  // SRC_QTRACE_TRACE_STATS_H_
@@ -9,6 +9,7 @@
 
 #include <cstring>
 #include <cstdio>
+#include <climits>
 #include <cstdlib>
 #include <cassert>
 
@@ -22,8 +23,12 @@
 
 Syscall::Syscall(unsigned int param_id, target_ulong param_sysno,
                  target_ulong param_stack, target_ulong param_cr3) :
-  is_os_initialized(false), id(param_id), sysno(param_sysno),
-  stack(param_stack), cr3(param_cr3), missing_args(-1), is_active(false) {
+  is_os_initialized(false), num_candidates_(0), id(param_id),
+  sysno(param_sysno), stack(param_stack), cr3(param_cr3), thread(0), cpu(0),
+  missing_args(-1), is_active(false), captured_bytes(0), truncated(false),
+  last_event(0), start_time(0), end_time(0), start_icount(-1), end_icount(-1),
+  hooks(0), host_time(0) {
+  memset(&limits, 0, sizeof(limits));
 #ifdef CONFIG_QTRACE_TAINT
   // Initially associate an invalid taint label to the system call return
   // value. This is useful also in case taint-tracking is temporarily disabled
@@ -60,6 +65,18 @@ void Syscall::addCandidate(SyscallArg *arg, int offset) {
     return;
   }
 
+  // Enforce capture limits. Pointers are dropped here, rather than when they
+  // are actualized, so that every candidate can be made concrete. Candidates
+  // are counted since the system call started, as pending ones are actualized
+  // or removed as soon as the kernel accesses them
+  if ((limits.depth > 0 && arg->depth >= limits.depth) ||
+      (limits.candidates > 0 && num_candidates_ >= limits.candidates)) {
+    TRACE("Dropping candidate at %.8x, capture limits reached", addr);
+    arg->truncated = true;
+    truncated = true;
+    return;
+  }
+
   target_ulong value;
   int r = arg->indata.read(offset, sizeof(target_ulong),
                            reinterpret_cast<unsigned char*>(&value));
@@ -79,6 +96,7 @@ void Syscall::addCandidate(SyscallArg *arg, int offset) {
     ptr->offset = offset;
 
     candidates_.push_back(std::shared_ptr<SyscallPointer>(ptr));
+    num_candidates_++;
   }
 }
 
@@ -124,6 +142,7 @@ void Syscall::actualizeCandidate(target_ulong value, target_ulong data,
     newarg->offset = it->get()->offset;
     newarg->parent = arg;
     newarg->direction = direction;
+    newarg->depth = arg->depth + 1;
 
     if (datasize > 0) {
       // Add the current data interval to the input intervals set
@@ -142,6 +161,134 @@ void Syscall::actualizeCandidate(target_ulong value, target_ulong data,
   removeCandidate(value);
 }
 
+SyscallArg *Syscall::addLearnedArgument(SyscallArg *parent, int offset,
+                                        target_ulong addr,
+                                        unsigned int size) {
+  if (parent->hasPointer(parent->addr + offset)) {
+    return NULL;
+  }
+
+  if (limits.depth > 0 && parent->depth >= limits.depth) {
+    TRACE("Not pre-creating pointer at offset %d of arg @%.8x, capture "
+          "limits reached", offset, parent->addr);
+    parent->truncated = true;
+    truncated = true;
+    return NULL;
+  }
+
+  // Another learned pointer refers to the same data (e.g., an input and an
+  // output pointer to a single buffer). Accesses are matched to the first
+  // one, while this pointer is left to the usual inference
+  if (learned_args_.count(addr) > 0) {
+    TRACE("Not pre-creating pointer at offset %d of arg @%.8x, data @%.8x "
+          "is already learned", offset, parent->addr, addr);
+    return NULL;
+  }
+
+  SyscallArg *arg = new SyscallArg();
+  arg->addr = addr;
+  arg->offset = offset;
+  arg->parent = parent;
+  arg->direction = DirectionIn;
+  arg->speculative = true;
+  arg->learned_size = size;
+  arg->depth = parent->depth + 1;
+  parent->ptrs.push_back(arg);
+
+  learned_args_.insert(std::make_pair(addr, arg));
+
+  // The pointer no longer needs to be actualized
+  for (auto it = candidates_.begin(); it != candidates_.end();) {
+    if ((*it)->addr == addr && (*it)->parent == parent &&
+        (*it)->offset == offset) {
+      it = candidates_.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  return arg;
+}
+
+SyscallArg *Syscall::findLearnedArgument(target_ulong addr,
+                                         target_ulong len) const {
+  // Expected ranges may be nested (e.g., a buffer inside a larger structure),
+  // thus the nearest argument below @addr may not include the range while
+  // an enclosing one does. Walk down to find the innermost one
+  auto it = learned_args_.upper_bound(addr);
+  while (it != learned_args_.begin()) {
+    it--;
+    SyscallArg *arg = it->second;
+    if (addr + len <= arg->addr + arg->learned_size) {
+      return arg;
+    }
+  }
+
+  return NULL;
+}
+
+unsigned int Syscall::getCaptureAllowance(const SyscallArg *arg,
+                                          unsigned int offset,
+                                          unsigned int len,
+                                          SyscallDirection direction) const {
+  const DataIntervalSet &data =
+    direction == DirectionIn ? arg->indata : arg->outdata;
+
+  // Number of new bytes that can still be stored
+  unsigned int budget = UINT_MAX;
+  if (limits.arg_bytes > 0) {
+    unsigned int size = data.getDataSize();
+    budget = size < limits.arg_bytes ? limits.arg_bytes - size : 0;
+  }
+
+  if (limits.syscall_bytes > 0) {
+    budget = std::min(budget, captured_bytes < limits.syscall_bytes ?
+                      limits.syscall_bytes - captured_bytes : 0);
+  }
+
+  if (data.getMissingSize(offset, len) <= budget) {
+    return len;
+  }
+
+  // Find the longest prefix whose new bytes fit in the budget. The number of
+  // missing bytes grows with the prefix length, and fits for length "low"
+  unsigned int low = 0, high = len;
+  while (high - low > 1) {
+    unsigned int mid = low + (high - low) / 2;
+    if (data.getMissingSize(offset, mid) <= budget) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+// Delete the speculative children of @arg that have no accessed descendants
+static void syscall_prune_speculative(SyscallArg *arg) {
+  for (auto it = arg->ptrs.begin(); it != arg->ptrs.end();) {
+    syscall_prune_speculative(*it);
+    if ((*it)->speculative && (*it)->ptrs.empty()) {
+      delete *it;
+      it = arg->ptrs.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void Syscall::pruneLearnedArguments() {
+  if (learned_args_.empty()) {
+    return;
+  }
+
+  learned_args_.clear();
+  for (auto it = args.begin(); it != args.end(); it++) {
+    syscall_prune_speculative(*it);
+  }
+}
+
 SyscallPointer *Syscall::findCandidate(target_ulong value) const {
   for (auto it = candidates_.begin(); it != candidates_.end(); it++) {
     if ((*it)->addr == value) {
@@ -369,9 +516,10 @@ SyscallArg* Syscall::findClosestArgument(target_ulong targetaddr) {
     }
 
     // If we found a valid pointer inside a level-0 argument, we must create
-    // the corresponding SyscallArgument object by actualizing the candidate
-    if (candidate_parent != NULL) {
-      assert(hasCandidate(candidate_addr));
+    // the corresponding SyscallArgument object by actualizing the candidate.
+    // The candidate may be missing if it was dropped because of capture
+    // limits, or replaced by an argument pre-created from a learned layout
+    if (candidate_parent != NULL && hasCandidate(candidate_addr)) {
       actualizeCandidate(candidate_addr, 0, 0, DirectionIn);
       closest_arg = candidate_parent->findClosestPointer(targetaddr);
     }
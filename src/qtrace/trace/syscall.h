@@ -6,12 +6,14 @@
 #define SRC_QTRACE_TRACE_SYSCALL_H_
 
 #include <cstdbool>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
 #include "qtrace/common.h"
+#include "qtrace/options.h"
 #include "qtrace/trace/intervals.h"
 #include "qtrace/trace/process.h"
 
@@ -63,6 +65,13 @@ class ForeignPointer {
 // - nptrs:  number of pointer objects.
 // - parent: the parent SyscallArg object, or NULL for level-0 arguments.
 // - offset: offset of the pointer to this argument inside the parent.
+// - speculative: set to "true" for arguments pre-created from a learned
+//   layout, until they are accessed.
+// - learned_size: expected size of arguments pre-created from a learned
+//   layout.
+// - depth:  nesting depth (0 for level-0 arguments).
+// - truncated: set to "true" if data or pointers were dropped because of
+//   capture limits.
 
 typedef enum {
   DirectionIn = 0,
@@ -72,7 +81,9 @@ typedef enum {
 
 class SyscallArg {
  public:
-  explicit SyscallArg() : parent(NULL), offset(0) {}
+  explicit SyscallArg()
+    : parent(NULL), offset(0), speculative(false), learned_size(0), depth(0),
+      truncated(false) {}
   ~SyscallArg();
 
   target_ulong addr;
@@ -85,6 +96,12 @@ class SyscallArg {
   SyscallArg *parent;
   int offset;
 
+  bool speculative;
+  unsigned int learned_size;
+
+  unsigned int depth;
+  bool truncated;
+
   // Translate a SyscallDirection enum value to string
   static const char *directionToString(const SyscallDirection direction);
 
@@ -125,6 +142,16 @@ class SyscallArg {
 // - is_active: set to "true" if the system call is active.
 // - args:      system call arguments.
 // - candidates:  candidate data pointers.
+// - limits:    upper bounds on captured data.
+// - captured_bytes: data bytes stored so far, for all arguments and both
+//              directions.
+// - truncated: set to "true" if data or pointers were dropped because of
+//              capture limits.
+// - start_time, end_time: host monotonic clock (ns) at syscall start and end.
+// - start_icount, end_icount: guest instruction counter at syscall start and
+//              end, or -1 if instruction counting (-icount) is disabled.
+// - hooks:     memory accesses processed for this syscall.
+// - host_time: host time spent inside QTrace for this syscall (ns).
 //
 // The "candidates" field stores candidate data pointer, identified as part of
 // a specific system call argument. These pointers are just "candidates": we
@@ -152,6 +179,13 @@ class Syscall {
   // arguments)
   std::vector<std::shared_ptr<ForeignPointer> > foreign_candidates_;
 
+  // Arguments pre-created from a learned layout, indexed by address
+  std::map<target_ulong, SyscallArg *> learned_args_;
+
+  // Candidate data pointers added so far, including the ones that have been
+  // actualized or removed since
+  unsigned int num_candidates_;
+
  public:
   explicit Syscall(unsigned int param_id, target_ulong param_sysno,
                    target_ulong param_stack, target_ulong param_cr3);
@@ -195,6 +229,21 @@ class Syscall {
   // Find argument closest to the given data address
   SyscallArg *findClosestArgument(target_ulong addr);
 
+  // Pre-create the argument for the data pointer at offset @offset inside
+  // @parent, pointing to @addr. @size is the expected argument size. Returns
+  // NULL if the pointer is already known, if another pre-created argument is
+  // at @addr, or if @parent is at the depth limit (the system call is then
+  // flagged as truncated)
+  SyscallArg *addLearnedArgument(SyscallArg *parent, int offset,
+                                 target_ulong addr, unsigned int size);
+
+  // Find the innermost pre-created argument whose expected range includes the
+  // @len-byte range at @addr, or NULL
+  SyscallArg *findLearnedArgument(target_ulong addr, target_ulong len) const;
+
+  // Delete pre-created arguments that have never been accessed
+  void pruneLearnedArguments();
+
   // Check if @addr is a foreign data pointer
   bool hasForeignCandidate(target_ulong value) const {
     return findForeignCandidate(value) != NULL;
@@ -210,6 +259,20 @@ class Syscall {
   // Remove argument data pointers from foreign data pointers
   void cleanupForeignPointers();
 
+  // Address of the first level-0 argument on the user stack, past the return
+  // addresses of the syscall stubs
+  target_ulong getArgumentsAddress() const {
+    return stack + 2 * sizeof(target_ulong);
+  }
+
+  // Check if the @len-byte range at @addr lies within the level-0 arguments
+  // that have been read so far
+  bool isArgumentsBlock(target_ulong addr, target_ulong len) const {
+    target_ulong base = getArgumentsAddress();
+    return addr >= base &&
+      addr + len <= base + args.size() * sizeof(target_ulong);
+  }
+
   // Syscall arguments
   std::vector<SyscallArg *> args;
 
@@ -220,10 +283,41 @@ class Syscall {
   const target_ulong sysno;
   const target_ulong stack;
   const target_ulong cr3;
+
+  // ETHREAD object of the calling thread, or 0 if it was not known when the
+  // system call started
+  target_ulong thread;
+
+  // Index of the vCPU that issued the system call
+  int cpu;
+
   int missing_args;
   target_ulong retval;
   bool is_active;
 
+  CaptureLimits limits;
+  unsigned int captured_bytes;
+  bool truncated;
+
+  // Sequence number of the last event queued for this system call, when
+  // arguments are reconstructed asynchronously
+  uint64_t last_event;
+
+  uint64_t start_time;
+  uint64_t end_time;
+  int64_t start_icount;
+  int64_t end_icount;
+  unsigned int hooks;
+  uint64_t host_time;
+
+  // Get how many of the @len data bytes accessed at offset @offset of @arg, in
+  // direction @direction, can be stored according to capture limits. Only
+  // bytes not stored yet for that direction are charged, so that re-reading
+  // the same data is always allowed
+  unsigned int getCaptureAllowance(const SyscallArg *arg, unsigned int offset,
+                                   unsigned int len,
+                                   SyscallDirection direction) const;
+
   // OS-dependent attributes
   target_ulong pid;
   target_ulong tid;
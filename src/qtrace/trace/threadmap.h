@@ -0,0 +1,61 @@
+//
+// Copyright 2014, Roberto Paleari <roberto@greyhats.it>
+//
+// Objects of guest threads (e.g., their pending system call), keyed by address
+// space (CR3) and thread (ETHREAD). Mapped objects expose the ETHREAD of their
+// thread as the "thread" field, 0 if it is unknown.
+//
+
+#ifndef SRC_QTRACE_TRACE_THREADMAP_H_
+#define SRC_QTRACE_TRACE_THREADMAP_H_
+
+#include <unordered_map>
+#include <utility>
+
+#include "qtrace/common.h"
+
+template <typename T>
+class ThreadMap {
+ private:
+  // Threads of the same process, possibly running on different vCPUs, share
+  // the same key
+  typedef std::unordered_multimap<target_ulong, T*> Map;
+  Map map_;
+
+ public:
+  typedef typename Map::const_iterator const_iterator;
+
+  const_iterator end() const { return map_.end(); }
+  size_t size() const { return map_.size(); }
+
+  // Check if there is any object for address space @cr3
+  bool contains(target_ulong cr3) const { return map_.count(cr3) > 0; }
+
+  void insert(target_ulong cr3, T *object) {
+    map_.insert(std::make_pair(cr3, object));
+  }
+
+  void erase(const_iterator it) { map_.erase(it); }
+
+  // Find the object of @thread in address space @cr3. The ETHREAD may be
+  // unknown (0) early during boot, either when looking up or when the object
+  // was inserted: in these cases we fall back to matching the address space
+  // only, and an object with an unknown thread is bound to the first thread
+  // that finds it
+  const_iterator find(target_ulong cr3, target_ulong thread) const {
+    auto range = map_.equal_range(cr3);
+    for (auto it = range.first; it != range.second; it++) {
+      T *object = it->second;
+      if (object->thread == thread || object->thread == 0 || thread == 0) {
+        if (object->thread == 0) {
+          object->thread = thread;
+        }
+        return it;
+      }
+    }
+
+    return map_.end();
+  }
+};
+
+#endif  // SRC_QTRACE_TRACE_THREADMAP_H_
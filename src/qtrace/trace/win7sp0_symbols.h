@@ -14,6 +14,7 @@ const target_ulong OffsetCLIENTID_TID = 0x004;
 
 // EPROCESS
 const target_ulong OffsetEPROCESS_PCB             = 0x000;
+const target_ulong OffsetEPROCESS_CREATETIME      = 0x0a0;
 const target_ulong OffsetEPROCESS_UNIQUEPROCESSID = 0x0b4;
 const target_ulong OffsetEPROCESS_IMAGEFILENAME   = 0x16c;
 const target_ulong OffsetEPROCESS_IMAGEFILENAME_SZ = 16;
@@ -21,7 +22,16 @@ const target_ulong OffsetEPROCESS_IMAGEFILENAME_SZ = 16;
 // {E,K}THREAD
 const target_ulong OffsetETHREAD_TCB         = 0x000;  // KTHREAD
 const target_ulong OffsetETHREAD_CID         = 0x22c;  // CLIENT_ID
+const target_ulong OffsetKTHREAD_INITIALSTACK = 0x028;  // Stack base
+const target_ulong OffsetKTHREAD_STACKLIMIT  = 0x02c;
+const target_ulong OffsetKTHREAD_APCSTATEPROCESS = 0x050;  // Attached KPROCESS
 const target_ulong OffsetKTHREAD_PROCESS     = 0x150;  // KPROCESS
+const target_ulong OffsetKTHREAD_SERVICETABLE = 0x0bc;  // Service tables
+
+// KSERVICE_TABLE_DESCRIPTOR
+const target_ulong OffsetKSERVICE_TABLE_DESCRIPTOR_LIMIT  = 0x008;
+const target_ulong OffsetKSERVICE_TABLE_DESCRIPTOR_NUMBER = 0x00c; // Arg bytes
+const target_ulong SizeKSERVICE_TABLE_DESCRIPTOR          = 0x010;
 
 // KPCR/KPRCB
 const target_ulong OffsetKPCR_PRCBDATA       = 0x120;  // KPRCB
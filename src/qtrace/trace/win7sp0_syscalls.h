@@ -4928,3 +4928,170 @@ const char *syscalls_Windows7SP0[] = {
   "NtUserMagGetContextInformation",
   "NtUserHwndQueryRedirectionInfo",
 };
+
+// Perfect hash function for syscall names: the bucket of a name is
+// syscall_hash(name, 0) % 305, and its system call number is found at slot
+// syscall_hash(name, syscalls_Windows7SP0_hash_seeds[bucket]) % 1223
+const uint16_t syscalls_Windows7SP0_hash_seeds[] = {
+  28, 12, 62, 3, 60, 23, 4, 20, 53, 103,
+  235, 4, 33, 22, 2, 30, 10, 7, 115, 9,
+  1, 14, 8, 1, 5, 13, 4, 15, 27, 2,
+  1, 1, 9, 54, 358, 4, 5, 1, 171, 17,
+  171, 13, 43, 28, 3, 259, 17, 2, 1, 129,
+  93, 3, 42, 1, 7, 2, 2, 14, 1, 1,
+  901, 430, 46, 266, 31, 18, 28, 12, 70, 17,
+  18, 291, 0, 161, 300, 6, 401, 14, 397, 279,
+  3, 5, 118, 14, 86, 361, 1, 1, 4, 35,
+  462, 229, 90, 10, 0, 1, 38, 4, 273, 76,
+  2, 2, 361, 76, 30, 222, 3, 17, 7, 7,
+  7, 1, 8, 5, 145, 1, 234, 21, 3, 74,
+  75, 3, 1077, 4, 6, 14, 56, 8, 5, 7,
+  11, 17, 21, 14, 507, 36, 185, 16, 1, 2,
+  1, 2, 22, 100, 0, 286, 31, 68, 507, 29,
+  23, 3, 99, 32, 226, 31, 631, 444, 36, 68,
+  78, 1, 67, 281, 81, 19, 71, 206, 5, 98,
+  3, 2, 7, 294, 527, 20, 133, 2, 4, 557,
+  335, 229, 119, 458, 268, 29, 1, 114, 106, 98,
+  1, 7, 642, 1, 1001, 87, 147, 299, 102, 222,
+  1323, 331, 107, 394, 1, 4, 1, 280, 1181, 765,
+  3, 10, 32, 23, 20, 8, 348, 28, 68, 11,
+  38, 30, 3, 274, 303, 5, 95, 555, 7, 412,
+  24, 131, 9, 30, 1, 2915, 95, 172, 246, 486,
+  2, 0, 442, 331, 33, 32, 125, 1, 146, 39,
+  29, 181, 1063, 6, 708, 129, 465, 4, 160, 466,
+  311, 3, 1, 1660, 10, 0, 5, 1, 89, 4,
+  10, 5, 1970, 112, 187, 14, 307, 1, 501, 934,
+  3573, 412, 14, 51, 39, 1226, 18, 103, 113, 202,
+  1972, 28, 882, 317, 242, 3141, 9, 1522, 8, 23,
+  2659, 5, 43, 40, 1,
+};
+const uint16_t syscalls_Windows7SP0_hash_slots[] = {
+  4644, 390, 4158, 342, 4337, 4289, 4178, 4804, 4849, 235,
+  4288, 145, 4916, 4403, 238, 4368, 70, 4197, 396, 4650,
+  62, 83, 4252, 4637, 4188, 187, 4206, 149, 4565, 4286,
+  4, 4530, 329, 4883, 153, 4366, 4518, 4195, 4556, 20,
+  4456, 245, 255, 284, 158, 86, 4604, 4371, 4119, 4542,
+  4779, 326, 48, 4400, 4167, 4267, 80, 39, 4846, 4126,
+  4643, 4486, 4646, 82, 4535, 4717, 4747, 4435, 4763, 84,
+  4396, 4466, 219, 4793, 4789, 4260, 4450, 4382, 4558, 60,
+  4898, 4857, 4164, 4798, 4452, 4298, 4244, 4674, 248, 4214,
+  4782, 167, 4447, 272, 3, 4531, 4584, 4355, 4892, 4472,
+  4824, 4350, 4886, 34, 4189, 4160, 4803, 394, 4318, 4354,
+  4490, 4561, 368, 4365, 4385, 4173, 4537, 291, 4704, 203,
+  4395, 4515, 4320, 4547, 4760, 4423, 166, 338, 36, 4511,
+  37, 4681, 4127, 332, 65, 152, 4560, 347, 12, 4143,
+  4253, 4130, 4363, 4539, 2, 45, 4794, 4528, 4805, 4825,
+  4510, 4153, 4488, 4569, 4279, 4548, 4254, 4391, 4549, 4615,
+  4910, 4837, 4506, 4199, 4853, 4728, 4756, 4586, 4145, 228,
+  170, 4557, 4247, 4659, 4325, 4852, 4436, 163, 4899, 4559,
+  211, 4525, 4509, 4819, 4489, 188, 35, 4887, 4338, 4765,
+  4721, 4585, 4831, 4575, 383, 4291, 4134, 137, 4733, 346,
+  207, 4864, 4706, 107, 4693, 4757, 293, 239, 4620, 4568,
+  81, 4369, 4284, 96, 197, 4836, 4343, 314, 177, 156,
+  331, 4383, 4264, 4786, 224, 4412, 287, 4672, 4735, 4781,
+  121, 226, 4752, 4685, 201, 4455, 349, 354, 254, 4881,
+  206, 4317, 316, 4210, 4352, 4251, 4746, 365, 263, 4607,
+  4610, 4657, 4589, 4600, 392, 4208, 4891, 4231, 4386, 113,
+  4485, 246, 4912, 4166, 114, 4491, 181, 4618, 4829, 126,
+  360, 179, 4380, 4196, 4150, 76, 64, 364, 4151, 4439,
+  4230, 161, 4454, 4261, 4276, 4614, 4587, 168, 218, 9,
+  4316, 4621, 4141, 4329, 4596, 4666, 4302, 4179, 4344, 4808,
+  4715, 4897, 4628, 4300, 220, 4577, 4259, 150, 4807, 4668,
+  4865, 4844, 4667, 4555, 4445, 4146, 4863, 4443, 311, 4914,
+  4437, 4099, 4664, 4906, 4272, 4117, 4290, 98, 4563, 125,
+  4263, 101, 4517, 286, 4688, 4187, 230, 42, 4219, 4359,
+  4313, 119, 4900, 4280, 4207, 15, 4670, 4676, 309, 369,
+  4471, 169, 4896, 389, 0, 4833, 172, 373, 4867, 4529,
+  4684, 92, 4232, 4236, 4360, 4750, 4245, 4421, 91, 249,
+  212, 398, 4761, 4722, 4879, 4686, 4223, 264, 221, 4239,
+  93, 4295, 4453, 19, 4425, 205, 4376, 214, 110, 4799,
+  244, 4753, 4470, 4608, 4730, 4554, 4878, 6, 136, 28,
+  4129, 4507, 17, 4806, 4444, 371, 4745, 4175, 357, 4240,
+  4404, 267, 344, 4822, 306, 400, 4574, 4304, 4521, 367,
+  202, 4702, 4873, 68, 4495, 351, 4687, 353, 4417, 266,
+  4162, 4669, 4720, 243, 4438, 4594, 4393, 4246, 174, 4656,
+  253, 4315, 191, 4524, 4233, 4306, 4663, 4415, 298, 4599,
+  4662, 4498, 4581, 4212, 4726, 4457, 4348, 4487, 247, 27,
+  105, 106, 89, 4649, 4424, 160, 4426, 4203, 44, 4538,
+  4692, 241, 4830, 14, 276, 328, 317, 4616, 162, 4112,
+  4522, 4294, 104, 24, 4429, 4527, 4754, 4287, 4138, 4250,
+  4744, 4871, 4718, 196, 4602, 399, 4311, 4893, 4778, 322,
+  4626, 190, 4919, 4749, 4133, 4185, 223, 4727, 4102, 4816,
+  4633, 4147, 4820, 8, 51, 4332, 4523, 4411, 231, 10,
+  4645, 4770, 4480, 289, 4249, 4341, 4493, 4125, 340, 4532,
+  4482, 4502, 4139, 4719, 4738, 4697, 4895, 4742, 321, 4785,
+  4541, 305, 300, 4374, 4339, 128, 333, 4723, 4874, 4796,
+  336, 4204, 4121, 4850, 4323, 164, 4768, 290, 157, 4869,
+  210, 200, 7, 334, 189, 4413, 4762, 376, 4583, 30,
+  4124, 4606, 117, 4170, 4201, 271, 58, 258, 4148, 4823,
+  382, 4748, 4225, 4351, 135, 4775, 4624, 209, 4625, 312,
+  215, 343, 4578, 4292, 4567, 4665, 229, 352, 4123, 4855,
+  313, 4161, 4499, 4512, 4651, 307, 122, 148, 4660, 4229,
+  378, 4860, 4566, 4389, 123, 4474, 285, 4508, 4595, 341,
+  4100, 4845, 4536, 4221, 116, 379, 4771, 1, 4712, 4501,
+  361, 4870, 4711, 4705, 4834, 385, 4416, 4321, 4772, 256,
+  185, 139, 56, 97, 4172, 4271, 85, 4597, 4392, 4137,
+  138, 4590, 4888, 4235, 94, 4226, 4353, 324, 236, 4477,
+  115, 4277, 4349, 4679, 4725, 4422, 4409, 118, 4841, 4459,
+  146, 4630, 4358, 274, 4467, 4516, 4848, 4755, 377, 31,
+  57, 4109, 4478, 4101, 318, 4473, 297, 4211, 4268, 4420,
+  4113, 4336, 4364, 4181, 4174, 217, 4120, 109, 4114, 5,
+  4839, 4430, 4818, 4603, 100, 4347, 4709, 4828, 4165, 4340,
+  4655, 147, 4331, 43, 4194, 4479, 4475, 112, 47, 240,
+  4191, 4812, 16, 4484, 4200, 4419, 192, 4202, 4780, 4500,
+  4462, 78, 4108, 154, 4401, 193, 4724, 234, 232, 4885,
+  103, 4213, 95, 233, 4156, 4398, 4218, 61, 4882, 4262,
+  4835, 4504, 4641, 41, 204, 4334, 4159, 132, 4468, 133,
+  4408, 4256, 4448, 4238, 4570, 359, 4327, 278, 4776, 4880,
+  4817, 4861, 66, 4611, 4800, 198, 4671, 4694, 4876, 49,
+  323, 4463, 213, 4309, 99, 4661, 4234, 4217, 4777, 4097,
+  4333, 4612, 356, 301, 26, 4832, 4907, 11, 4673, 4627,
+  4579, 4815, 4142, 283, 4767, 141, 4859, 4322, 4695, 273,
+  303, 4330, 108, 348, 4410, 4743, 288, 4293, 275, 4813,
+  4434, 4795, 4257, 4427, 54, 4397, 4326, 4868, 4154, 4116,
+  4903, 4576, 4640, 262, 4623, 265, 4826, 143, 124, 4131,
+  227, 4346, 50, 4764, 261, 4118, 140, 4176, 71, 362,
+  25, 252, 4440, 4856, 79, 131, 4171, 4345, 4168, 4155,
+  4601, 251, 4390, 4588, 4476, 180, 4379, 384, 4362, 63,
+  4901, 4319, 4613, 4701, 345, 127, 184, 4402, 40, 102,
+  4582, 292, 4096, 77, 4791, 4909, 194, 4461, 387, 4335,
+  391, 199, 4593, 4716, 4224, 393, 4769, 4710, 4573, 4773,
+  4619, 144, 4884, 4296, 4432, 4737, 4414, 4696, 195, 4460,
+  4310, 4312, 175, 4157, 4550, 4451, 325, 4274, 259, 4481,
+  4545, 4222, 269, 4639, 4433, 4741, 4186, 4622, 4809, 4388,
+  134, 171, 4647, 38, 183, 4372, 4889, 4136, 4540, 4216,
+  4135, 370, 4503, 4273, 397, 4810, 327, 4689, 4394, 4373,
+  120, 4255, 4552, 335, 4248, 310, 4866, 4827, 4303, 315,
+  4546, 4193, 4700, 4442, 4305, 4275, 4375, 88, 4378, 237,
+  159, 4913, 4658, 355, 67, 4243, 4418, 129, 4297, 69,
+  4638, 277, 4497, 281, 308, 4209, 142, 4811, 4301, 4915,
+  4609, 4241, 363, 4105, 4431, 176, 4449, 4283, 72, 90,
+  4571, 4324, 4258, 4648, 4377, 4739, 319, 4505, 4132, 4729,
+  4544, 4802, 4553, 4858, 21, 375, 304, 4635, 299, 4840,
+  386, 4680, 4788, 4675, 165, 130, 282, 4740, 4266, 4441,
+  372, 4520, 4458, 4242, 4838, 4792, 4698, 4496, 4787, 4357,
+  4708, 4190, 4847, 4192, 4572, 4707, 4629, 4905, 4653, 395,
+  87, 4758, 4691, 4314, 4731, 222, 4270, 4367, 4533, 155,
+  173, 4205, 350, 4904, 4766, 294, 296, 4104, 4281, 4634,
+  208, 4908, 4285, 4918, 374, 4144, 4494, 4387, 4370, 151,
+  29, 4282, 280, 381, 4797, 4122, 111, 388, 73, 225,
+  4342, 4308, 4492, 4605, 216, 4278, 75, 32, 4677, 4464,
+  4564, 4683, 4591, 4682, 33, 257, 4399, 4182, 4784, 380,
+  4483, 4699, 4631, 320, 295, 4103, 4851, 337, 4169, 4384,
+  4407, 4184, 4592, 358, 74, 4801, 4149, 4307, 4751, 4632,
+  4465, 4519, 4177, 4215, 268, 4872, 4814, 4703, 4678, 4163,
+  4821, 52, 4140, 279, 4875, 4843, 4265, 4128, 4106, 302,
+  4361, 22, 270, 4513, 4152, 4617, 4842, 4790, 186, 53,
+  4543, 182, 4446, 4562, 4534, 330, 4690, 4198, 260, 4111,
+  4220, 13, 366, 4911, 4428, 4714, 4654, 55, 4180, 339,
+  4652, 4642, 23, 4551, 18, 4783, 4469, 178, 46, 4115,
+  4736, 250, 4227, 4713, 4759, 4110, 4514, 4228, 4098, 242,
+  4854, 4917, 4902, 4862, 4732, 4381, 4269, 4107, 4894, 4299,
+  4636, 4734, 59, 4526, 4877, 4328, 4356, 4598, 4890, 4580,
+  4774, 4183, 4237,
+};
+
+const SyscallHashTable syscalls_Windows7SP0_hash = {
+  syscalls_Windows7SP0_hash_seeds, 305,
+  syscalls_Windows7SP0_hash_slots, 1223,
+};
@@ -4,9 +4,13 @@
 
 #include "qtrace/trace/windows.h"
 
+#include <strings.h>
+
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <sstream>
 
 #include "qtrace/common.h"
 #include "qtrace/context.h"
@@ -28,21 +32,82 @@ int windows_init(Windows **windows_obj) {
     return -1;
   }
 
+  if (gbl_context.options.copy_routines &&
+      (*windows_obj)->addCopyRoutines(gbl_context.options.copy_routines) != 0) {
+    return -1;
+  }
+
   return 0;
 }
 
 target_ulong Windows::getKPCR(void) {
-  if (kpcr_ == 0) {
-    CpuRegisters regs;
-    int err = gbl_context.cb_regs(&regs);
-    assert(err == 0);
+  CpuRegisters regs;
+  int err = gbl_context.cb_regs(&regs);
+  assert(err == 0);
 
+  if (!hasKPCR(regs)) {
     // Ensure we are in kernel land, thus regs.fs_base points at the KPCR
     assert(!isUserAddress(regs.fs_base));
-    kpcr_ = regs.fs_base;
+    if (static_cast<unsigned int>(regs.cpu) >= kpcr_.size()) {
+      kpcr_.resize(regs.cpu + 1, 0);
+    }
+    kpcr_[regs.cpu] = regs.fs_base;
   }
 
-  return kpcr_;
+  return kpcr_[regs.cpu];
+}
+
+int Windows::getProcessData(target_ulong cr3, uint32_t &pid, uint32_t &tid,
+                            std::string &name) {
+  target_ulong ethread;
+  int r = getCurrentThread(ethread);
+  if (r != 0) {
+    return r;
+  }
+
+  auto it = threads_.find(ethread);
+  if (it != threads_.end() && it->second.cr3 == cr3) {
+    r = getThreadId(ethread, tid);
+    if (r != 0) {
+      return r;
+    }
+
+    if (tid == it->second.tid) {
+      pid = it->second.pid;
+      name = it->second.name;
+      return 0;
+    }
+  }
+
+  // Cache miss, or a stale entry: walk kernel objects
+  r = readProcessData(ethread, pid, tid, name);
+  if (r != 0) {
+    return r;
+  }
+
+  if (threads_.size() >= MAX_THREAD_CACHE_SIZE) {
+    TRACE("Process data cache is full, flushing");
+    flushProcessCache();
+  }
+
+  ThreadData &data = threads_[ethread];
+  data.cr3 = cr3;
+  data.pid = pid;
+  data.tid = tid;
+  data.name = name;
+
+  return 0;
+}
+
+int Windows::readGuest(target_ulong addr, void *buffer, int len) const {
+  void *host = gbl_context.cb_memmap(addr, len);
+  if (host) {
+    memcpy(buffer, host, len);
+    return 0;
+  }
+
+  return gbl_context.cb_peek(addr, reinterpret_cast<unsigned char *>(buffer),
+                             len);
 }
 
 bool Windows::isUserPointer(target_ulong buffer, int size) const {
@@ -57,49 +122,176 @@ bool Windows::isUserPointer(target_ulong buffer, int size) const {
   return true;
 }
 
-Windows::Windows(const char **names, unsigned int names_size)
-  : kpcr_(0) {
-  for (unsigned int i = 0; i < names_size; i++) {
-    syscall_names_.push_back(names[i]);
+// 32-bit FNV-1a hash of a syscall name. Must be kept in sync with fnvhash()
+// in tools/gensyscalls.py
+static inline uint32_t syscall_hash(const std::string &name, uint32_t seed) {
+  uint32_t h = 0x811c9dc5 ^ seed;
+  for (auto it = name.begin(); it != name.end(); it++) {
+    h ^= static_cast<unsigned char>(*it);
+    h *= 0x01000193;
   }
+  return h;
+}
+
+Windows::Windows(const char **names, unsigned int names_size,
+                 const SyscallHashTable &hash)
+  : syscall_names_(names), syscall_names_size_(names_size),
+    syscall_hash_(hash) {
 }
 
-// FIXME: this function is *not* reentrant, as it returns a pointer to a
-// statically allocated buffer
 const char *Windows::getSyscallName(target_ulong sysno) const {
-  static char name[64];
+  if (sysno >= syscall_names_size_) {
+    return "unknown";
+  }
 
-  if (sysno > syscall_names_.size()) {
-    snprintf(name, sizeof(name), "unknown%d", sysno);
-  } else {
-    strncpy(name, syscall_names_[sysno].c_str(), sizeof(name));
+  return syscall_names_[sysno];
+}
+
+int Windows::getSyscallNumber(const std::string &name) const {
+  uint32_t bucket = syscall_hash(name, 0) % syscall_hash_.seeds_size;
+  uint32_t slot = syscall_hash(name, syscall_hash_.seeds[bucket]) %
+    syscall_hash_.slots_size;
+  target_ulong sysno = syscall_hash_.slots[slot];
+
+  // The hash function is perfect only for known names: check for a match
+  if (sysno >= syscall_names_size_ || name != syscall_names_[sysno]) {
+    return -1;
   }
 
-  return name;
+  return sysno;
 }
 
-int Windows::getSyscallNumber(std::string name) const {
-  int r = -1, i = 0;
-  for (auto it = syscall_names_.begin();
-       it != syscall_names_.end();
-       i++, it++) {
-    if (*it == name) {
-      r = i;
-      break;
+int Windows::getSyscallArgumentCount(target_ulong sysno,
+                                     unsigned int &nargs) {
+  auto it = syscall_nargs_.find(sysno);
+  if (it != syscall_nargs_.end()) {
+    nargs = it->second;
+    return 0;
+  }
+
+  // Service tables are reached through the KPCR, that cannot be located at
+  // syscall entry (segment registers still hold user-space selectors)
+  CpuRegisters regs;
+  int err = gbl_context.cb_regs(&regs);
+  assert(err == 0);
+  if (!hasKPCR(regs)) {
+    return -1;
+  }
+
+  unsigned int bytes;
+  int r = readSyscallArgumentBytes(sysno, bytes);
+  if (r != 0) {
+    return r;
+  }
+
+  nargs = bytes / sizeof(target_ulong);
+  syscall_nargs_[sysno] = nargs;
+  return 0;
+}
+
+// Names of copy routines, as accepted by addCopyRoutines()
+static const struct {
+  const char *name;
+  CopyRoutineKind kind;
+} copy_routine_names[] = {
+  { "memcpy",               CopyRoutineMemory },
+  { "memmove",              CopyRoutineMemory },
+  { "RtlCopyMemory",        CopyRoutineMemory },
+  { "ProbeForRead",         CopyRoutineProbeForRead },
+  { "ProbeForWrite",        CopyRoutineProbeForWrite },
+  { "RtlCopyUnicodeString", CopyRoutineUnicodeString },
+};
+
+int Windows::addCopyRoutines(const char *spec) {
+  std::stringstream ss(spec);
+  std::string entry;
+  while (std::getline(ss, entry, ',')) {
+    size_t sep = entry.find('=');
+    if (sep == std::string::npos) {
+      ERROR("Invalid copy routine '%s', expected NAME=ADDRESS", entry.c_str());
+      return -1;
     }
+
+    std::string name = entry.substr(0, sep);
+    unsigned int i;
+    for (i = 0; i < sizeof(copy_routine_names)/sizeof(copy_routine_names[0]);
+         i++) {
+      if (strcasecmp(name.c_str(), copy_routine_names[i].name) == 0) {
+        break;
+      }
+    }
+
+    if (i == sizeof(copy_routine_names)/sizeof(copy_routine_names[0])) {
+      ERROR("Unknown copy routine '%s'", name.c_str());
+      return -1;
+    }
+
+    const char *addrstr = entry.c_str() + sep + 1;
+    char *end;
+    target_ulong addr = strtoul(addrstr, &end, 0);
+    if (*addrstr == '\0' || *end != '\0' || isUserAddress(addr)) {
+      ERROR("Invalid address for copy routine '%s'", name.c_str());
+      return -1;
+    }
+
+    copy_routines_[addr] = copy_routine_names[i].kind;
   }
-  return r;
+
+  return 0;
 }
 
-bool Windows::isKernelReady() const {
-  // Check if we already cached the address of the KPCB
-  if (kpcr_ != 0) {
-    return true;
+int Windows::getCopyRoutineCall(target_ulong pc, target_ulong esp,
+                                CopyRoutineCall &call) {
+  auto it = copy_routines_.find(pc);
+  if (it == copy_routines_.end()) {
+    return -1;
+  }
+
+  // At routine entry, stack arguments follow the return address
+  target_ulong args[3];
+  int r = readGuest(esp + sizeof(target_ulong), args, sizeof(args));
+  if (r != 0) {
+    return r;
+  }
+
+  call.kind = it->second;
+  switch (call.kind) {
+  case CopyRoutineMemory:
+    call.dst = args[0];
+    call.src = args[1];
+    call.len = args[2];
+    break;
+  case CopyRoutineProbeForRead:
+  case CopyRoutineProbeForWrite:
+    call.dst = 0;
+    call.src = args[0];
+    call.len = args[1];
+    break;
+  case CopyRoutineUnicodeString:
+    call.dst = args[0];
+    call.src = args[1];
+    call.len = 0;
+    break;
+  default:
+    assert(false);
   }
 
+  return 0;
+}
+
+int Windows::readUnicodeString(target_ulong addr, UnicodeStringHeader &str) {
+  return readGuest(addr, &str, sizeof(str));
+}
+
+bool Windows::isKernelReady() const {
   CpuRegisters regs;
   int err = gbl_context.cb_regs(&regs);
   assert(err == 0);
 
+  // Check if we already cached the address of the KPCR of this vCPU
+  if (hasKPCR(regs)) {
+    return true;
+  }
+
   return !isUserAddress(regs.fs_base);
 }
@@ -6,27 +6,129 @@
 #define SRC_QTRACE_TRACE_WINDOWS_H_
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "qtrace/common.h"
 
+// Upper bound for the number of threads in the process data cache
+const unsigned int MAX_THREAD_CACHE_SIZE = 4096;
+
+// Kernel routines that copy or probe whole buffers. Calls to these routines are
+// captured at entry, instead of one memory access at a time
+enum CopyRoutineKind {
+  CopyRoutineMemory = 0,        // memcpy/memmove/RtlCopyMemory(dst, src, len)
+  CopyRoutineProbeForRead,      // ProbeForRead(addr, len, alignment)
+  CopyRoutineProbeForWrite,     // ProbeForWrite(addr, len, alignment)
+  CopyRoutineUnicodeString,     // RtlCopyUnicodeString(dst, src)
+  CopyRoutineMax,
+};
+
+// Arguments of a call to a copy routine
+struct CopyRoutineCall {
+  CopyRoutineKind kind;
+  target_ulong dst;             // Destination buffer, or UNICODE_STRING
+  target_ulong src;             // Source (or probed) buffer, or UNICODE_STRING
+  target_ulong len;             // Buffer length (unused for Unicode strings)
+};
+
+// Header of a counted Unicode string (UNICODE_STRING)
+struct UnicodeStringHeader {
+  uint16_t length;
+  uint16_t max_length;
+  target_ulong buffer;
+};
+
+// Perfect hash function for syscall names, generated by gensyscalls.py
+struct SyscallHashTable {
+  const uint16_t *seeds;
+  unsigned int seeds_size;
+  const uint16_t *slots;
+  unsigned int slots_size;
+};
+
 class Windows {
  private:
-  std::vector<std::string> syscall_names_;
+  // System call names, indexed by syscall number
+  const char **syscall_names_;
+  unsigned int syscall_names_size_;
+  const SyscallHashTable &syscall_hash_;
+
+  // Process data associated with a kernel thread object
+  struct ThreadData {
+    target_ulong cr3;
+    uint32_t pid;
+    uint32_t tid;
+    std::string name;
+  };
+
+  // Cache of process data, keyed by the address of the ETHREAD object. Entries
+  // are validated against the current CR3 and TID, to detect ETHREAD objects
+  // that have been reused for another thread
+  std::unordered_map<target_ulong, ThreadData> threads_;
+
+  // Number of stack arguments of system calls, indexed by syscall number.
+  // Counts are read from the service tables, or learned at run-time
+  std::unordered_map<target_ulong, unsigned int> syscall_nargs_;
+
+  // Entry points of known copy routines
+  std::unordered_map<target_ulong, CopyRoutineKind> copy_routines_;
+
+  // Local caching for KPCR addresses, indexed by vCPU (each processor has its
+  // own KPCR). Zero for KPCRs that have not been located yet
+  std::vector<target_ulong> kpcr_;
+
+  // Check if the KPCR of the vCPU whose registers are @regs has been located
+  bool hasKPCR(const CpuRegisters &regs) const {
+    return static_cast<unsigned int>(regs.cpu) < kpcr_.size() &&
+      kpcr_[regs.cpu] != 0;
+  }
 
  protected:
-  // Local caching for the KPCR address. Note we assume we are emulating a
-  // single-processor machine, thus we have a *single* KPCR
-  target_ulong kpcr_;
+  // Get the KPCR of the current vCPU. Must be called in kernel land, the first
+  // time for each vCPU
   target_ulong getKPCR(void);
 
+  // Read @len bytes of guest memory at VA @addr. Reads within a single RAM
+  // page are served from a cached host mapping, instead of a page walk
+  int readGuest(target_ulong addr, void *buffer, int len) const;
+
+  // Get the TID of a thread
+  virtual int getThreadId(target_ulong ethread, uint32_t &tid) = 0;
+
+  // Read PID, TID and process name for a thread, walking kernel objects
+  virtual int readProcessData(target_ulong ethread, uint32_t &pid,
+                              uint32_t &tid, std::string &name) = 0;
+
+  // Read the size (in bytes) of the stack arguments of a system call from the
+  // service table of the running thread
+  virtual int readSyscallArgumentBytes(target_ulong sysno,
+                                       unsigned int &bytes) = 0;
+
  public:
-  explicit Windows(const char **names, unsigned int names_size);
-  ~Windows() {}
+  explicit Windows(const char **names, unsigned int names_size,
+                   const SyscallHashTable &hash);
+  virtual ~Windows() {}
 
   // Determine if a given VA is a user-space address
   virtual bool isUserAddress(target_ulong addr) const = 0;
 
+  // Get the address of the ETHREAD object for the thread running on the
+  // current vCPU
+  virtual int getCurrentThread(target_ulong &ethread) = 0;
+
+  // Get the address of the EPROCESS object whose address space is loaded on
+  // the current vCPU (i.e., the process the running thread is attached to),
+  // and its creation time. Unlike EPROCESS addresses and CR3 values, that are
+  // recycled, the pair identifies a process
+  virtual int getCurrentProcess(target_ulong &eprocess,
+                                uint64_t &create_time) = 0;
+
+  // Get the bounds of the kernel stack of a thread: the stack grows down from
+  // @base to @limit
+  virtual int getThreadStack(target_ulong ethread, target_ulong &limit,
+                             target_ulong &base) = 0;
+
   // Guess (remind it is just a guess!) if a size-byte memory buffer contains a
   // user-space pointer
   virtual bool isUserPointer(target_ulong buffer, int size) const;
@@ -34,12 +136,47 @@ class Windows {
   // Return the name of the system call with the given ID
   const char *getSyscallName(target_ulong sysno) const;
 
-  // Return the ID of a system call, given its name
-  int getSyscallNumber(std::string name) const;
+  // Return the ID of a system call, given its name, or -1 if the name is
+  // unknown
+  int getSyscallNumber(const std::string &name) const;
+
+  // Get the number of stack arguments of a system call. Returns 0 on success,
+  // or a non-zero value if the count is not known yet
+  int getSyscallArgumentCount(target_ulong sysno, unsigned int &nargs);
+
+  // Record the number of stack arguments of a system call
+  void setSyscallArgumentCount(target_ulong sysno, unsigned int nargs) {
+    syscall_nargs_[sysno] = nargs;
+  }
+
+  // Return the size of the system call names table
+  unsigned int getNumSyscalls() const { return syscall_names_size_; }
+
+  // Get basic information about the current process, whose page directory is
+  // @cr3: PID, TID and process name
+  int getProcessData(target_ulong cr3, uint32_t &pid, uint32_t &tid,
+                     std::string &name);
+
+  // Drop all cached process data
+  void flushProcessCache() { threads_.clear(); }
+
+  // Register copy routines from a comma-separated list of NAME=ADDRESS
+  // entries. Returns 0 on success, -1 on error
+  int addCopyRoutines(const char *spec);
+
+  // Check if @pc is the entry point of a known copy routine
+  bool isCopyRoutine(target_ulong pc) const {
+    return !copy_routines_.empty() &&
+      copy_routines_.find(pc) != copy_routines_.end();
+  }
+
+  // Get the arguments of a call to the copy routine at @pc, reading them from
+  // the stack at @esp. Must be invoked at routine entry
+  virtual int getCopyRoutineCall(target_ulong pc, target_ulong esp,
+                                 CopyRoutineCall &call);
 
-  // Get basic information about the current process: PID, TID and process name
-  virtual int getProcessData(uint32_t &pid, uint32_t &tid,
-                             std::string &name) = 0;
+  // Read the header of the UNICODE_STRING at @addr
+  virtual int readUnicodeString(target_ulong addr, UnicodeStringHeader &str);
 
   // Check if we are in a "sane" kernel execution environment (e.g., segment
   // registers have already been updated with ring-0 selectors)
@@ -13,7 +13,8 @@
 
 WindowsXPSP3::WindowsXPSP3() :
   Windows(syscalls_WindowsXPSP3,
-          sizeof(syscalls_WindowsXPSP3) / sizeof(char *)) {
+          sizeof(syscalls_WindowsXPSP3) / sizeof(char *),
+          syscalls_WindowsXPSP3_hash) {
 }
 
 bool WindowsXPSP3::isUserAddress(target_ulong addr) const {
@@ -27,44 +28,98 @@ bool WindowsXPSP3::isUserAddress(target_ulong addr) const {
 
 #define READADDR(name, addr)                                            \
   target_ulong name;                                                    \
-  r = gbl_context.cb_peek((addr), reinterpret_cast<unsigned char *>(&name),   \
-                    sizeof(name));                                      \
+  r = readGuest((addr), &name, sizeof(name));                           \
   if (r != 0) { return r; }
 
-int WindowsXPSP3::getProcessData(uint32_t &pid, uint32_t &tid,
-                                 std::string &name) {
+int WindowsXPSP3::getCurrentThread(target_ulong &ethread) {
   target_ulong kpcr = getKPCR();
+  return readGuest(kpcr + OffsetKPCR_PRCBDATA + OffsetKPRCB_CURRENTTHREAD,
+                   &ethread, sizeof(ethread));
+}
+
+int WindowsXPSP3::getCurrentProcess(target_ulong &eprocess,
+                                    uint64_t &create_time) {
+  target_ulong ethread;
+  int r = getCurrentThread(ethread);
+  CHECK(r);
+  r = readGuest(ethread + OffsetKTHREAD_APCSTATEPROCESS, &eprocess,
+                sizeof(eprocess));
+  CHECK(r);
+  return readGuest(eprocess + OffsetEPROCESS_CREATETIME, &create_time,
+                   sizeof(create_time));
+}
 
-  // Read the address of ETHREAD and EPROCESS kernel objects
+int WindowsXPSP3::getThreadStack(target_ulong ethread, target_ulong &limit,
+                                 target_ulong &base) {
+  int r = readGuest(ethread + OffsetKTHREAD_INITIALSTACK, &base, sizeof(base));
+  CHECK(r);
+  return readGuest(ethread + OffsetKTHREAD_STACKLIMIT, &limit, sizeof(limit));
+}
+
+int WindowsXPSP3::getThreadId(target_ulong ethread, uint32_t &tid) {
+  return readGuest(ethread + OffsetETHREAD_CID + OffsetCLIENTID_TID,
+                   &tid, sizeof(tid));
+}
+
+int WindowsXPSP3::readProcessData(target_ulong ethread, uint32_t &pid,
+                                  uint32_t &tid, std::string &name) {
+  // Read the address of the EPROCESS kernel object
   int r;
 
-  READADDR(ethread,
-           kpcr + OffsetKPCR_PRCBDATA + OffsetKPRCB_CURRENTTHREAD);
   READADDR(eprocess,
            ethread + OffsetETHREAD_THREADSPROCESS);
 
   // PID
-  r = gbl_context.cb_peek(ethread + OffsetETHREAD_CID + OffsetCLIENTID_PID,
-                    reinterpret_cast<unsigned char *>(&pid), sizeof(pid));
+  r = readGuest(ethread + OffsetETHREAD_CID + OffsetCLIENTID_PID,
+                &pid, sizeof(pid));
   CHECK(r);
 
   // TID
-  r = gbl_context.cb_peek(ethread + OffsetETHREAD_CID + OffsetCLIENTID_TID,
-                    reinterpret_cast<unsigned char *>(&tid), sizeof(tid));
+  r = getThreadId(ethread, tid);
   CHECK(r);
 
   // Process name
-  std::unique_ptr<char> imagename
+  std::unique_ptr<char[]> imagename
     (new char[OffsetEPROCESS_IMAGEFILENAME_SZ + 1]);
 
-  r = gbl_context.cb_peek(eprocess + OffsetEPROCESS_IMAGEFILENAME,
-                    reinterpret_cast<unsigned char *>(imagename.get()),
-                    OffsetEPROCESS_IMAGEFILENAME_SZ);
+  r = readGuest(eprocess + OffsetEPROCESS_IMAGEFILENAME, imagename.get(),
+                OffsetEPROCESS_IMAGEFILENAME_SZ);
   CHECK(r);
+  imagename[OffsetEPROCESS_IMAGEFILENAME_SZ] = '\0';
 
   name = std::string(const_cast<const char*>(imagename.get()));
   return 0;
 }
 
+int WindowsXPSP3::readSyscallArgumentBytes(target_ulong sysno,
+                                           unsigned int &bytes) {
+  target_ulong ethread;
+  int r = getCurrentThread(ethread);
+  CHECK(r);
+
+  READADDR(servicetable,
+           ethread + OffsetKTHREAD_SERVICETABLE);
+
+  // Bit 12 of the syscall number selects the service table (ntoskrnl or
+  // win32k), while lower bits index the table itself
+  target_ulong descriptor = servicetable +
+    ((sysno >> 12) & 1) * SizeKSERVICE_TABLE_DESCRIPTOR;
+  target_ulong index = sysno & 0xfff;
+
+  READADDR(limit, descriptor + OffsetKSERVICE_TABLE_DESCRIPTOR_LIMIT);
+  if (index >= limit) {
+    return -1;
+  }
+
+  READADDR(argtable, descriptor + OffsetKSERVICE_TABLE_DESCRIPTOR_NUMBER);
+
+  uint8_t argbytes;
+  r = readGuest(argtable + index, &argbytes, sizeof(argbytes));
+  CHECK(r);
+
+  bytes = argbytes;
+  return 0;
+}
+
 #undef CHECK
 #undef READADDR
@@ -15,9 +15,18 @@ class WindowsXPSP3 : public Windows {
   explicit WindowsXPSP3();
   ~WindowsXPSP3() {}
 
-  virtual int getProcessData(uint32_t &pid, uint32_t &tid,
-                             std::string &name);
   virtual bool isUserAddress(target_ulong addr) const;
+
+ protected:
+  virtual int getCurrentThread(target_ulong &ethread);
+  virtual int getCurrentProcess(target_ulong &eprocess, uint64_t &create_time);
+  virtual int getThreadStack(target_ulong ethread, target_ulong &limit,
+                             target_ulong &base);
+  virtual int getThreadId(target_ulong ethread, uint32_t &tid);
+  virtual int readProcessData(target_ulong ethread, uint32_t &pid,
+                              uint32_t &tid, std::string &name);
+  virtual int readSyscallArgumentBytes(target_ulong sysno,
+                                       unsigned int &bytes);
 };
 
 #endif  // SRC_QTRACE_TRACE_WINXPSP3_H_
@@ -14,6 +14,7 @@ const target_ulong OffsetCLIENTID_TID = 0x004;
 
 // EPROCESS
 const target_ulong OffsetEPROCESS_PCB             = 0x000;
+const target_ulong OffsetEPROCESS_CREATETIME      = 0x070;
 const target_ulong OffsetEPROCESS_UNIQUEPROCESSID = 0x084;
 const target_ulong OffsetEPROCESS_IMAGEFILENAME   = 0x174;
 const target_ulong OffsetEPROCESS_IMAGEFILENAME_SZ = 16;
@@ -21,6 +22,15 @@ const target_ulong OffsetEPROCESS_IMAGEFILENAME_SZ = 16;
 // {E,K}THREAD
 const target_ulong OffsetETHREAD_CID            = 0x1ec; // CLIENT_ID
 const target_ulong OffsetETHREAD_THREADSPROCESS = 0x220; // EPROCESS
+const target_ulong OffsetKTHREAD_INITIALSTACK   = 0x018; // Stack base
+const target_ulong OffsetKTHREAD_STACKLIMIT     = 0x01c;
+const target_ulong OffsetKTHREAD_APCSTATEPROCESS = 0x044; // Attached EPROCESS
+const target_ulong OffsetKTHREAD_SERVICETABLE   = 0x0e0; // Service tables
+
+// KSERVICE_TABLE_DESCRIPTOR
+const target_ulong OffsetKSERVICE_TABLE_DESCRIPTOR_LIMIT  = 0x008;
+const target_ulong OffsetKSERVICE_TABLE_DESCRIPTOR_NUMBER = 0x00c; // Arg bytes
+const target_ulong SizeKSERVICE_TABLE_DESCRIPTOR          = 0x010;
 
 // KPCR/KPRCB
 const target_ulong OffsetKPCR_PRCBDATA       = 0x120;  // KPRCB
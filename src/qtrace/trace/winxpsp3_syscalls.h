@@ -4770,3 +4770,135 @@ const char *syscalls_WindowsXPSP3[] = {
   "NtGdiBRUSHOBJ_DeleteRbrush",
   "NtGdiUnmapMemFont",
 };
+
+// Perfect hash function for syscall names: the bucket of a name is
+// syscall_hash(name, 0) % 235, and its system call number is found at slot
+// syscall_hash(name, syscalls_WindowsXPSP3_hash_seeds[bucket]) % 941
+const uint16_t syscalls_WindowsXPSP3_hash_seeds[] = {
+  50, 71, 21, 20, 234, 63, 1, 223, 87, 12,
+  79, 273, 3, 18, 146, 8, 26, 53, 4, 2,
+  25, 2, 1, 48, 74, 101, 1, 65, 2, 1,
+  6, 9, 13, 11, 2, 3, 12, 44, 37, 16,
+  4, 118, 2, 24, 98, 6, 90, 4, 1, 130,
+  1, 288, 1, 60, 12, 3, 13, 285, 27, 12,
+  2, 17, 629, 20, 126, 3, 30, 222, 93, 13,
+  2, 10, 21, 139, 299, 42, 34, 136, 25, 59,
+  41, 8, 1, 5, 33, 467, 135, 6, 301, 56,
+  27, 1, 7, 48, 19, 6, 360, 25, 17, 10,
+  90, 5, 48, 39, 50, 25, 32, 20, 3, 33,
+  4, 52, 5, 1, 1, 193, 1, 168, 3, 214,
+  2, 29, 56, 23, 102, 4, 3, 8, 134, 22,
+  247, 24, 26, 223, 4, 5, 301, 269, 179, 70,
+  49, 12, 283, 173, 23, 276, 28, 151, 2, 251,
+  398, 147, 21, 158, 603, 4, 9, 48, 497, 36,
+  910, 206, 29, 9, 37, 289, 18, 63, 115, 5,
+  6, 59, 2306, 655, 318, 64, 1, 114, 309, 1247,
+  96, 383, 6, 4, 1487, 221, 185, 775, 133, 4,
+  163, 39, 787, 11, 10, 2, 136, 15, 517, 42,
+  756, 96, 16, 36, 456, 15, 10, 890, 12, 58,
+  927, 133, 47, 168, 348, 39, 9, 1769, 92, 57,
+  90, 193, 6, 10, 295, 321, 12, 27, 1, 1639,
+  40, 1, 477, 330, 1504,
+};
+const uint16_t syscalls_WindowsXPSP3_hash_slots[] = {
+  4595, 128, 4364, 4512, 96, 250, 4404, 4284, 4422, 4695,
+  4326, 4640, 4643, 4110, 4208, 4097, 4329, 92, 241, 4540,
+  4472, 263, 4760, 4176, 4248, 4287, 4684, 4457, 4527, 207,
+  4416, 4686, 4205, 4245, 4738, 4295, 4453, 4536, 4524, 4685,
+  4141, 15, 121, 4521, 81, 4351, 3, 244, 4616, 4310,
+  179, 4718, 4614, 4701, 4582, 4585, 4600, 4332, 208, 4296,
+  204, 4550, 119, 182, 4387, 4599, 4579, 4725, 283, 4499,
+  196, 4420, 4486, 4353, 270, 4703, 4362, 4139, 4707, 4647,
+  52, 127, 115, 4402, 4365, 79, 4696, 39, 260, 161,
+  147, 268, 4638, 4690, 4708, 4199, 4449, 4581, 275, 4465,
+  4300, 145, 217, 4736, 4413, 4699, 271, 206, 245, 4270,
+  4335, 84, 139, 4115, 4, 100, 4197, 4474, 4658, 4103,
+  4203, 4233, 4498, 4634, 4163, 4137, 4154, 4507, 4559, 4504,
+  4232, 4546, 4382, 4525, 4644, 4372, 4749, 4240, 4179, 4473,
+  194, 4434, 4542, 272, 4424, 168, 4204, 40, 4697, 4379,
+  4274, 234, 102, 4106, 124, 4726, 231, 4484, 4177, 152,
+  4314, 4156, 32, 174, 170, 4111, 4480, 4294, 90, 4175,
+  4534, 4201, 4409, 75, 35, 251, 4720, 4153, 219, 4630,
+  4492, 4397, 4116, 4242, 130, 4732, 4674, 4159, 4239, 4458,
+  4587, 4417, 4590, 4206, 4761, 4224, 4122, 4202, 4142, 46,
+  197, 4528, 181, 4225, 4636, 69, 4728, 4452, 225, 4127,
+  62, 280, 4596, 200, 4445, 4608, 74, 4438, 4165, 51,
+  4336, 4354, 4661, 4307, 4357, 4565, 4433, 4341, 4475, 213,
+  4592, 4571, 243, 4222, 4345, 4666, 4757, 111, 106, 4743,
+  53, 4610, 237, 4209, 4545, 4323, 148, 77, 4447, 4172,
+  4241, 4298, 4390, 253, 159, 4292, 221, 4255, 156, 4256,
+  4322, 171, 4687, 4651, 4105, 4395, 4123, 122, 262, 4380,
+  4316, 235, 4646, 158, 4481, 4609, 4118, 4562, 4576, 4754,
+  279, 256, 4510, 4689, 4554, 4289, 4628, 274, 4680, 4750,
+  4180, 4306, 4662, 47, 24, 4181, 4373, 4190, 4552, 34,
+  4589, 4363, 4192, 4399, 4104, 4755, 4518, 227, 48, 4489,
+  4694, 4375, 26, 113, 4297, 4259, 65, 4155, 4532, 4119,
+  4632, 193, 103, 4739, 56, 4411, 27, 11, 4564, 4325,
+  255, 4288, 4577, 4441, 78, 258, 4733, 4344, 4553, 4523,
+  4388, 4476, 104, 88, 164, 4214, 4146, 4319, 4659, 80,
+  198, 4617, 17, 86, 4249, 261, 4663, 186, 4407, 108,
+  125, 4334, 4188, 4557, 4650, 4162, 131, 209, 4096, 20,
+  8, 4668, 4236, 273, 4710, 42, 254, 4660, 1, 4535,
+  4451, 267, 4408, 4541, 4309, 4735, 4170, 4586, 4126, 4343,
+  4185, 4511, 199, 4709, 4195, 4597, 4751, 4716, 4238, 4247,
+  4744, 4466, 4428, 4551, 4485, 4315, 4578, 4267, 257, 4330,
+  23, 4211, 143, 4182, 249, 4260, 4299, 4500, 4340, 4455,
+  4715, 265, 4275, 4383, 4200, 185, 68, 166, 4243, 4283,
+  4569, 4626, 4281, 4669, 177, 4729, 4143, 175, 4426, 224,
+  4603, 149, 4655, 4665, 4693, 4677, 4415, 4377, 4520, 4444,
+  4178, 4193, 4622, 4470, 89, 120, 36, 252, 4543, 4145,
+  4337, 4217, 4251, 4712, 4191, 4418, 191, 4253, 4602, 4318,
+  167, 4683, 169, 4539, 4574, 4570, 4724, 4544, 4368, 4376,
+  157, 4705, 14, 4352, 242, 137, 6, 21, 240, 4160,
+  4229, 4218, 4654, 4641, 276, 4252, 4421, 4113, 4469, 205,
+  4173, 4346, 91, 4171, 4692, 112, 266, 4456, 4721, 67,
+  4604, 4459, 4212, 129, 45, 4358, 4519, 4673, 43, 4264,
+  184, 259, 4514, 4653, 4125, 4261, 4752, 4356, 4478, 4425,
+  117, 4493, 4144, 4637, 264, 99, 33, 4575, 4348, 173,
+  238, 4290, 4235, 4134, 4342, 4723, 4558, 4263, 4151, 4501,
+  4333, 4262, 4384, 4548, 4271, 4753, 142, 138, 4099, 4497,
+  236, 4681, 4158, 4401, 4583, 4448, 187, 282, 4400, 4740,
+  58, 4623, 101, 13, 4152, 4405, 4440, 4756, 4406, 7,
+  4210, 60, 4359, 4394, 4737, 4100, 4468, 82, 4467, 4164,
+  31, 28, 150, 4503, 4605, 4606, 4198, 4228, 190, 4277,
+  4526, 12, 4109, 4462, 4517, 4389, 4112, 4713, 4591, 4746,
+  246, 4509, 4207, 188, 29, 4734, 4223, 4393, 94, 4187,
+  172, 97, 4573, 10, 278, 4133, 4482, 4556, 192, 4568,
+  214, 4430, 135, 4561, 4505, 4282, 4331, 4117, 4742, 4272,
+  4435, 41, 247, 4304, 4706, 4291, 230, 4385, 4494, 4439,
+  281, 63, 4410, 4672, 4730, 4490, 4704, 4186, 277, 4161,
+  4624, 66, 4555, 4633, 4495, 4477, 4642, 59, 4645, 107,
+  4234, 202, 4130, 50, 4254, 4174, 4258, 4667, 144, 203,
+  4268, 4612, 4148, 183, 4676, 4414, 180, 151, 160, 4621,
+  4278, 4361, 4168, 269, 4580, 4194, 72, 83, 223, 4135,
+  4301, 4664, 4136, 4216, 4378, 2, 4147, 4167, 4311, 4601,
+  4273, 25, 4717, 4607, 4759, 54, 4305, 4227, 4120, 4237,
+  126, 4748, 4128, 4652, 49, 4656, 4678, 4506, 4537, 4700,
+  4226, 132, 64, 4312, 153, 22, 136, 4670, 4461, 110,
+  222, 4246, 4423, 4450, 4538, 4619, 4391, 71, 4308, 4483,
+  4324, 4102, 4698, 4338, 4446, 4516, 4496, 4366, 4488, 4367,
+  4369, 4183, 4157, 4302, 4355, 4347, 118, 73, 4244, 4560,
+  4098, 4747, 189, 55, 4487, 218, 4138, 4427, 4437, 4502,
+  4679, 4196, 4613, 4169, 4588, 4702, 4349, 4131, 4431, 4221,
+  4515, 215, 4429, 4491, 4250, 4132, 4279, 4594, 105, 4184,
+  4166, 4566, 5, 4285, 93, 4454, 4257, 4215, 4682, 4648,
+  4508, 4584, 4615, 4121, 4303, 220, 95, 163, 4266, 16,
+  4276, 4529, 19, 4219, 4213, 114, 4572, 146, 210, 4649,
+  4745, 4360, 44, 85, 4220, 57, 229, 4108, 4149, 4530,
+  4741, 4140, 216, 4129, 4392, 4731, 37, 4114, 4513, 123,
+  4639, 98, 232, 4317, 4531, 4443, 4327, 4432, 4419, 4231,
+  4230, 134, 233, 4370, 4293, 4563, 4350, 4625, 4758, 0,
+  4533, 4722, 4727, 4598, 4675, 116, 4371, 4657, 4618, 4547,
+  4412, 4620, 4460, 4269, 4671, 4189, 4464, 4719, 4442, 248,
+  228, 4124, 4714, 4471, 18, 133, 4522, 176, 38, 4265,
+  4688, 4691, 4629, 4567, 4313, 4627, 4286, 4635, 30, 4320,
+  4321, 201, 4631, 154, 4611, 4593, 9, 178, 195, 4280,
+  4549, 4436, 4381, 4107, 76, 165, 4398, 4150, 4101, 4479,
+  162, 226, 4463, 4711, 4403, 87, 4339, 4386, 4374, 155,
+  4328,
+};
+
+const SyscallHashTable syscalls_WindowsXPSP3_hash = {
+  syscalls_WindowsXPSP3_hash_seeds, 235,
+  syscalls_WindowsXPSP3_hash_slots, 941,
+};
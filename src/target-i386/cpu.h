@@ -834,6 +834,40 @@ typedef struct CPUX86State {
     uint8_t nmi_injected;
     uint8_t nmi_pending;
 
+#ifdef CONFIG_QTRACE_SYSCALL
+    /* Non-zero when QTrace syscall and memory hooks must be skipped, i.e.,
+       the current address space is filtered out or a string operation has
+       already been captured (QTRACE_FILTERED_* flags). Cleared on reset */
+    uint32_t qtrace_filtered;
+
+    /* Stack pointer at the entry of the kernel copy routine being executed,
+       or zero. Memory hooks are skipped until the routine returns, i.e., the
+       stack pointer moves above this value or more than a kernel stack
+       below it */
+    target_ulong qtrace_copy_esp;
+
+    /* Next free record of the memory access buffer, and end of its usable
+       part. Translated code appends accesses while qtrace_access_ptr is
+       below qtrace_access_end, and calls the QTrace gate otherwise; setting
+       both to the same value disarms buffering. Cleared on reset */
+    QTraceAccess *qtrace_access_ptr;
+    QTraceAccess *qtrace_access_end;
+
+    /* Address of the memory read in progress, saved by translated code
+       before the TLB lookup */
+    target_ulong qtrace_memread_addr;
+
+    /* ETHREAD of the guest thread owning the hook state above (skipped
+       string operation or system call, copy routine, buffered accesses), or
+       zero, and its kernel stack (qtrace_stack_size bytes starting at
+       qtrace_stack_limit). Translated code skips hooks and buffers accesses
+       only while the stack pointer is within the stack of the owner; hook
+       state is flushed and cleared once another thread runs */
+    target_ulong qtrace_thread;
+    target_ulong qtrace_stack_limit;
+    target_ulong qtrace_stack_size;
+#endif
+
     CPU_COMMON
 
     uint64_t pat;
@@ -887,6 +921,11 @@ typedef struct CPUX86State {
     uint64_t xcr0;
 
     TPRAccess tpr_access_type;
+
+#ifdef CONFIG_QTRACE_SYSCALL
+    /* Memory access buffer, allocated when buffering is first armed */
+    QTraceAccess *qtrace_access_buf;
+#endif
 } CPUX86State;
 
 #include "cpu-qom.h"
@@ -219,4 +219,10 @@ DEF_HELPER_3(rclq, tl, env, tl, tl)
 DEF_HELPER_3(rcrq, tl, env, tl, tl)
 #endif
 
+#ifdef CONFIG_QTRACE_SYSCALL
+DEF_HELPER_5(qtrace_string_start, void, env, tl, tl, i32, i32)
+DEF_HELPER_1(qtrace_string_end, void, env)
+DEF_HELPER_2(qtrace_copy_routine, void, env, tl)
+#endif
+
 #include "exec/def-helper.h"
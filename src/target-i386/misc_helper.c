@@ -623,3 +623,21 @@ void helper_debug(CPUX86State *env)
     env->exception_index = EXCP_DEBUG;
     cpu_loop_exit(env);
 }
+
+#ifdef CONFIG_QTRACE_SYSCALL
+void helper_qtrace_string_start(CPUX86State *env, target_ulong src,
+                                target_ulong dst, uint32_t op, uint32_t ot)
+{
+    qtrace_gate_string_start(env, src, dst, op, ot);
+}
+
+void helper_qtrace_string_end(CPUX86State *env)
+{
+    qtrace_gate_string_end(env);
+}
+
+void helper_qtrace_copy_routine(CPUX86State *env, target_ulong pc)
+{
+    qtrace_gate_copy_routine(env, pc);
+}
+#endif
@@ -1203,6 +1203,10 @@ static void do_interrupt_all(X86CPU *cpu, int intno, int is_int,
             count++;
         }
     }
+#ifdef CONFIG_QTRACE_SYSCALL
+    /* Re-arm memory hooks, in case a string operation was interrupted */
+    qtrace_gate_string_end(env);
+#endif
     if (env->cr[0] & CR0_PE_MASK) {
 #if !defined(CONFIG_USER_ONLY)
         if (env->hflags & HF_SVMI_MASK) {
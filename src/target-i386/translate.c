@@ -1403,8 +1403,59 @@ static inline void gen_repz_ ## op(DisasContext *s, int ot,                   \
     gen_jmp(s, cur_eip);                                                      \
 }
 
+#ifdef CONFIG_QTRACE_SYSCALL
+/* Notify QTrace about a string operation, passing the linear addresses of
+   the current source and destination elements */
+static void gen_qtrace_string_start(DisasContext *s, int op, int ot,
+                                    target_ulong cur_eip)
+{
+    TCGv src = tcg_temp_new();
+
+    gen_jmp_im(cur_eip);
+    gen_string_movl_A0_ESI(s);
+    tcg_gen_mov_tl(src, cpu_A0);
+    gen_string_movl_A0_EDI(s);
+    gen_helper_qtrace_string_start(cpu_env, src, cpu_A0,
+                                   tcg_const_i32(op), tcg_const_i32(ot));
+    tcg_temp_free(src);
+}
+
+/* Same as GEN_REPZ, but ring-0 string operations are notified to QTrace at
+   each iteration, and when the loop terminates. This way the whole range can
+   be captured at once, instead of one element at a time */
+#define GEN_REPZ_QTRACE(op, qop)                                              \
+static inline void gen_repz_ ## op(DisasContext *s, int ot,                   \
+                                 target_ulong cur_eip, target_ulong next_eip) \
+{                                                                             \
+    int l1, l2;                                                               \
+    bool hook = (s->cpl == 0 && s->aflag != 0 && qtrace_tracer_enabled);      \
+    gen_update_cc_op(s);                                                      \
+    /* Same as gen_jz_ecx_string(), plus the termination hook */              \
+    l1 = gen_new_label();                                                     \
+    l2 = gen_new_label();                                                     \
+    gen_op_jnz_ecx(s->aflag, l1);                                             \
+    gen_set_label(l2);                                                        \
+    if (hook)                                                                 \
+        gen_helper_qtrace_string_end(cpu_env);                                \
+    gen_jmp_tb(s, next_eip, 1);                                               \
+    gen_set_label(l1);                                                        \
+    if (hook)                                                                 \
+        gen_qtrace_string_start(s, qop, ot, cur_eip);                         \
+    gen_ ## op(s, ot);                                                        \
+    gen_op_add_reg_im(s->aflag, R_ECX, -1);                                   \
+    /* a loop would cause two single step exceptions if ECX = 1               \
+       before rep string_insn */                                              \
+    if (!s->jmp_opt)                                                          \
+        gen_op_jz_ecx(s->aflag, l2);                                          \
+    gen_jmp(s, cur_eip);                                                      \
+}
+
+GEN_REPZ_QTRACE(movs, QTRACE_STRING_MOVS)
+GEN_REPZ_QTRACE(stos, QTRACE_STRING_STOS)
+#else
 GEN_REPZ(movs)
 GEN_REPZ(stos)
+#endif
 GEN_REPZ(lods)
 GEN_REPZ(ins)
 GEN_REPZ(outs)
@@ -8396,6 +8447,13 @@ static inline void gen_intermediate_code_internal(X86CPU *cpu,
         }
         if (num_insns + 1 == max_insns && (tb->cflags & CF_LAST_IO))
             gen_io_start();
+#ifdef CONFIG_QTRACE_SYSCALL
+        /* Capture calls to kernel copy routines at their entry point */
+        if (qtrace_tracer_enabled && dc->cpl == 0 &&
+            qtrace_gate_is_copy_routine(pc_ptr)) {
+            gen_helper_qtrace_copy_routine(cpu_env, tcg_const_tl(pc_ptr));
+        }
+#endif
 
         pc_ptr = disas_insn(env, dc, pc_ptr);
         num_insns++;
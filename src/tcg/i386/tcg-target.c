@@ -1247,34 +1247,173 @@ static void tcg_out_qemu_ld_direct(TCGContext *s, int datalo, int datahi,
 #define ARG_DEALLOC(n)
 #endif
 
-/* Pre-access read notification. The pre-access hook is needed because the
-   register containing the memory address that is going to be accessed is
-   *not* preserved by the TLB lookup procedure. Thus, in the pre-hook we
-   save the memory address, while in the post-hook we process the read
-   buffer. */
-static void tcg_out_qtrace_memread_pre(TCGContext *s, TCGArg addrlo_reg, 
-                                       TCGArg addrhi_reg, int size, int opc) {
-  int reg_idx;
+/* Emit a jump with a 32-bit displacement, and return the location of the
+   displacement, to be patched by tcg_out_qtrace_label() */
+static uint8_t *tcg_out_qtrace_jump(TCGContext *s, int opc) {
+  uint8_t *label_ptr;
 
-  PUSH_ALL();
+  tcg_out_opc(s, opc, 0, 0, 0);
+  label_ptr = s->code_ptr;
+  s->code_ptr += 4;
 
-  /* Prepare arguments */
-  ARG_IMM(3, size);
-  if (TCG_TARGET_REG_BITS == 32 && opc == 3) {
-    ARG_REG(2, addrhi_reg);
-  } else {
-    ARG_IMM(2, 0);
+  return label_ptr;
+}
+
+/* Make the jump emitted by tcg_out_qtrace_jump() target the current code
+   location */
+static void tcg_out_qtrace_label(TCGContext *s, uint8_t *label_ptr) {
+  *(int32_t *)label_ptr = (int32_t)(s->code_ptr - label_ptr - 4);
+}
+
+/* Pick a scratch register for inline QTrace code, other than the registers
+   in the "used" bitmap */
+static int tcg_qtrace_scratch_reg(unsigned int used) {
+  int reg;
+
+  for (reg = TCG_REG_EAX; reg <= TCG_REG_EDI; reg++) {
+    if (reg != TCG_REG_ESP && reg != TCG_AREG0 && !(used & (1 << reg))) {
+      return reg;
+    }
   }
-  ARG_REG(1, addrlo_reg);
-  ARG_REG(0, TCG_AREG0);
 
-  /* Call QTrace handler */
-  tcg_out_calli(s, (tcg_target_long) qtrace_gate_memread_pre);
+  tcg_abort();
+}
 
-  /* Deallocate arguments */
-  ARG_DEALLOC(4);
+/* Compare the guest stack pointer against the kernel stack of the thread
+   owning the QTrace hook state, clobbering "reg". The "below" condition
+   holds if the stack pointer is within that stack */
+static void tcg_out_qtrace_stack_cmp(TCGContext *s, int reg) {
+  /* reg = regs[R_ESP](env) - qtrace_stack_limit(env) */
+  tcg_out_ld(s, TCG_TYPE_I32, reg, TCG_AREG0,
+             offsetof(CPUArchState, regs[R_ESP]));
+  tcg_out_modrm_offset(s, OPC_ARITH_GvEv | (ARITH_SUB << 3), reg, TCG_AREG0,
+                       offsetof(CPUArchState, qtrace_stack_limit));
+
+  /* cmpl qtrace_stack_size(env), reg */
+  tcg_out_modrm_offset(s, OPC_CMP_GvEv, reg, TCG_AREG0,
+                       offsetof(CPUArchState, qtrace_stack_size));
+}
 
-  POP_ALL();
+/* Skip QTrace hooks when the current address space is filtered out, i.e.,
+   env->qtrace_filtered is non-zero, unless another thread than the one that
+   set the filter is running. All registers are preserved. Emits a
+   conditional jump and returns the location of its displacement, to be
+   patched by tcg_out_qtrace_filter_end() once the hook code has been
+   emitted. */
+static uint8_t *tcg_out_qtrace_filter_begin(TCGContext *s) {
+  uint8_t *label_hooks, *label_skip;
+  int r0;
+
+  /* cmpl $0, qtrace_filtered(env); je hooks */
+  tcg_out_modrm_offset(s, OPC_ARITH_EvIb, ARITH_CMP, TCG_AREG0,
+                       offsetof(CPUArchState, qtrace_filtered));
+  tcg_out8(s, 0);
+  label_hooks = tcg_out_qtrace_jump(s, OPC_JCC_long + JCC_JE);
+
+  /* Hooks are taken after a thread switch, for QTrace to clear the filter.
+     "pop" preserves flags */
+  r0 = tcg_qtrace_scratch_reg(0);
+  tcg_out_push(s, r0);
+  tcg_out_qtrace_stack_cmp(s, r0);
+  tcg_out_pop(s, r0);
+
+  /* jb skip */
+  label_skip = tcg_out_qtrace_jump(s, OPC_JCC_long + JCC_JB);
+  tcg_out_qtrace_label(s, label_hooks);
+
+  return label_skip;
+}
+
+static void tcg_out_qtrace_filter_end(TCGContext *s, uint8_t *label_ptr) {
+  tcg_out_qtrace_label(s, label_ptr);
+}
+
+/* Append a memory access to the access buffer of the vCPU, without calling
+   into QTrace. The address is taken from "addr_reg", or from
+   env->qtrace_memread_addr if "addr_reg" is negative; "used" is the bitmap
+   of the registers holding operands. All registers are preserved.
+
+   The slow path, calling into QTrace, must be emitted right after: it is
+   taken when the buffer is full or disarmed, a kernel copy routine is being
+   executed, or the stack pointer is outside the stack of the thread that
+   armed the buffer (e.g., another thread is running). Returns the location
+   of the jump over the slow path, to be patched by tcg_out_qtrace_label(). */
+static uint8_t *tcg_out_qtrace_append(TCGContext *s, int kind, int addr_reg,
+                                      int data_reg, int size,
+                                      unsigned int used) {
+  uint8_t *label_busy, *label_full, *label_thread, *label_done;
+  int r0, r1;
+
+  r0 = tcg_qtrace_scratch_reg(used);
+  r1 = tcg_qtrace_scratch_reg(used | (1 << r0));
+  tcg_out_push(s, r0);
+  tcg_out_push(s, r1);
+
+  /* cmpl $0, qtrace_copy_esp(env); jne slow */
+  tcg_out_modrm_offset(s, OPC_ARITH_EvIb, ARITH_CMP, TCG_AREG0,
+                       offsetof(CPUArchState, qtrace_copy_esp));
+  tcg_out8(s, 0);
+  label_busy = tcg_out_qtrace_jump(s, OPC_JCC_long + JCC_JNE);
+
+  /* r0 = qtrace_access_ptr(env); if (r0 >= qtrace_access_end(env)) slow */
+  tcg_out_ld(s, TCG_TYPE_PTR, r0, TCG_AREG0,
+             offsetof(CPUArchState, qtrace_access_ptr));
+  tcg_out_modrm_offset(s, OPC_CMP_GvEv + P_REXW, r0, TCG_AREG0,
+                       offsetof(CPUArchState, qtrace_access_end));
+  label_full = tcg_out_qtrace_jump(s, OPC_JCC_long + JCC_JAE);
+
+  /* Stack pointer outside the stack of the owner thread: slow */
+  tcg_out_qtrace_stack_cmp(s, r1);
+  label_thread = tcg_out_qtrace_jump(s, OPC_JCC_long + JCC_JAE);
+
+  /* Fill the record */
+  tcg_out_ld(s, TCG_TYPE_I32, r1, TCG_AREG0, offsetof(CPUArchState, eip));
+  tcg_out_st(s, TCG_TYPE_I32, r1, r0, offsetof(QTraceAccess, pc));
+
+  if (addr_reg < 0) {
+    tcg_out_ld(s, TCG_TYPE_I32, r1, TCG_AREG0,
+               offsetof(CPUArchState, qtrace_memread_addr));
+    addr_reg = r1;
+  }
+  tcg_out_st(s, TCG_TYPE_I32, addr_reg, r0, offsetof(QTraceAccess, addr));
+  tcg_out_st(s, TCG_TYPE_I32, data_reg, r0, offsetof(QTraceAccess, value));
+
+  tcg_out_ld(s, TCG_TYPE_I32, r1, TCG_AREG0, offsetof(CPUArchState, hflags));
+  tgen_arithi(s, ARITH_AND, r1, HF_CPL_MASK, 0);
+  tcg_out_shifti(s, SHIFT_SHL, r1, QTRACE_ACCESS_CPL_SHIFT - HF_CPL_SHIFT);
+  tgen_arithi(s, ARITH_OR, r1, size | (kind << QTRACE_ACCESS_KIND_SHIFT), 0);
+  tcg_out_st(s, TCG_TYPE_I32, r1, r0, offsetof(QTraceAccess, info));
+
+  /* qtrace_access_ptr(env) = r0 + 1 */
+  tcg_out_addi(s, r0, sizeof(QTraceAccess));
+  tcg_out_st(s, TCG_TYPE_PTR, r0, TCG_AREG0,
+             offsetof(CPUArchState, qtrace_access_ptr));
+
+  tcg_out_pop(s, r1);
+  tcg_out_pop(s, r0);
+  label_done = tcg_out_qtrace_jump(s, OPC_JMP_long);
+
+  /* Slow path */
+  tcg_out_qtrace_label(s, label_busy);
+  tcg_out_qtrace_label(s, label_full);
+  tcg_out_qtrace_label(s, label_thread);
+  tcg_out_pop(s, r1);
+  tcg_out_pop(s, r0);
+
+  return label_done;
+}
+
+/* Pre-access read notification. The pre-access hook is needed because the
+   register containing the memory address that is going to be accessed is
+   *not* preserved by the TLB lookup procedure. Thus, in the pre-hook we
+   save the memory address in env, while in the post-hook we process the read
+   buffer. */
+static void tcg_out_qtrace_memread_pre(TCGContext *s, TCGArg addrlo_reg, 
+                                       TCGArg addrhi_reg, int size, int opc) {
+  /* movl addrlo, qtrace_memread_addr(env). The high part of 64-bit
+     addresses is never used, as such accesses are not analyzed */
+  tcg_out_st(s, TCG_TYPE_I32, addrlo_reg, TCG_AREG0,
+             offsetof(CPUArchState, qtrace_memread_addr));
 }
 
 /* Post-access read notification. Process the data that has just been read
@@ -1283,7 +1422,16 @@ static void tcg_out_qtrace_memread_pre(TCGContext *s, TCGArg addrlo_reg,
 static void tcg_out_qtrace_memread_post(TCGContext *s, TCGArg datalo_reg, 
                                         TCGArg datahi_reg, int size, int opc) {
   int reg_idx;
+  uint8_t *label_ptr, *done_ptr = NULL;
  
+  label_ptr = tcg_out_qtrace_filter_begin(s);
+
+  /* Word-sized accesses are appended to the access buffer */
+  if (size <= (int)sizeof(target_ulong)) {
+    done_ptr = tcg_out_qtrace_append(s, QTRACE_ACCESS_READ, -1, datalo_reg,
+                                     size, 1 << datalo_reg);
+  }
+
   /* Save general purpose registers. These registers are not preserved by
      the QTrace callback, so they must be explicitly saved here. */
   PUSH_ALL();
@@ -1308,6 +1456,11 @@ static void tcg_out_qtrace_memread_post(TCGContext *s, TCGArg datalo_reg,
 
   /* Restore general purpose registers */
   POP_ALL();
+
+  if (done_ptr) {
+    tcg_out_qtrace_label(s, done_ptr);
+  }
+  tcg_out_qtrace_filter_end(s, label_ptr);
 }
 
 /* Pre-access write notification. */
@@ -1315,6 +1468,16 @@ static void tcg_out_qtrace_memwrite_pre(TCGContext *s, TCGArg addrlo_reg,
                                         TCGArg addrhi_reg, TCGArg datalo_reg,
                                         TCGArg datahi_reg, int size, int opc) {
   int reg_idx;
+  uint8_t *label_ptr, *done_ptr = NULL;
+
+  label_ptr = tcg_out_qtrace_filter_begin(s);
+
+  /* Word-sized accesses are appended to the access buffer */
+  if (size <= (int)sizeof(target_ulong)) {
+    done_ptr = tcg_out_qtrace_append(s, QTRACE_ACCESS_WRITE, addrlo_reg,
+                                     datalo_reg, size,
+                                     (1 << addrlo_reg) | (1 << datalo_reg));
+  }
 
   /* Save general purpose registers. These registers are not preserved by
      the QTrace callback, so they must be explicitly saved here. */
@@ -1343,6 +1506,11 @@ static void tcg_out_qtrace_memwrite_pre(TCGContext *s, TCGArg addrlo_reg,
 
   /* Restore general purpose registers */
   POP_ALL();
+
+  if (done_ptr) {
+    tcg_out_qtrace_label(s, done_ptr);
+  }
+  tcg_out_qtrace_filter_end(s, label_ptr);
 }
 #endif /* CONFIG_QTRACE_SYSCALL */
 
@@ -1370,8 +1538,10 @@ static void tcg_out_qemu_ld(TCGContext *s, const TCGArg *args,
     s_bits = opc & 3;
 
 #ifdef CONFIG_QTRACE_SYSCALL
-    tcg_out_qtrace_memread_pre(s, args[addrlo_idx], args[addrlo_idx+1], 
-                               1 << s_bits, opc);
+    if (qtrace_tracer_enabled) {
+        tcg_out_qtrace_memread_pre(s, args[addrlo_idx], args[addrlo_idx+1],
+                                   1 << s_bits, opc);
+    }
 #endif
 
     tcg_out_tlb_load(s, addrlo_idx, mem_index, s_bits, args,
@@ -1393,7 +1563,9 @@ static void tcg_out_qemu_ld(TCGContext *s, const TCGArg *args,
                         label_ptr);
 
 #ifdef CONFIG_QTRACE_SYSCALL
-    tcg_out_qtrace_memread_post(s, data_reg, data_reg2, 1 << s_bits, opc);
+    if (qtrace_tracer_enabled) {
+        tcg_out_qtrace_memread_post(s, data_reg, data_reg2, 1 << s_bits, opc);
+    }
 #endif
 #else
     {
@@ -1506,8 +1678,10 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args,
     s_bits = opc;
 
 #ifdef CONFIG_QTRACE_SYSCALL
-  tcg_out_qtrace_memwrite_pre(s, args[addrlo_idx], args[addrlo_idx + 1],
-                              data_reg, data_reg2, 1 << s_bits, opc);
+    if (qtrace_tracer_enabled) {
+        tcg_out_qtrace_memwrite_pre(s, args[addrlo_idx], args[addrlo_idx + 1],
+                                    data_reg, data_reg2, 1 << s_bits, opc);
+    }
 #endif
 
     tcg_out_tlb_load(s, addrlo_idx, mem_index, s_bits, args,
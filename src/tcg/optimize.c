@@ -51,6 +51,92 @@ struct tcg_temp_info {
 
 static struct tcg_temp_info temps[TCG_MAX_TEMPS];
 
+#ifdef CONFIG_QTRACE_TAINT
+/* Maximum number of input arguments of a coalescable QTrace helper call,
+   including the helper address */
+#define QTRACE_CALL_MAX_IARGS 6
+
+/* Last coalescable QTrace taint helper call. Only calls whose arguments are
+   all constants are recorded, and the record is dropped at the end of each
+   basic block and at any operation that may observe or change the shadow
+   state (i.e., other helper calls and memory accesses). */
+static struct {
+    bool valid;
+    int op_index;               /* Index of the call opcode */
+    TCGArg *gen_args;           /* Call parameters, in the optimized stream */
+    int nb_args;                /* Number of call parameters */
+    TCGArg flags;
+    int nb_iargs;
+    tcg_target_ulong vals[QTRACE_CALL_MAX_IARGS];   /* Helper address last */
+} qtrace_last_call;
+
+/* Coalesce QTrace taint helper calls. Returns true if the call with
+   parameters ARGS is redundant and can be dropped. The previous call is
+   turned into a nop if this one overwrites its effect. GEN_ARGS is where
+   the parameters of this call are going to be copied. */
+static bool qtrace_coalesce_call(TCGContext *s, int op_index, TCGArg *args,
+                                 TCGArg *gen_args)
+{
+    int nb_oargs = args[0] >> 16;
+    int nb_iargs = args[0] & 0xffff;
+    TCGArg flags = args[nb_oargs + nb_iargs + 1];
+    tcg_target_ulong vals[QTRACE_CALL_MAX_IARGS];
+    int i;
+
+    if (!(flags & TCG_CALL_QTRACE_IDEMPOTENT) || nb_oargs != 0 ||
+        nb_iargs > QTRACE_CALL_MAX_IARGS) {
+        qtrace_last_call.valid = false;
+        return false;
+    }
+
+    for (i = 0; i < nb_iargs; i++) {
+        TCGArg arg = args[nb_oargs + i + 1];
+        if (arg == TCG_CALL_DUMMY_ARG || temps[arg].state != TCG_TEMP_CONST) {
+            qtrace_last_call.valid = false;
+            return false;
+        }
+        vals[i] = temps[arg].val;
+    }
+
+    if (qtrace_last_call.valid) {
+        /* Same helper with the same arguments */
+        if (qtrace_last_call.flags == flags &&
+            qtrace_last_call.nb_iargs == nb_iargs &&
+            memcmp(qtrace_last_call.vals, vals,
+                   nb_iargs * sizeof(vals[0])) == 0) {
+            return true;
+        }
+
+        /* This call overwrites the register defined by the previous one,
+           without reading it */
+        if ((flags & TCG_CALL_QTRACE_DEF) &&
+            (qtrace_last_call.flags & TCG_CALL_QTRACE_DEF) &&
+            qtrace_last_call.vals[0] == vals[0]) {
+            for (i = 1; i < nb_iargs - 1; i++) {
+                if (vals[i] == vals[0]) {
+                    break;
+                }
+            }
+            if (i == nb_iargs - 1) {
+                s->gen_opc_buf[qtrace_last_call.op_index] = INDEX_op_nopn;
+                qtrace_last_call.gen_args[0] = qtrace_last_call.nb_args;
+                qtrace_last_call.gen_args[qtrace_last_call.nb_args - 1] =
+                    qtrace_last_call.nb_args;
+            }
+        }
+    }
+
+    qtrace_last_call.valid = true;
+    qtrace_last_call.op_index = op_index;
+    qtrace_last_call.gen_args = gen_args;
+    qtrace_last_call.nb_args = nb_oargs + nb_iargs + 3;
+    qtrace_last_call.flags = flags;
+    qtrace_last_call.nb_iargs = nb_iargs;
+    memcpy(qtrace_last_call.vals, vals, nb_iargs * sizeof(vals[0]));
+    return false;
+}
+#endif
+
 /* Reset TEMP's state to TCG_TEMP_UNDEF.  If TEMP only had one copy, remove
    the copy flag from the left temp.  */
 static void reset_temp(TCGArg temp)
@@ -498,12 +584,22 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
     nb_temps = s->nb_temps;
     nb_globals = s->nb_globals;
     reset_all_temps(nb_temps);
+#ifdef CONFIG_QTRACE_TAINT
+    qtrace_last_call.valid = false;
+#endif
 
     nb_ops = tcg_opc_ptr - s->gen_opc_buf;
     gen_args = args;
     for (op_index = 0; op_index < nb_ops; op_index++) {
         op = s->gen_opc_buf[op_index];
         def = &tcg_op_defs[op];
+#ifdef CONFIG_QTRACE_TAINT
+        if (op != INDEX_op_call &&
+            (def->flags & (TCG_OPF_BB_END | TCG_OPF_CALL_CLOBBER |
+                           TCG_OPF_SIDE_EFFECTS))) {
+            qtrace_last_call.valid = false;
+        }
+#endif
         /* Do copy propagation */
         if (op == INDEX_op_call) {
             int nb_oargs = args[0] >> 16;
@@ -1071,6 +1167,13 @@ static TCGArg *tcg_constant_folding(TCGContext *s, uint16_t *tcg_opc_ptr,
 
         case INDEX_op_call:
             nb_call_args = (args[0] >> 16) + (args[0] & 0xffff);
+#ifdef CONFIG_QTRACE_TAINT
+            if (qtrace_coalesce_call(s, op_index, args, gen_args)) {
+                s->gen_opc_buf[op_index] = INDEX_op_nop;
+                args += nb_call_args + 3;
+                break;
+            }
+#endif
             if (!(args[nb_call_args + 1] & (TCG_CALL_NO_READ_GLOBALS |
                                             TCG_CALL_NO_WRITE_GLOBALS))) {
                 for (i = 0; i < nb_globals; i++) {
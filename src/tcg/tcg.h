@@ -292,6 +292,15 @@ typedef int TCGv_i64;
 #define TCG_CALL_NO_WRITE_GLOBALS   0x0020
 /* Helper can be safely suppressed if the return value is not used. */
 #define TCG_CALL_NO_SIDE_EFFECTS    0x0040
+#ifdef CONFIG_QTRACE_TAINT
+/* QTrace taint helper that only updates the shadow state of the registers
+   given as constant arguments: two consecutive calls with the same arguments
+   have the same effect as a single call. */
+#define TCG_CALL_QTRACE_IDEMPOTENT  0x0080
+/* QTrace taint helper that overwrites the taint of the register given as
+   first argument, and never reads it. */
+#define TCG_CALL_QTRACE_DEF         0x0100
+#endif
 
 /* convenience version of most used call flags */
 #define TCG_CALL_NO_RWG         TCG_CALL_NO_READ_GLOBALS
@@ -433,6 +442,8 @@ struct TCGContext {
     int frame_reg;
 
     uint8_t *code_ptr;
+    uint8_t *code_slow_ptr; /* start of the out-of-line slow paths of the
+                               last generated TB */
     TCGTemp temps[TCG_MAX_TEMPS]; /* globals first, temps after */
 
     TCGHelperInfo *helpers;
@@ -60,6 +60,13 @@
 #include "translate-all.h"
 #include "qemu/timer.h"
 
+#ifdef CONFIG_QTRACE_SYSCALL
+#include "qtrace/gate.h"
+#endif
+#ifdef CONFIG_QTRACE_TAINT
+#include "qtrace/taint.h"
+#endif
+
 //#define DEBUG_TB_INVALIDATE
 //#define DEBUG_FLUSH
 /* make various TB consistency checks */
@@ -606,6 +613,86 @@ bool tcg_enabled(void)
     return tcg_ctx.code_gen_buffer != NULL;
 }
 
+/* Linux perf map of the translation buffer, NULL if disabled. Each line
+   names a range of host code as "start size name", in hexadecimal */
+static FILE *tb_perfmap;
+
+/* Drop all the entries of the perf map. The translation buffer is reused
+   after a flush, thus old entries would overlap with new ones; samples taken
+   before the flush are attributed to the code that replaced them */
+static void tb_perfmap_reset(void)
+{
+    fflush(tb_perfmap);
+    if (ftruncate(fileno(tb_perfmap), 0) != 0) {
+        fprintf(stderr, "Could not truncate perf map: %s\n", strerror(errno));
+    }
+    rewind(tb_perfmap);
+
+    /* The prologue lives in the 1024 bytes stolen by code_gen_alloc() */
+    fprintf(tb_perfmap, "%" PRIxPTR " %x qemu:prologue\n",
+            (uintptr_t)tcg_ctx.code_gen_prologue, 1024);
+}
+
+/* Instrumentation emitted for the TB being translated */
+static const char *tb_perfmap_mode(void)
+{
+    bool hooks = false, taint = false;
+
+#ifdef CONFIG_QTRACE_SYSCALL
+    hooks = qtrace_tracer_enabled;
+#endif
+#ifdef CONFIG_QTRACE_TAINT
+    taint = qtrace_taint_enabled;
+#endif
+    if (hooks) {
+        return taint ? "hooks+taint" : "hooks";
+    }
+    return taint ? "taint" : "plain";
+}
+
+/* Add the host code of a freshly translated TB to the perf map. Out-of-line
+   slow paths (softmmu TLB misses, emitted at the end of the TB) get their own
+   entry, so that they are not accounted to the TB fast path */
+static void tb_perfmap_add(TranslationBlock *tb, int code_gen_size)
+{
+    uint8_t *slow_ptr = tcg_ctx.code_slow_ptr;
+    uint8_t *end_ptr = tb->tc_ptr + code_gen_size;
+    const char *mode = tb_perfmap_mode();
+
+    fprintf(tb_perfmap, "%" PRIxPTR " %x qemu:tb:" TARGET_FMT_lx " [%s]\n",
+            (uintptr_t)tb->tc_ptr, (unsigned int)(slow_ptr - tb->tc_ptr),
+            tb->pc, mode);
+    if (end_ptr > slow_ptr) {
+        fprintf(tb_perfmap, "%" PRIxPTR " %x qemu:tb:" TARGET_FMT_lx
+                ":slowpath [%s]\n", (uintptr_t)slow_ptr,
+                (unsigned int)(end_ptr - slow_ptr), tb->pc, mode);
+    }
+}
+
+static void tb_perfmap_close(void)
+{
+    fclose(tb_perfmap);
+    tb_perfmap = NULL;
+}
+
+/* Start writing a perf map of translated code to /tmp/perf-<pid>.map. Must
+   be called after tcg_exec_init() */
+void tb_perfmap_init(void)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+    tb_perfmap = fopen(path, "w");
+    if (tb_perfmap == NULL) {
+        fprintf(stderr, "Could not open perf map %s: %s\n", path,
+                strerror(errno));
+        return;
+    }
+
+    tb_perfmap_reset();
+    atexit(tb_perfmap_close);
+}
+
 /* Allocate a new translation block. Flush the translation buffer if
    too many translation blocks or too much generated code. */
 static TranslationBlock *tb_alloc(target_ulong pc)
@@ -710,6 +797,10 @@ void tb_flush(CPUArchState *env1)
     /* XXX: flush processor icache at this point if cache flush is
        expensive */
     tcg_ctx.tb_ctx.tb_flush_count++;
+
+    if (tb_perfmap) {
+        tb_perfmap_reset();
+    }
 }
 
 #ifdef DEBUG_TB_CHECK
@@ -962,6 +1053,9 @@ TranslationBlock *tb_gen_code(CPUArchState *env,
     tb->flags = flags;
     tb->cflags = cflags;
     cpu_gen_code(env, tb, &code_gen_size);
+    if (tb_perfmap) {
+        tb_perfmap_add(tb, code_gen_size);
+    }
     tcg_ctx.code_gen_ptr = (void *)(((uintptr_t)tcg_ctx.code_gen_ptr +
             code_gen_size + CODE_GEN_ALIGN - 1) & ~(CODE_GEN_ALIGN - 1));
 
@@ -172,6 +172,7 @@ int main(int argc, char **argv)
 #include "qapi/string-input-visitor.h"
 
 #ifdef CONFIG_QTRACE_CORE
+#include "qtrace/hooks.h"
 #include "qtrace/options.h"
 extern struct QTraceOptions qtrace_options;
 #endif
@@ -3892,12 +3893,68 @@ int main(int argc, char **argv, char **envp)
             case QEMU_OPTION_qtrace_foreign:
 	        qtrace_options.track_foreign = true;
                 break;
+            case QEMU_OPTION_qtrace_compact:
+	        qtrace_options.trace_compact = true;
+                break;
+            case QEMU_OPTION_qtrace_dedup:
+                if (qtrace_parse_uint(optarg,
+                                      &qtrace_options.dedup_threshold) != 0) {
+                    fprintf(stderr, "qemu: invalid QTrace dedup size '%s'\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            case QEMU_OPTION_qtrace_columns:
+	        qtrace_options.trace_columns = true;
+                break;
+            case QEMU_OPTION_qtrace_copyfuncs:
+	        qtrace_options.copy_routines = optarg;
+                break;
+            case QEMU_OPTION_qtrace_snapshot_args:
+	        qtrace_options.snapshot_args = true;
+                break;
+            case QEMU_OPTION_qtrace_layout:
+                qtrace_options.layout_mode = qtrace_parse_layout_mode(optarg);
+                if (qtrace_options.layout_mode == LayoutUnknown) {
+                    fprintf(stderr, "qemu: invalid QTrace layout mode '%s'\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            case QEMU_OPTION_qtrace_limits: {
+                struct CaptureLimits limits;
+                if (qtrace_parse_capture_limits(optarg, &limits) != 0) {
+                    fprintf(stderr, "qemu: invalid QTrace capture limits "
+                            "'%s'\n", optarg);
+                    exit(1);
+                }
+	        qtrace_options.capture_limits = optarg;
+                break;
+            }
+            case QEMU_OPTION_qtrace_sampling:
+	        qtrace_options.sampling = optarg;
+                break;
+            case QEMU_OPTION_qtrace_output_filter:
+	        qtrace_options.output_filter = optarg;
+                break;
+            case QEMU_OPTION_qtrace_async:
+	        qtrace_options.async_events = true;
+                break;
+            case QEMU_OPTION_qtrace_host_time:
+	        qtrace_options.host_time = true;
+                break;
 #endif
 #ifdef CONFIG_QTRACE_TAINT
             case QEMU_OPTION_qtrace_taint_disabled:
 	        qtrace_options.taint_disabled = true;
                 break;
 #endif
+            case QEMU_OPTION_qtrace_hook_stats:
+	        qtrace_options.hook_stats = true;
+                break;
+            case QEMU_OPTION_qtrace_perfmap:
+	        qtrace_options.perfmap = true;
+                break;
 #endif
             default:
                 os_parse_cmd_args(popt->index, optarg);
@@ -4243,6 +4300,12 @@ int main(int argc, char **argv, char **envp)
     }
 
     cpu_exec_init_all();
+#ifdef CONFIG_QTRACE_CORE
+    qtrace_hooks_init(qtrace_options.hook_stats);
+    if (qtrace_options.perfmap && tcg_enabled()) {
+        tb_perfmap_init();
+    }
+#endif
 
     blk_mig_init();
 
@@ -107,6 +107,73 @@ def fetchsyscalls_win32k(data):
 
     return sysops
 
+# Parameters of the 32-bit FNV-1a hash function. Must be kept in sync with
+# syscall_hash() in src/qtrace/trace/windows.cc
+FNV_OFFSET = 0x811c9dc5
+FNV_PRIME  = 0x01000193
+
+# Average number of names per bucket of the perfect hash function
+HASH_BUCKET_SIZE = 4
+
+# Marker for empty slots of the perfect hash table
+HASH_EMPTY_SLOT = 0xffff
+
+def fnvhash(name, seed):
+    h = FNV_OFFSET ^ seed
+    for c in name:
+        h ^= ord(c)
+        h = (h * FNV_PRIME) & 0xffffffff
+    return h
+
+def generatehash(names):
+    """
+    Build a minimal perfect hash function for syscall names, using the
+    "hash and displace" scheme: names are first split into buckets with seed
+    0, then, for each bucket (largest first), a seed is searched such that all
+    names of the bucket land in empty slots.
+
+    Returns the (seeds, slots) tables; slots map to indexes inside "names".
+    """
+    nbuckets = max(1, len(names) // HASH_BUCKET_SIZE)
+    nslots = len(names)
+
+    buckets = [[] for _ in range(nbuckets)]
+    for i, name in enumerate(names):
+        buckets[fnvhash(name, 0) % nbuckets].append(i)
+
+    seeds = [0] * nbuckets
+    slots = [None] * nslots
+
+    order = sorted(range(nbuckets), key=lambda b: len(buckets[b]),
+                   reverse=True)
+    for b in order:
+        if len(buckets[b]) == 0:
+            continue
+
+        seed = 1
+        while True:
+            candidates = [fnvhash(names[i], seed) % nslots
+                          for i in buckets[b]]
+            if len(set(candidates)) == len(candidates) and \
+                    all(slots[c] is None for c in candidates):
+                break
+            seed += 1
+            assert seed <= 0xffff, "Cannot build perfect hash function"
+
+        seeds[b] = seed
+        for i, c in zip(buckets[b], candidates):
+            slots[c] = i
+
+    return seeds, slots
+
+def generatearray(ctype, varname, values, perline = 10):
+    data = "const %s %s[] = {\n" % (ctype, varname)
+    for i in range(0, len(values), perline):
+        data += "  " + ", ".join(["%d" % v for v in values[i:i+perline]])
+        data += ",\n"
+    data += "};\n"
+    return data
+
 def generatefiledata(target, syscalls):
     varname = "syscalls_"  + target.replace(" ", "")
 
@@ -117,15 +184,41 @@ def generatefiledata(target, syscalls):
 // This file is generated automatically using %s. Do not edit!
 //
 
+#pragma once
+
 const char *%s[] = {
 """ % (os.path.basename(sys.argv[0]), varname)
-    for sysno in range(max(syscalls.keys())):
+
+    table = []
+    for sysno in range(max(syscalls.keys()) + 1):
         if sysno in syscalls:
             name = syscalls[sysno]
         else:
             name = "unknown%d" % sysno
+        table.append(name)
         data += "  \"%s\",\n" % name
     data += "};\n"
+
+    # Perfect hash function for syscall names (placeholders excluded)
+    sysnos = [sysno for sysno in sorted(syscalls.keys())]
+    names = [syscalls[sysno] for sysno in sysnos]
+    seeds, slots = generatehash(names)
+    slots = [sysnos[i] if i is not None else HASH_EMPTY_SLOT for i in slots]
+
+    data += """
+// Perfect hash function for syscall names: the bucket of a name is
+// syscall_hash(name, 0) %% %d, and its system call number is found at slot
+// syscall_hash(name, %s_hash_seeds[bucket]) %% %d
+""" % (len(seeds), varname, len(slots))
+    data += generatearray("uint16_t", varname + "_hash_seeds", seeds)
+    data += generatearray("uint16_t", varname + "_hash_slots", slots)
+    data += """
+const SyscallHashTable %s_hash = {
+  %s_hash_seeds, %d,
+  %s_hash_slots, %d,
+};
+""" % (varname, varname, len(seeds), varname, len(slots))
+
     return data
 
 
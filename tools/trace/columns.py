@@ -0,0 +1,79 @@
+"""
+Copyright 2014, Roberto Paleari (@rpaleari)
+
+Reader for the columnar syscall summary written by QTrace next to trace files
+(option -qtrace-columns). Each column is a flat array of native unsigned
+integers, one per syscall; the file extension gives their width (".u32", or
+".u64" for the return values of 64-bit targets). Column files are
+memory-mapped, so scanning a column does not require parsing the protobuf
+trace.
+"""
+
+import array
+import mmap
+import os
+
+COLUMNS = ("id", "sysno", "pid", "tid", "process", "retval", "nargs",
+           "inbytes", "outbytes", "labels_in", "labels_out", "cpu", )
+
+class SummaryColumns(object):
+    def __init__(self, dirname):
+        self.dirname = dirname
+        self.maps = {}
+        self.widths = {}
+
+        # Process names dictionary: NUL-terminated strings, in index order
+        with open(os.path.join(dirname, "process.dict"), "rb") as f:
+            self.processes = f.read().split("\x00")[:-1]
+
+    def __len__(self):
+        return len(self.column("id"))
+
+    def _map(self, name):
+        if name not in self.maps:
+            assert name in COLUMNS, "Unknown column %s" % name
+            for width in (32, 64):
+                filename = os.path.join(self.dirname, "%s.u%d" % (name, width))
+                if os.path.exists(filename):
+                    break
+            self.widths[name] = width
+            with open(filename, "rb") as f:
+                if os.fstat(f.fileno()).st_size == 0:
+                    self.maps[name] = ""
+                else:
+                    self.maps[name] = mmap.mmap(f.fileno(), 0,
+                                                access=mmap.ACCESS_READ)
+        return self.maps[name]
+
+    def column(self, name):
+        """
+        Return the values of a column. When numpy is available, the result is
+        a read-only array backed by the mapped file.
+        """
+        data = self._map(name)
+        width = self.widths[name]
+        try:
+            import numpy
+            dtype = numpy.uint64 if width == 64 else numpy.uint32
+            return numpy.frombuffer(data, dtype=dtype)
+        except ImportError:
+            for typecode in ("I", "L", "Q"):
+                try:
+                    values = array.array(typecode)
+                except ValueError:
+                    continue
+                if values.itemsize * 8 == width:
+                    break
+            values.fromstring(data[:])
+            return values
+
+    def getProcessName(self, index):
+        return self.processes[index]
+
+    def rows(self, *names):
+        """
+        Generate tuples with the values of the specified columns.
+        """
+        if len(names) == 0:
+            names = COLUMNS
+        return zip(*[self.column(name) for name in names])
@@ -24,6 +24,8 @@ class TraceHeader(object):
         self.timestamp = datetime.datetime.fromtimestamp(obj.timestamp)
         self.profile = obj.targetos
         self.hastaint = obj.hastaint
+        self.version = obj.version
+        self.sysnames = list(obj.sysname)
 
     def getProfileName(self):
         return TraceHeader.PROFILE_MAP.get(self.profile, "Unknown")
@@ -34,6 +36,7 @@ class TraceHeader(object):
         s += "  date:    %s\n" % self.timestamp
         s += "  profile: %s\n" % self.getProfileName()
         s += "  taint?   %s\n" % self.hastaint
+        s += "  version: %d\n" % self.version
         return s
 
 class TraceReader(object):
@@ -55,6 +58,15 @@ class TraceReader(object):
         assert obj.magic == trace.syscall_pb2.TraceHeader.TRACE_MAGIC
         self.header = TraceHeader(obj)
 
+        # Syscall names embedded in the trace take precedence
+        if len(self.header.sysnames) > 0:
+            self.names = self.header.sysnames
+
+        # Process, thread and payload tables (compact traces only)
+        self.processes = {}
+        self.threads = {}
+        self.blobs = {}
+
     def __iter__(self):
         """
         Generate a sequence of Syscall objects from an input stream.
@@ -69,13 +81,59 @@ class TraceReader(object):
             data = self.stream.read(size)
             offset += size + intsize
 
-            obj = trace.syscall_pb2.Syscall()
-            obj.ParseFromString(data)
+            if self.header.version >= 2:
+                obj = self._parseRecord(data)
+                if obj is None:
+                    continue
+                process = self.threads[obj.thread]
+            else:
+                obj = trace.syscall_pb2.Syscall()
+                obj.ParseFromString(data)
+                process = (obj.process.pid, obj.process.tid, obj.process.name)
 
             if obj.sysno < len(self.names):
                 name = self.names[obj.sysno]
             else:
                 name = None
 
-            syscall = Syscall(obj, name)
+            syscall = Syscall(obj, name, process)
             yield syscall
+
+    def _resolveBlobs(self, argobj):
+        """
+        Replace references to deduplicated payloads with the actual data.
+        """
+        for interval in list(argobj.indata) + list(argobj.outdata):
+            if interval.HasField("blob"):
+                interval.data = self.blobs[interval.blob]
+
+        for ptrobj in argobj.ptr:
+            self._resolveBlobs(ptrobj)
+
+    def _parseRecord(self, data):
+        """
+        Parse a compact trace record. Process, thread and blob records update
+        the reader tables, and None is returned; for syscall records, the
+        Syscall protobuf object is returned.
+        """
+        record = trace.syscall_pb2.TraceRecord()
+        record.ParseFromString(data)
+
+        if record.HasField("blob"):
+            self.blobs[record.blob.ref] = record.blob.data
+            return None
+
+        if record.HasField("process"):
+            self.processes[record.process.ref] = \
+                (record.process.pid, record.process.name)
+            return None
+
+        if record.HasField("thread"):
+            pid, name = self.processes[record.thread.process]
+            self.threads[record.thread.ref] = (pid, record.thread.tid, name)
+            return None
+
+        assert record.HasField("syscall")
+        for argobj in record.syscall.arg:
+            self._resolveBlobs(argobj)
+        return record.syscall
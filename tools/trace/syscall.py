@@ -27,15 +27,21 @@ def collapse_intervals(intervals, fillchar='\xdc'):
 class Syscall(object):
     STATUS_SUCCESS = 0x00000000
 
-    def __init__(self, obj, name):
+    def __init__(self, obj, name, process):
         self.idz = obj.id
         self.name = name
         self.sysno = obj.sysno
         self.retval = obj.retval
+        self.truncated = obj.truncated
+        self.cpu = obj.cpu
+        self.start_time = obj.start_time
+        self.end_time = obj.end_time
+        if obj.HasField("start_icount"):
+            self.instructions = obj.end_icount - obj.start_icount
+        else:
+            self.instructions = None
 
-        self.process_name = obj.process.name
-        self.process_pid = obj.process.pid
-        self.process_tid = obj.process.tid
+        self.process_pid, self.process_tid, self.process_name = process
 
         self.taintlabel_retval = obj.taintlabel_retval
 
@@ -75,6 +81,14 @@ class Syscall(object):
         s += "  process: pid = 0x%.8x, tid = 0x%.8x, name = %s\n" % \
              (self.process_pid, self.process_tid, self.process_name)
         s += "  return value: 0x%.8x\n" % self.retval
+        s += "  cpu: %d\n" % self.cpu
+        if self.end_time:
+            s += "  latency: %d ns" % (self.end_time - self.start_time)
+            if self.instructions is not None:
+                s += ", %d instructions" % self.instructions
+            s += "\n"
+        if self.truncated:
+            s += "  truncated: capture limits exceeded\n"
         s += "  external references (%d):\n" % len(self.extrefs)
         for i in range(len(self.extrefs)):
             extref = self.extrefs[i]
@@ -129,11 +143,17 @@ class Syscall(object):
         return retval & 0xffffffff
 
 class SyscallArgument(object):
-    def __init__(self, obj):
+    def __init__(self, obj, parent=None):
         self.allocation = None
-        self.addr = obj.addr
         self.offset = obj.offset
 
+        # Compact traces store nested addresses relative to the parent
+        if obj.HasField("addr_delta"):
+            assert parent is not None
+            self.addr = parent.addr + obj.addr_delta
+        else:
+            self.addr = obj.addr
+
         self.taintlabels_in = None
         self.taintlabels_out = None
 
@@ -144,10 +164,11 @@ class SyscallArgument(object):
             self.taintlabels_out = set(obj.taintlabels_out)
 
         self.direction = obj.direction
+        self.truncated = obj.truncated
 
         self.pointers = []
         for ptrobj in obj.ptr:
-            ptr = SyscallArgument(ptrobj)
+            ptr = SyscallArgument(ptrobj, self)
             self.pointers.append(ptr)
 
         # Sort pointers according to their offset
@@ -283,6 +304,9 @@ class SyscallArgument(object):
             labels.sort()
             s += ", use %s" % labels
 
+        if self.truncated:
+            s += ", truncated"
+
         # Add indentation and EOL
         s = "%s%s\n" % (" "*((indent+1)*2), s)
 